@@ -4,6 +4,7 @@
 #include <polymer/hashmap.h>
 #include <polymer/json.h>
 #include <polymer/render/render.h>
+#include <polymer/world/biome.h>
 #include <polymer/zip_archive.h>
 
 #include <polymer/stb_image.h>
@@ -61,12 +62,56 @@ bool AssetSystem::Load(render::VulkanRenderer& renderer, const char* jar_path, c
     fprintf(stderr, "Failed to load fonts.\n");
   }
 
+  grass_colormap = LoadColormap(archive, perm_arena, trans_arena, "assets/minecraft/textures/colormap/grass.png");
+  foliage_colormap = LoadColormap(archive, perm_arena, trans_arena, "assets/minecraft/textures/colormap/foliage.png");
+
   archive.Close();
   trans_arena.Destroy();
 
   return true;
 }
 
+u32* AssetSystem::LoadColormap(ZipArchive& archive, MemoryArena& perm_arena, MemoryArena& trans_arena,
+                               const char* path) {
+  ArenaSnapshot snapshot = trans_arena.GetSnapshot();
+
+  size_t size = 0;
+  u8* raw_image = (u8*)archive.ReadFile(&trans_arena, path, &size);
+
+  if (!raw_image) {
+    fprintf(stderr, "AssetSystem: Failed to read '%s'.\n", path);
+    return nullptr;
+  }
+
+  int width, height, channels;
+  stbi_uc* image = stbi_load_from_memory(raw_image, (int)size, &width, &height, &channels, STBI_rgb_alpha);
+
+  trans_arena.Revert(snapshot);
+
+  if (!image) {
+    fprintf(stderr, "AssetSystem: Failed to load '%s'.\n", path);
+    return nullptr;
+  }
+
+  u32* colormap = nullptr;
+
+  if (width == world::kColormapSize && height == world::kColormapSize) {
+    colormap = memory_arena_push_type_count(&perm_arena, u32, world::kColormapSize * world::kColormapSize);
+
+    for (size_t i = 0; i < world::kColormapSize * world::kColormapSize; ++i) {
+      stbi_uc* pixel = image + i * 4;
+
+      colormap[i] = ((u32)pixel[0] << 16) | ((u32)pixel[1] << 8) | pixel[2];
+    }
+  } else {
+    fprintf(stderr, "AssetSystem: Colormap '%s' has an unexpected size of %dx%d.\n", path, width, height);
+  }
+
+  stbi_image_free(image);
+
+  return colormap;
+}
+
 bool AssetSystem::LoadFont(render::VulkanRenderer& renderer, MemoryArena& perm_arena, MemoryArena& trans_arena) {
   constexpr size_t kGlyphPageWidth = 256;
   constexpr size_t kGlyphPageHeight = 256;
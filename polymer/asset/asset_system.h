@@ -10,6 +10,9 @@
 #include <polymer/asset/block_assets.h>
 
 namespace polymer {
+
+struct ZipArchive;
+
 namespace render {
 
 struct VulkanRenderer;
@@ -25,6 +28,9 @@ struct AssetSystem {
   render::TextureArray* glyph_page_texture = nullptr;
   u8* glyph_size_table = nullptr;
   AssetStore* asset_store = nullptr;
+  // 0xRRGGBB colors sampled for biome tinting. Null if they couldn't be loaded.
+  u32* grass_colormap = nullptr;
+  u32* foliage_colormap = nullptr;
 
   AssetSystem();
 
@@ -32,6 +38,7 @@ struct AssetSystem {
             world::BlockRegistry* registry);
 
   bool LoadFont(render::VulkanRenderer& renderer, MemoryArena& perm_arena, MemoryArena& trans_arena);
+  u32* LoadColormap(ZipArchive& archive, MemoryArena& perm_arena, MemoryArena& trans_arena, const char* path);
 
   TextureIdRange GetTextureRange(const String& texture_path);
 };
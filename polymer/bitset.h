@@ -49,6 +49,22 @@ struct BitSet {
     return true;
   }
 
+  bool Read(MemoryArena& arena, SpanReader& reader) {
+    u64 length = 0;
+
+    if (!reader.ReadVarInt(&length)) return false;
+    if (length > reader.GetRemaining() / sizeof(u64)) return false;
+
+    total_bit_count = 64 * length;
+    data = memory_arena_push_type_count(&arena, u64, length);
+
+    for (size_t i = 0; i < length; ++i) {
+      data[i] = reader.ReadU64();
+    }
+
+    return true;
+  }
+
   inline bool IsSet(size_t bit_index) const {
     if (bit_index >= total_bit_count) return false;
 
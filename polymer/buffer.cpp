@@ -26,6 +26,7 @@ RingBuffer::RingBuffer(MemoryArena& arena, size_t size) {
 
   this->size = size;
   this->read_offset = this->write_offset = 0;
+  this->mirrored = false;
 }
 
 size_t RingBuffer::GetFreeSize() const {
@@ -410,12 +411,96 @@ void RingBuffer::ReadRawString(String* str, size_t size) {
   this->read_offset = (this->read_offset + remaining) % this->size;
 
   if (size - remaining > 0) {
-    this->read_offset = 0;
-    memcpy(str->data + remaining, this->data, remaining);
+    memcpy(str->data + remaining, this->data, size - remaining);
     this->read_offset = size - remaining;
   }
 }
 
+const u8* RingBuffer::ReadContiguous(MemoryArena& arena, size_t size) {
+  size_t read_remaining = this->size - this->read_offset;
+
+  if (mirrored || read_remaining >= size) {
+    const u8* result = this->data + this->read_offset;
+
+    this->read_offset = (this->read_offset + size) % this->size;
+
+    return result;
+  }
+
+  u8* result = memory_arena_push_type_count(&arena, u8, size);
+
+  if (!result) return nullptr;
+
+  memcpy(result, this->data + this->read_offset, read_remaining);
+  memcpy(result + read_remaining, this->data, size - read_remaining);
+
+  this->read_offset = size - read_remaining;
+
+  return result;
+}
+
+u8 SpanReader::ReadU8() {
+  const u8* bytes = ReadBytes(sizeof(u8));
+
+  return bytes ? *bytes : 0;
+}
+
+u16 SpanReader::ReadU16() {
+  const u8* bytes = ReadBytes(sizeof(u16));
+  u16 result = 0;
+
+  if (bytes) {
+    memcpy(&result, bytes, sizeof(result));
+  }
+
+  return bswap_16(result);
+}
+
+u32 SpanReader::ReadU32() {
+  const u8* bytes = ReadBytes(sizeof(u32));
+  u32 result = 0;
+
+  if (bytes) {
+    memcpy(&result, bytes, sizeof(result));
+  }
+
+  return bswap_32(result);
+}
+
+u64 SpanReader::ReadU64() {
+  const u8* bytes = ReadBytes(sizeof(u64));
+  u64 result = 0;
+
+  if (bytes) {
+    memcpy(&result, bytes, sizeof(result));
+  }
+
+  return bswap_64(result);
+}
+
+bool SpanReader::ReadVarInt(u64* value) {
+  *value = 0;
+
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (offset >= size) {
+      overflow = true;
+      *value = 0;
+      return false;
+    }
+
+    u8 byte = data[offset++];
+
+    *value |= (u64)(byte & 0x7F) << shift;
+
+    if (!(byte & 0x80)) return true;
+  }
+
+  overflow = true;
+  *value = 0;
+
+  return false;
+}
+
 size_t GetVarIntSize(u64 value) {
   size_t index = 0;
 
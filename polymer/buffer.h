@@ -6,6 +6,44 @@
 
 namespace polymer {
 
+// Bounds checked read cursor over bytes that are contiguous in memory, such as the rest of a packet taken out of a
+// RingBuffer with ReadContiguous. Arrays are handed out as pointers into the data instead of being copied.
+// Reading past the end returns zeros and sets overflow, so a whole structure can be decoded before checking it once.
+struct SpanReader {
+  const u8* data;
+  size_t size;
+  size_t offset;
+  bool overflow;
+
+  SpanReader() : data(nullptr), size(0), offset(0), overflow(false) {}
+  SpanReader(const u8* data, size_t size) : data(data), size(size), offset(0), overflow(data == nullptr && size > 0) {}
+
+  inline size_t GetRemaining() const {
+    return size - offset;
+  }
+
+  // Returns the next count bytes and advances past them. Returns null if there aren't enough left.
+  inline const u8* ReadBytes(size_t count) {
+    if (count > size - offset) {
+      overflow = true;
+      offset = size;
+      return nullptr;
+    }
+
+    const u8* result = data + offset;
+
+    offset += count;
+
+    return result;
+  }
+
+  u8 ReadU8();
+  u16 ReadU16();
+  u32 ReadU32();
+  u64 ReadU64();
+  bool ReadVarInt(u64* value);
+};
+
 // Simple circular buffer where the read and write methods assume there's space to operate
 // The only method that checks for read/write cursor wrapping is ReadVarInt.
 // This could be simplified greatly by using virtual memory wrapping.
@@ -16,6 +54,9 @@ struct RingBuffer {
   size_t size;
   u8* data;
 
+  // Set when the data is mapped twice in a row in virtual memory, so reads can run off the end without wrapping.
+  bool mirrored;
+
   RingBuffer(MemoryArena& arena, size_t size);
 
   void WriteU8(u8 value);
@@ -39,6 +80,14 @@ struct RingBuffer {
   double ReadDouble();
   size_t ReadString(String* str);
   void ReadRawString(String* str, size_t size);
+  // Returns the next size bytes and advances past them. They are only copied into the arena when they wrap around the
+  // end of a buffer that isn't mirrored, so large arrays can be decoded in place. Returns null if the copy couldn't be
+  // allocated.
+  const u8* ReadContiguous(MemoryArena& arena, size_t size);
+
+  inline SpanReader ReadSpan(MemoryArena& arena, size_t size) {
+    return SpanReader(ReadContiguous(arena, size), size);
+  }
 
   size_t GetFreeSize() const;
   size_t GetReadAmount() const;
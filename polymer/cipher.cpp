@@ -0,0 +1,232 @@
+#include <polymer/cipher.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define POLYMER_CIPHER_AESNI 1
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// The AES-NI paths are compiled for the instructions regardless of the build flags and only run when the CPU has them.
+#if defined(POLYMER_CIPHER_AESNI) && !defined(_MSC_VER)
+#define POLYMER_TARGET_AES __attribute__((target("aes,sse2")))
+#else
+#define POLYMER_TARGET_AES
+#endif
+
+namespace polymer {
+
+// Number of key stream blocks that are encrypted together while decrypting. The AES instructions take a few cycles to
+// complete but a new one can start every cycle, so independent blocks keep them busy.
+constexpr size_t kDecryptLanes = 8;
+// Ciphertext is copied aside in runs of this size before being overwritten, since the following bytes depend on it.
+constexpr size_t kDecryptRunSize = 512;
+
+#ifdef POLYMER_CIPHER_AESNI
+
+static bool HasAesInstructions() {
+#ifdef _MSC_VER
+  int info[4];
+
+  __cpuid(info, 1);
+
+  return (info[2] & (1 << 25)) != 0;
+#else
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+
+  return (ecx & bit_AES) != 0;
+#endif
+}
+
+POLYMER_TARGET_AES static inline __m128i ExpandRoundKey(__m128i key, __m128i generated) {
+  generated = _mm_shuffle_epi32(generated, 0xFF);
+
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+
+  return _mm_xor_si128(key, generated);
+}
+
+// The round constant has to be an immediate.
+#define POLYMER_EXPAND_KEY(index, rcon)                                                                                \
+  keys[index] = ExpandRoundKey(keys[index - 1], _mm_aeskeygenassist_si128(keys[index - 1], rcon))
+
+POLYMER_TARGET_AES static void ExpandKeyHardware(const u8* key, u8* round_keys) {
+  __m128i keys[11];
+
+  keys[0] = _mm_loadu_si128((const __m128i*)key);
+
+  POLYMER_EXPAND_KEY(1, 0x01);
+  POLYMER_EXPAND_KEY(2, 0x02);
+  POLYMER_EXPAND_KEY(3, 0x04);
+  POLYMER_EXPAND_KEY(4, 0x08);
+  POLYMER_EXPAND_KEY(5, 0x10);
+  POLYMER_EXPAND_KEY(6, 0x20);
+  POLYMER_EXPAND_KEY(7, 0x40);
+  POLYMER_EXPAND_KEY(8, 0x80);
+  POLYMER_EXPAND_KEY(9, 0x1B);
+  POLYMER_EXPAND_KEY(10, 0x36);
+
+  for (size_t i = 0; i < 11; ++i) {
+    _mm_store_si128((__m128i*)(round_keys + i * kCipherBlockSize), keys[i]);
+  }
+}
+
+#undef POLYMER_EXPAND_KEY
+
+POLYMER_TARGET_AES static inline __m128i EncryptBlockHardware(__m128i block, const __m128i* keys) {
+  block = _mm_xor_si128(block, keys[0]);
+
+  for (size_t i = 1; i < 10; ++i) {
+    block = _mm_aesenc_si128(block, keys[i]);
+  }
+
+  return _mm_aesenclast_si128(block, keys[10]);
+}
+
+POLYMER_TARGET_AES static void EncryptHardware(u8* shift_register, const u8* round_keys, u8* data, size_t size) {
+  const __m128i* keys = (const __m128i*)round_keys;
+  __m128i state = _mm_load_si128((const __m128i*)shift_register);
+
+  for (size_t i = 0; i < size; ++i) {
+    __m128i stream = EncryptBlockHardware(state, keys);
+    u8 cipher_byte = data[i] ^ (u8)_mm_cvtsi128_si32(stream);
+
+    data[i] = cipher_byte;
+
+    // Shift the register down a byte and append the new ciphertext byte.
+    state = _mm_or_si128(_mm_srli_si128(state, 1), _mm_slli_si128(_mm_cvtsi32_si128(cipher_byte), 15));
+  }
+
+  _mm_store_si128((__m128i*)shift_register, state);
+}
+
+// The history holds the 16 bytes of ciphertext before the data followed by a copy of the data's ciphertext.
+POLYMER_TARGET_AES static void DecryptRunHardware(const u8* history, const u8* round_keys, u8* data, size_t size) {
+  const __m128i* keys = (const __m128i*)round_keys;
+  const u8* ciphertext = history + kCipherBlockSize;
+  size_t i = 0;
+
+  for (; i + kDecryptLanes <= size; i += kDecryptLanes) {
+    __m128i blocks[kDecryptLanes];
+
+    for (size_t lane = 0; lane < kDecryptLanes; ++lane) {
+      blocks[lane] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(history + i + lane)), keys[0]);
+    }
+
+    for (size_t round = 1; round < 10; ++round) {
+      for (size_t lane = 0; lane < kDecryptLanes; ++lane) {
+        blocks[lane] = _mm_aesenc_si128(blocks[lane], keys[round]);
+      }
+    }
+
+    for (size_t lane = 0; lane < kDecryptLanes; ++lane) {
+      blocks[lane] = _mm_aesenclast_si128(blocks[lane], keys[10]);
+
+      data[i + lane] = ciphertext[i + lane] ^ (u8)_mm_cvtsi128_si32(blocks[lane]);
+    }
+  }
+
+  for (; i < size; ++i) {
+    __m128i stream = EncryptBlockHardware(_mm_loadu_si128((const __m128i*)(history + i)), keys);
+
+    data[i] = ciphertext[i] ^ (u8)_mm_cvtsi128_si32(stream);
+  }
+}
+
+#endif
+
+bool Cfb8Cipher::Initialize(const u8* key) {
+  memcpy(shift_register, key, kCipherBlockSize);
+
+  hardware = false;
+
+#ifdef POLYMER_CIPHER_AESNI
+  hardware = HasAesInstructions();
+
+  if (hardware) {
+    ExpandKeyHardware(key, round_keys);
+    return true;
+  }
+#endif
+
+  if (aes_setup(key, (int)kCipherKeySize, 0, &software_key) != CRYPT_OK) {
+    fprintf(stderr, "Failed to set up cipher key.\n");
+    return false;
+  }
+
+  return true;
+}
+
+void Cfb8Cipher::EncryptBlock(const u8* in, u8* out) {
+  aes_ecb_encrypt(in, out, &software_key);
+}
+
+void Cfb8Cipher::Encrypt(u8* data, size_t size) {
+#ifdef POLYMER_CIPHER_AESNI
+  if (hardware) {
+    EncryptHardware(shift_register, round_keys, data, size);
+    return;
+  }
+#endif
+
+  u8 stream[kCipherBlockSize];
+
+  for (size_t i = 0; i < size; ++i) {
+    EncryptBlock(shift_register, stream);
+
+    data[i] ^= stream[0];
+
+    memmove(shift_register, shift_register + 1, kCipherBlockSize - 1);
+    shift_register[kCipherBlockSize - 1] = data[i];
+  }
+}
+
+void Cfb8Cipher::Decrypt(u8* data, size_t size) {
+  alignas(16) u8 history[kCipherBlockSize + kDecryptRunSize];
+
+  memcpy(history, shift_register, kCipherBlockSize);
+
+  while (size > 0) {
+    size_t run_size = size < kDecryptRunSize ? size : kDecryptRunSize;
+
+    memcpy(history + kCipherBlockSize, data, run_size);
+
+#ifdef POLYMER_CIPHER_AESNI
+    if (hardware) {
+      DecryptRunHardware(history, round_keys, data, run_size);
+    } else
+#endif
+    {
+      u8 stream[kCipherBlockSize];
+
+      for (size_t i = 0; i < run_size; ++i) {
+        EncryptBlock(history + i, stream);
+
+        data[i] = history[kCipherBlockSize + i] ^ stream[0];
+      }
+    }
+
+    // The last 16 bytes of ciphertext become the start of the next run.
+    memmove(history, history + run_size, kCipherBlockSize);
+
+    data += run_size;
+    size -= run_size;
+  }
+
+  memcpy(shift_register, history, kCipherBlockSize);
+}
+
+} // namespace polymer
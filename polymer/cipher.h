@@ -0,0 +1,36 @@
+#ifndef POLYMER_CIPHER_H_
+#define POLYMER_CIPHER_H_
+
+#include <polymer/types.h>
+
+#include <tomcrypt.h>
+
+namespace polymer {
+
+constexpr size_t kCipherKeySize = 16;
+constexpr size_t kCipherBlockSize = 16;
+
+// AES-128 in CFB8 mode, which the protocol uses in both directions with the shared secret as the key and the IV.
+// Blocks are encrypted with AES-NI when the CPU supports it and with libtomcrypt otherwise.
+struct Cfb8Cipher {
+  // The last 16 bytes of ciphertext, which are encrypted to get the key stream byte for the next one.
+  alignas(16) u8 shift_register[kCipherBlockSize];
+  alignas(16) u8 round_keys[11 * kCipherBlockSize];
+
+  symmetric_key software_key;
+  bool hardware;
+
+  bool Initialize(const u8* key);
+
+  // Both transform the data in place.
+  void Encrypt(u8* data, size_t size);
+  // Every key stream byte only depends on ciphertext that is already known, so decrypting runs many blocks at once.
+  void Decrypt(u8* data, size_t size);
+
+private:
+  void EncryptBlock(const u8* in, u8* out);
+};
+
+} // namespace polymer
+
+#endif
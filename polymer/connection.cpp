@@ -1,6 +1,8 @@
 #include <polymer/connection.h>
 
+#include <polymer/miniz.h>
 #include <polymer/packet_interpreter.h>
+#include <polymer/protocol.h>
 
 #include <chrono>
 #include <thread>
@@ -8,6 +10,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef _WIN32
 #include <WS2tcpip.h>
@@ -18,6 +21,8 @@
 #include <errno.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/uio.h>
@@ -28,6 +33,11 @@
 #define POLY_EWOULDBLOCK EWOULDBLOCK
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 namespace polymer {
 
 static int GetLastErrorCode() {
@@ -40,53 +50,689 @@ static int GetLastErrorCode() {
   return err;
 }
 
+// Serverbound keep alive id in the play state.
+constexpr u32 kKeepAliveResponseId = 0x12;
+
+#ifdef __linux__
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// Compressed packets have their length written as a three byte var int since it isn't known until the data is
+// compressed in place. That's also the largest packet size that the server accepts.
+constexpr size_t kCompressedLengthSize = 3;
+constexpr size_t kMaxPacketSize = (1 << 21) - 1;
+
+void PacketBuilder::Commit(RingBuffer& out, u32 pid) {
+  assert(out.mirrored);
+
+  size_t pid_size = GetVarIntSize(pid);
+  size_t data_size = pid_size + buffer.write_offset;
+
+  if (flags & BuildFlag_OmitCompress) {
+    out.WriteVarInt(data_size);
+    out.WriteVarInt(pid);
+  } else if (data_size < compression_threshold) {
+    // A data length of zero marks the packet as uncompressed.
+    out.WriteVarInt(data_size + GetVarIntSize(0));
+    out.WriteVarInt(0);
+    out.WriteVarInt(pid);
+  } else {
+    u8 pid_data[5];
+    size_t pid_offset = 0;
+    u32 pid_value = pid;
+
+    do {
+      u8 byte = pid_value & 0x7F;
+
+      pid_value >>= 7;
+      pid_data[pid_offset++] = pid_value ? (byte | 0x80) : byte;
+    } while (pid_value);
+
+    size_t data_length_size = GetVarIntSize(data_size);
+    size_t header_size = kCompressedLengthSize + data_length_size;
+    size_t free_size = out.size - 1 - out.GetReadAmount();
+
+    if (free_size < header_size) {
+      fprintf(stderr, "Not enough space in write buffer for packet %u.\n", pid);
+      buffer.write_offset = 0;
+      return;
+    }
+
+    size_t capacity = free_size - header_size;
+
+    if (capacity > kMaxPacketSize - data_length_size) {
+      capacity = kMaxPacketSize - data_length_size;
+    }
+
+    // The output buffer is mirrored, so the data can be compressed straight into it after the header.
+    u8* compressed = out.data + (out.write_offset + header_size) % out.size;
+    size_t compressed_size = 0;
+
+    int comp_flags = tdefl_create_comp_flags_from_zip_params(MZ_DEFAULT_LEVEL, MZ_DEFAULT_WINDOW_BITS, 0);
+
+    tdefl_init(compressor, nullptr, nullptr, comp_flags);
+
+    size_t in_size = pid_offset;
+    size_t out_size = capacity;
+    tdefl_status status = tdefl_compress(compressor, pid_data, &in_size, compressed, &out_size, TDEFL_NO_FLUSH);
+
+    compressed_size += out_size;
+
+    if (status == TDEFL_STATUS_OKAY && in_size == pid_offset) {
+      in_size = buffer.write_offset;
+      out_size = capacity - compressed_size;
+
+      status = tdefl_compress(compressor, buffer.data, &in_size, compressed + compressed_size, &out_size, TDEFL_FINISH);
+
+      compressed_size += out_size;
+    }
+
+    buffer.write_offset = 0;
+
+    if (status != TDEFL_STATUS_DONE) {
+      fprintf(stderr, "Failed to compress packet %u.\n", pid);
+      return;
+    }
+
+    size_t packet_length = data_length_size + compressed_size;
+    u8* length_data = out.data + out.write_offset;
+
+    length_data[0] = (u8)(packet_length & 0x7F) | 0x80;
+    length_data[1] = (u8)((packet_length >> 7) & 0x7F) | 0x80;
+    length_data[2] = (u8)((packet_length >> 14) & 0x7F);
+
+    out.write_offset = (out.write_offset + kCompressedLengthSize) % out.size;
+    out.WriteVarInt(data_size);
+    out.write_offset = (out.write_offset + compressed_size) % out.size;
+
+    return;
+  }
+
+  if (buffer.write_offset > 0) {
+    out.WriteRawString(String((char*)buffer.data, buffer.write_offset));
+    buffer.write_offset = 0;
+  }
+}
+
 Connection::Connection(MemoryArena& arena)
-    : read_buffer(arena, 0), write_buffer(arena, 0), interpreter(nullptr), builder(arena) {}
+    : read_buffer(arena, 0), write_buffer(arena, 0), interpreter(nullptr), builder(arena), network_running(false),
+      network_result(TickResult::Success), inbound_stalled(false), encryption_requested(false), encryption_start(0),
+      network_state(ProtocolState::Handshake), network_compression(false), send_blocked(false), outbound_partial(false),
+      awaiting_encryption(false), encrypting(false), outbound_encrypted(0), control_size(0), control_sent(0),
+      control_encrypted(0) {
+#ifndef POLYMER_LIBDEFLATE
+  inflater = memory_arena_push_type(&arena, tinfl_decompressor);
+#endif
+}
 
 Connection::TickResult Connection::Tick() {
-  RingBuffer* rb = &read_buffer;
-  RingBuffer* wb = &write_buffer;
+  assert(outbound.data && inbound.data);
+
+  // Everything committed since the last tick is handed over at once so it can go out together.
+  size_t committed = (write_buffer.write_offset + outbound.size - outbound.write_offset.load()) % outbound.size;
+
+  if (committed > 0) {
+    outbound.CommitWrite(committed);
+    WakeNetworkThread();
+  }
+
+  write_buffer.read_offset = outbound.read_offset.load(std::memory_order_acquire);
+
+  assert(interpreter);
+
+  interpreter->Interpret();
+
+  // The network thread stops framing when the queue fills up, so let it know that there's room again.
+  if (inbound_stalled.exchange(false)) {
+    WakeNetworkThread();
+  }
+
+  // Checked after interpreting since every packet received before the failure was already queued.
+  TickResult result = network_result.load(std::memory_order_acquire);
+
+  if (result != TickResult::Success && connected) {
+    if (result == TickResult::ConnectionError) {
+      fprintf(stderr, "Connection failed.\n");
+    }
+
+    this->Disconnect();
+  }
+
+  return result;
+}
+
+bool Connection::StartNetworkThread() {
+  network_state = protocol_state;
+  network_compression = false;
+  network_result = TickResult::Success;
+  inbound_stalled = false;
+  send_blocked = false;
+  outbound_partial = false;
+  awaiting_encryption = encrypting = false;
+  encryption_requested = false;
+  control_size = control_sent = control_encrypted = 0;
+
+  inbound.read_offset = inbound.write_offset = 0;
+
+  // The outbound queue is the write buffer, so anything committed before starting is sent on the first tick.
+  outbound.data = write_buffer.data;
+  outbound.size = write_buffer.size;
+  outbound.read_offset = outbound.write_offset = write_buffer.read_offset;
+
+#ifdef POLYMER_LIBDEFLATE
+  // Kept for the lifetime of the connection so reconnecting reuses it.
+  if (!inflater) {
+    inflater = libdeflate_alloc_decompressor();
+  }
+
+  if (!inflater) {
+    fprintf(stderr, "Failed to allocate packet decompressor.\n");
+    return false;
+  }
+#endif
+
+#ifdef __linux__
+  epoll_fd = epoll_create1(0);
+  wake_fd = eventfd(0, EFD_NONBLOCK);
+
+  if (epoll_fd < 0 || wake_fd < 0) {
+    fprintf(stderr, "Failed to create network events.\n");
+    return false;
+  }
+
+  epoll_event event = {};
+
+  event.events = EPOLLIN;
+  event.data.fd = wake_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
 
-  while (wb->write_offset != wb->read_offset) {
-    int bytes_sent = 0;
+  epoll_events = EPOLLIN;
+#endif
+
+  network_running = true;
+  network_thread = std::thread(&Connection::NetworkMain, this);
+
+  return true;
+}
+
+void Connection::EnableEncryption(const u8* shared_secret) {
+  memcpy(encryption_key, shared_secret, kCipherKeySize);
+  encryption_start = write_buffer.write_offset;
+
+  encryption_requested.store(true, std::memory_order_release);
+  WakeNetworkThread();
+}
+
+void Connection::StopNetworkThread() {
+  if (!network_thread.joinable()) return;
 
-    if (wb->write_offset > wb->read_offset) {
-      // Send up to the write offset
-      bytes_sent = send(fd, (char*)wb->data + wb->read_offset, (int)(wb->write_offset - wb->read_offset), 0);
-    } else if (wb->write_offset < wb->read_offset) {
-      // Send up to the end of the buffer then loop again to send the remaining up to the write offset
-      bytes_sent = send(fd, (char*)wb->data + wb->read_offset, (int)(wb->size - wb->read_offset), 0);
+  network_running = false;
+  WakeNetworkThread();
+
+  network_thread.join();
+
+#ifdef __linux__
+  close(epoll_fd);
+  close(wake_fd);
+
+  epoll_fd = wake_fd = -1;
+#endif
+}
+
+void Connection::WakeNetworkThread() {
+#ifdef __linux__
+  if (wake_fd >= 0) {
+    u64 value = 1;
+    ssize_t written = write(wake_fd, &value, sizeof(value));
+    (void)written;
+  }
+#endif
+}
+
+void Connection::NetworkMain() {
+  while (network_running.load(std::memory_order_acquire)) {
+    bool progress = true;
+    bool closed = false;
+
+    // Keep going until everything would block, then sleep until the socket or the game thread has something.
+    while (progress) {
+      progress = false;
+
+      if (!ReceivePending(&progress, &closed) || !FramePackets(&progress) || !SendPending(&progress)) {
+        network_result = TickResult::ConnectionError;
+        return;
+      }
+
+      if (closed) {
+        network_result = TickResult::ConnectionClosed;
+        return;
+      }
     }
 
-    if (bytes_sent > 0) {
-      wb->read_offset = (wb->read_offset + bytes_sent) % wb->size;
+    WaitForNetworkEvents();
+  }
+}
+
+bool Connection::StartEncryption() {
+  if (!encrypt_cipher.Initialize(encryption_key) || !decrypt_cipher.Initialize(encryption_key)) {
+    return false;
+  }
+
+  // Anything received since the request was kept as it arrived, so it's decrypted now before it gets framed.
+  RingBuffer* rb = &read_buffer;
+
+  decrypt_cipher.Decrypt(rb->data + rb->read_offset, rb->GetReadAmount());
+
+  // The encryption response and anything before it are sent as they are.
+  outbound_encrypted = encryption_start;
+
+  awaiting_encryption = false;
+  encrypting = true;
+
+  return true;
+}
+
+void Connection::WaitForNetworkEvents() {
+  bool can_receive = read_buffer.GetReadAmount() < read_buffer.size - 1;
+
+#ifdef __linux__
+  u32 events = 0;
+
+  if (can_receive) events |= EPOLLIN;
+  if (send_blocked) events |= EPOLLOUT;
+
+  if (events != epoll_events) {
+    epoll_event event = {};
+
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+
+    epoll_events = events;
+  }
+
+  epoll_event ready[2];
+
+  // The timeout is only a fallback in case a wake up from the game thread is missed.
+  int count = epoll_wait(epoll_fd, ready, 2, 100);
+
+  for (int i = 0; i < count; ++i) {
+    if (ready[i].data.fd == wake_fd) {
+      u64 value = 0;
+      ssize_t bytes_read = read(wake_fd, &value, sizeof(value));
+      (void)bytes_read;
     }
   }
+#else
+  if (!can_receive && !send_blocked) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return;
+  }
+
+  fd_set read_set;
+  fd_set write_set;
+
+  FD_ZERO(&read_set);
+  FD_ZERO(&write_set);
 
-  int bytes_recv = recv(fd, (char*)rb->data + rb->write_offset, (u32)rb->GetFreeSize(), 0);
+  if (can_receive) FD_SET(fd, &read_set);
+  if (send_blocked) FD_SET(fd, &write_set);
 
-  if (bytes_recv == 0) {
-    this->connected = false;
-    return TickResult::ConnectionClosed;
-  } else if (bytes_recv < 0) {
-    int err = GetLastErrorCode();
+  // There's no way to wake this from the game thread, so it only waits long enough to pick up new packets quickly.
+  timeval timeout = {0, 1000};
 
-    if (err == POLY_EWOULDBLOCK) {
-      return TickResult::Success;
+  select((int)fd + 1, &read_set, &write_set, nullptr, &timeout);
+#endif
+}
+
+bool Connection::ReceivePending(bool* progress, bool* closed) {
+  RingBuffer* rb = &read_buffer;
+
+  while (true) {
+    size_t free_size = rb->size - 1 - rb->GetReadAmount();
+
+    if (free_size == 0) return true;
+
+    // The buffer is mirrored, so the entire free space can be received into even when it wraps.
+    int bytes_recv = recv(fd, (char*)rb->data + rb->write_offset, (int)free_size, 0);
+
+    if (bytes_recv == 0) {
+      *closed = true;
+      return true;
+    } else if (bytes_recv < 0) {
+      int err = GetLastErrorCode();
+
+      if (err == POLY_EWOULDBLOCK) {
+        return true;
+      }
+
+      fprintf(stderr, "Unexpected socket error: %d\n", err);
+      return false;
+    }
+
+    // Everything received is decrypted in one pass, so framing only ever sees plaintext.
+    if (encrypting) {
+      decrypt_cipher.Decrypt(rb->data + rb->write_offset, bytes_recv);
     }
 
-    fprintf(stderr, "Unexpected socket error: %d\n", err);
-    this->Disconnect();
-    return TickResult::ConnectionError;
-  } else if (bytes_recv > 0) {
     rb->write_offset = (rb->write_offset + bytes_recv) % rb->size;
+    *progress = true;
+  }
+}
 
-    assert(interpreter);
+bool Connection::FramePackets(bool* progress) {
+  RingBuffer* rb = &read_buffer;
+
+  while (!awaiting_encryption && rb->read_offset != rb->write_offset) {
+    size_t offset_snapshot = rb->read_offset;
+    u64 pkt_size = 0;
+
+    if (!rb->ReadVarInt(&pkt_size)) {
+      break;
+    }
+
+    if (rb->GetReadAmount() < pkt_size) {
+      rb->read_offset = offset_snapshot;
+      break;
+    }
+
+    size_t target_offset = (rb->read_offset + pkt_size) % rb->size;
+    u64 payload_size = 0;
+
+    if (network_compression) {
+      size_t size_offset = rb->read_offset;
+
+      rb->ReadVarInt(&payload_size);
+      pkt_size -= (rb->read_offset + rb->size - size_offset) % rb->size;
+    }
+
+    // Packets under the compression threshold have a payload size of zero and are sent as they are.
+    size_t record_size = payload_size > 0 ? (size_t)payload_size : (size_t)pkt_size;
+
+    if (record_size + kPacketRecordHeaderSize >= inbound.size) {
+      fprintf(stderr, "Received packet of size %zu is too large.\n", record_size);
+      return false;
+    }
+
+    if (inbound.GetFreeSize() < record_size + kPacketRecordHeaderSize) {
+      rb->read_offset = offset_snapshot;
+      inbound_stalled = true;
 
-    interpreter->Interpret();
+      // The game thread could have made room before the flag was set, in which case it won't wake this thread.
+      if (inbound.GetFreeSize() >= record_size + kPacketRecordHeaderSize) {
+        inbound_stalled = false;
+        continue;
+      }
+
+      break;
+    }
+
+    u8* record = inbound.GetWritePointer();
+    u8* packet = record + kPacketRecordHeaderSize;
+
+    // Both buffers are mirrored, so the packet can be read and written without wrapping.
+    const u8* payload = rb->data + rb->read_offset;
+
+    rb->read_offset = target_offset;
+    *progress = true;
+
+    if (payload_size > 0) {
+      if (!InflatePacket(payload, (size_t)pkt_size, packet, record_size)) {
+        fprintf(stderr, "Failed to decompress packet. Skipping.\n");
+        continue;
+      }
+    } else {
+      memcpy(packet, payload, record_size);
+    }
+
+    if (!InspectPacket(packet, record_size)) continue;
+
+    u32 header = (u32)record_size;
+
+    memcpy(record, &header, sizeof(header));
+    inbound.CommitWrite(kPacketRecordHeaderSize + record_size);
   }
 
-  return TickResult::Success;
+  return true;
+}
+
+// Sends the buffers in order with one call. Returns the number of bytes sent or a negative value on error.
+static long long SendVectored(SocketType fd, const u8** data, const size_t* sizes, size_t count) {
+#ifdef _WIN32
+  WSABUF buffers[2];
+  DWORD bytes_sent = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    buffers[i].buf = (char*)data[i];
+    buffers[i].len = (ULONG)sizes[i];
+  }
+
+  if (WSASend(fd, buffers, (DWORD)count, &bytes_sent, 0, nullptr, nullptr) != 0) {
+    return -1;
+  }
+
+  return (long long)bytes_sent;
+#else
+  iovec buffers[2];
+  msghdr message = {};
+
+  for (size_t i = 0; i < count; ++i) {
+    buffers[i].iov_base = (void*)data[i];
+    buffers[i].iov_len = sizes[i];
+  }
+
+  message.msg_iov = buffers;
+  message.msg_iovlen = count;
+
+  return (long long)sendmsg(fd, &message, kSendFlags);
+#endif
+}
+
+bool Connection::InflatePacket(const u8* input, size_t input_size, u8* output, size_t output_size) {
+  if (input_size < 2) return false;
+
+  // The zlib header is checked here so the data can be decoded as a raw deflate stream, which skips computing the
+  // adler-32 checksum of the output. The packet already made it through TCP's checksum.
+  u8 cmf = input[0];
+  u8 flags = input[1];
+
+  if ((cmf & 0x0F) != 8 || (flags & 0x20) || ((cmf << 8) | flags) % 31 != 0) {
+    return false;
+  }
+
+#ifdef POLYMER_LIBDEFLATE
+  size_t inflated_size = 0;
+  libdeflate_result result =
+      libdeflate_deflate_decompress(inflater, input + 2, input_size - 2, output, output_size, &inflated_size);
+
+  return result == LIBDEFLATE_SUCCESS && inflated_size == output_size;
+#else
+  size_t in_size = input_size - 2;
+  size_t inflated_size = output_size;
+
+  tinfl_init(inflater);
+
+  // The output is sized from the advertised payload size, so the whole packet is decoded in one call straight into the
+  // inbound queue.
+  tinfl_status status = tinfl_decompress(inflater, input + 2, &in_size, output, output, &inflated_size,
+                                         TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+
+  return status == TINFL_STATUS_DONE && inflated_size == output_size;
+#endif
+}
+
+bool Connection::SendPending(bool* progress) {
+  while (true) {
+    // Checked before looking at the queue since the packets after the encryption response could be published at any
+    // point after the request.
+    if (encryption_requested.exchange(false, std::memory_order_acquire)) {
+      if (!StartEncryption()) return false;
+
+      *progress = true;
+    }
+
+    size_t read_offset = outbound.read_offset.load(std::memory_order_relaxed);
+    size_t outbound_pending = outbound.GetReadAmount();
+    // The front of the outbound queue that can go out as it is. This can be past the published packets while the
+    // encryption response is still waiting to be published.
+    size_t outbound_ready = outbound_pending;
+
+    if (encrypting) {
+      outbound_ready = (outbound_encrypted + outbound.size - read_offset) % outbound.size;
+    }
+
+    // Keep alive responses can only go in front of the game's packets when the last send ended on a packet boundary.
+    // Once encrypting, they also can't go in front of packets that were already encrypted, since the cipher has to see
+    // the bytes in the order they are sent.
+    bool include_control = false;
+    size_t control_end = control_size;
+
+    if (control_encrypted > control_sent) {
+      include_control = true;
+      control_end = control_encrypted;
+    } else if (control_sent > 0) {
+      include_control = true;
+    } else {
+      include_control = control_size > 0 && !outbound_partial && (!encrypting || outbound_ready == 0);
+    }
+
+    if (encrypting) {
+      if (include_control && control_end > control_encrypted) {
+        encrypt_cipher.Encrypt(control_data + control_encrypted, control_end - control_encrypted);
+        control_encrypted = control_end;
+      }
+
+      // The queue is mirrored, so the new packets can be encrypted in place with one call even when they wrap.
+      if (outbound_pending > outbound_ready) {
+        encrypt_cipher.Encrypt(outbound.data + outbound_encrypted, outbound_pending - outbound_ready);
+        outbound_encrypted = (read_offset + outbound_pending) % outbound.size;
+      }
+    }
+
+    const u8* data[2];
+    size_t sizes[2];
+    size_t count = 0;
+    size_t control_pending = include_control ? control_end - control_sent : 0;
+
+    if (control_pending > 0) {
+      data[count] = control_data + control_sent;
+      sizes[count++] = control_pending;
+    }
+
+    // The outbound queue is only published in whole packets, so everything in it can go out with a single call.
+    if (outbound_pending > 0) {
+      data[count] = outbound.GetReadPointer();
+      sizes[count++] = outbound_pending;
+    }
+
+    if (count == 0) {
+      send_blocked = false;
+      return true;
+    }
+
+    long long bytes_sent = SendVectored(fd, data, sizes, count);
+
+    if (bytes_sent < 0) {
+      int err = GetLastErrorCode();
+
+      if (err == POLY_EWOULDBLOCK) {
+        // Wait for the socket to become writable instead of retrying until it does.
+        send_blocked = true;
+        return true;
+      }
+
+      fprintf(stderr, "Unexpected socket error: %d\n", err);
+      return false;
+    }
+
+    *progress = true;
+
+    size_t control_written = (size_t)bytes_sent < control_pending ? (size_t)bytes_sent : control_pending;
+    size_t outbound_written = (size_t)bytes_sent - control_written;
+
+    control_sent += control_written;
+
+    if (include_control && control_sent == control_end) {
+      // Responses queued after the ones that were just sent move to the front.
+      memmove(control_data, control_data + control_end, control_size - control_end);
+
+      control_size -= control_end;
+      control_sent = control_encrypted = 0;
+    }
+
+    if (outbound_written > 0) {
+      outbound.CommitRead(outbound_written);
+      outbound_partial = outbound_written < outbound_pending;
+    }
+
+    // The socket buffer is full, so the next call would only block.
+    if ((size_t)bytes_sent < control_pending + outbound_pending) {
+      send_blocked = true;
+      return true;
+    }
+  }
+}
+
+bool Connection::InspectPacket(const u8* packet, size_t size) {
+  SpanReader reader(packet, size);
+  u64 pkt_id = 0;
+
+  if (!reader.ReadVarInt(&pkt_id)) return true;
+
+  if (network_state == ProtocolState::Login) {
+    if (pkt_id == (u64)LoginProtocol::SetCompression) {
+      u64 threshold = 0;
+
+      // A negative threshold disables compression.
+      network_compression = reader.ReadVarInt(&threshold) && (s32)threshold >= 0;
+    } else if (pkt_id == (u64)LoginProtocol::EncryptionRequest) {
+      awaiting_encryption = true;
+    } else if (pkt_id == (u64)LoginProtocol::LoginSuccess) {
+      network_state = ProtocolState::Play;
+    }
+  } else if (network_state == ProtocolState::Play && pkt_id == (u64)PlayProtocol::KeepAlive) {
+    u64 id = reader.ReadU64();
+
+    if (!reader.overflow) {
+      QueueKeepAliveResponse(id);
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+void Connection::QueueKeepAliveResponse(u64 id) {
+  size_t body_size = (network_compression ? 1 : 0) + 1 + sizeof(u64);
+
+  if (control_size + 1 + body_size > sizeof(control_data)) {
+    fprintf(stderr, "Too many keep alive responses waiting to be sent.\n");
+    return;
+  }
+
+  u8* out = control_data + control_size;
+
+  *out++ = (u8)body_size;
+
+  // The response is always under the compression threshold, so it's sent uncompressed.
+  if (network_compression) {
+    *out++ = 0;
+  }
+
+  *out++ = (u8)kKeepAliveResponseId;
+
+  for (size_t i = 0; i < sizeof(u64); ++i) {
+    *out++ = (u8)(id >> (56 - i * 8));
+  }
+
+  control_size = out - control_data;
 }
 
 ConnectResult Connection::Connect(const char* ip, u16 port) {
@@ -126,13 +772,23 @@ ConnectResult Connection::Connect(const char* ip, u16 port) {
     return ConnectResult::ErrorConnect;
   }
 
+  // Everything committed in a frame is sent with one call, so there's nothing to gain from waiting to fill a segment.
+  int no_delay = 1;
+
+  setsockopt(this->fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+
   this->connected = true;
 
   return ConnectResult::Success;
 }
 
 void Connection::Disconnect() {
-  closesocket(this->fd);
+  StopNetworkThread();
+
+  if (this->connected) {
+    closesocket(this->fd);
+  }
+
   this->connected = false;
 }
 
@@ -162,6 +818,16 @@ void Connection::SendHandshake(u32 version, const char* address, size_t address_
   this->protocol_state = state_request;
 }
 
+void Connection::SendEncryptionResponse(const u8* secret, size_t secret_size, const u8* verify_token,
+                                        size_t verify_token_size) {
+  builder.WriteVarInt(secret_size);
+  builder.WriteRawString((const char*)secret, secret_size);
+  builder.WriteVarInt(verify_token_size);
+  builder.WriteRawString((const char*)verify_token, verify_token_size);
+
+  builder.Commit(write_buffer, 0x01);
+}
+
 void Connection::SendPingRequest() {
   builder.Commit(write_buffer, 0x00);
 }
@@ -173,12 +839,6 @@ void Connection::SendLoginStart(const char* username, size_t username_size) {
   builder.Commit(write_buffer, 0x00);
 }
 
-void Connection::SendKeepAlive(u64 id) {
-  builder.WriteU64(id);
-
-  builder.Commit(write_buffer, 0x12);
-}
-
 void Connection::SendTeleportConfirm(u64 id) {
   builder.WriteVarInt(id);
 
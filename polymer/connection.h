@@ -2,10 +2,20 @@
 #define POLYMER_CONNECTION_H_
 
 #include <polymer/buffer.h>
+#include <polymer/cipher.h>
 #include <polymer/math.h>
 #include <polymer/memory.h>
+#include <polymer/miniz.h>
+#include <polymer/spsc_queue.h>
 #include <polymer/types.h>
 
+#include <atomic>
+#include <thread>
+
+#ifdef POLYMER_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
 namespace polymer {
 
 enum class ConnectResult { Success, ErrorSocket, ErrorAddrInfo, ErrorConnect };
@@ -28,27 +38,17 @@ struct PacketBuilder {
 
   RingBuffer buffer;
   BuildFlags flags;
+  // Packets with an id and data at least this large are compressed once compression is enabled.
+  size_t compression_threshold;
+  // Reinitialized for every compressed packet so it never allocates.
+  tdefl_compressor* compressor;
 
-  PacketBuilder(MemoryArena& arena) : buffer(arena, 32767), flags(BuildFlag_OmitCompress) {}
-
-  inline void Commit(RingBuffer& out, u32 pid) {
-    size_t compress_length_size = (flags & BuildFlag_OmitCompress) ? 0 : GetVarIntSize(0);
-    size_t total_size = buffer.write_offset + compress_length_size + GetVarIntSize(pid);
-
-    out.WriteVarInt(total_size);
+  PacketBuilder(MemoryArena& arena)
+      : buffer(arena, 32767), flags(BuildFlag_OmitCompress), compression_threshold(0),
+        compressor(memory_arena_push_type(&arena, tdefl_compressor)) {}
 
-    if (!(flags & BuildFlag_OmitCompress)) {
-      // TODO: Implement compression
-      out.WriteVarInt(0);
-    }
-
-    out.WriteVarInt(pid);
-
-    if (buffer.write_offset > 0) {
-      out.WriteRawString(String((char*)buffer.data, buffer.write_offset));
-      buffer.write_offset = 0;
-    }
-  }
+  // Writes the framed packet to the output buffer, which must be mirrored.
+  void Commit(RingBuffer& out, u32 pid);
 
   inline void WriteU8(u8 value) {
     buffer.WriteU8(value);
@@ -95,16 +95,32 @@ struct PacketBuilder {
   }
 };
 
+// Packets in the inbound queue are stored as their size in a u32 followed by the packet id and data, decompressed.
+constexpr size_t kPacketRecordHeaderSize = sizeof(u32);
+
+// The socket is drained on a network thread that frames and decompresses packets as soon as they arrive, so receiving
+// isn't tied to the frame rate. Framed packets are handed to the game thread through the inbound queue and interpreted
+// during Tick. Packets are committed to the write buffer by the game thread and handed to the network thread to send
+// once per tick.
 struct Connection {
   enum class TickResult { Success, ConnectionClosed, ConnectionError };
 
   SocketType fd = -1;
   bool connected = false;
+  // The state used by the game thread to interpret packets.
   ProtocolState protocol_state = ProtocolState::Handshake;
 
+  // Raw bytes received from the socket. Only accessed by the network thread once it's started.
   RingBuffer read_buffer;
+  // Only accessed by the game thread. The committed packets are published to the outbound queue, which shares its
+  // memory.
   RingBuffer write_buffer;
 
+  // Framed packets from the network thread to the game thread.
+  SpscQueue inbound;
+  // Committed packets from the game thread to the network thread.
+  SpscQueue outbound;
+
   PacketBuilder builder;
 
   PacketInterpreter* interpreter;
@@ -112,15 +128,21 @@ struct Connection {
   Connection(MemoryArena& arena);
 
   ConnectResult Connect(const char* ip, u16 port);
+  // Starts receiving on the network thread. The buffers and queues must be allocated before this.
+  bool StartNetworkThread();
+  // Encrypts everything committed after this and everything received after the encryption request. Called once the
+  // encryption response has been committed.
+  void EnableEncryption(const u8* shared_secret);
   void Disconnect();
   void SetBlocking(bool blocking);
 
+  // Publishes the packets committed since the last tick and interprets every packet that has been received.
   TickResult Tick();
 
   void SendHandshake(u32 version, const char* address, size_t address_size, u16 port, ProtocolState state_request);
   void SendPingRequest();
   void SendLoginStart(const char* username, size_t username_size);
-  void SendKeepAlive(u64 id);
+  void SendEncryptionResponse(const u8* secret, size_t secret_size, const u8* verify_token, size_t verify_token_size);
   void SendTeleportConfirm(u64 id);
   void SendPlayerPositionAndRotation(const Vector3f& position, float yaw, float pitch, bool on_ground);
   void SendChatMessage(const String& message);
@@ -128,6 +150,78 @@ struct Connection {
 
   enum class ClientStatusAction { Respawn, Stats };
   void SendClientStatus(ClientStatusAction action);
+
+private:
+  std::thread network_thread;
+  std::atomic<bool> network_running;
+  // Set by the network thread when the socket is closed or fails, after every packet before it has been framed.
+  std::atomic<TickResult> network_result;
+  // Set by the network thread when the inbound queue is too full to take the next packet.
+  std::atomic<bool> inbound_stalled;
+  // Set by the game thread once the encryption key and start offset are ready.
+  std::atomic<bool> encryption_requested;
+  u8 encryption_key[kCipherKeySize];
+  // The write buffer offset where encrypted packets begin, which is just after the encryption response.
+  size_t encryption_start;
+
+  // Everything below is only accessed by the network thread while it's running.
+  // Tracked separately from the game thread's state since the framing changes as soon as the packets that change it
+  // are received.
+  ProtocolState network_state;
+  bool network_compression;
+  bool send_blocked;
+  // Set when the last send stopped in the middle of the game's packets.
+  bool outbound_partial;
+
+  // Set after receiving the encryption request, since everything the server sends after it is encrypted. Framing
+  // waits until the key is known.
+  bool awaiting_encryption;
+  bool encrypting;
+  Cfb8Cipher encrypt_cipher;
+  Cfb8Cipher decrypt_cipher;
+  // Everything in the outbound queue before this offset is ready to send. The bytes after it are still plaintext.
+  size_t outbound_encrypted;
+
+#ifdef __linux__
+  int epoll_fd = -1;
+  int wake_fd = -1;
+  u32 epoll_events = 0;
+#endif
+
+  // Keep alive responses are sent by the network thread so a long frame can't time out the connection. They are only
+  // sent between the game's packets.
+  u8 control_data[64];
+  size_t control_size;
+  size_t control_sent;
+  // Responses that were encrypted ahead of the game's packets, so they have to be sent before them.
+  size_t control_encrypted;
+
+  // Reset for every compressed packet instead of creating a new inflate state each time.
+#ifdef POLYMER_LIBDEFLATE
+  libdeflate_decompressor* inflater = nullptr;
+#else
+  tinfl_decompressor* inflater = nullptr;
+#endif
+
+  void StopNetworkThread();
+  void WakeNetworkThread();
+
+  void NetworkMain();
+  bool StartEncryption();
+  void WaitForNetworkEvents();
+
+  // These return false when the connection has failed.
+  bool ReceivePending(bool* progress, bool* closed);
+  bool FramePackets(bool* progress);
+  bool SendPending(bool* progress);
+
+  // Applies the framing changes of a received packet. Returns false if the packet was handled by the network thread and
+  // shouldn't be passed on.
+  bool InspectPacket(const u8* packet, size_t size);
+  void QueueKeepAliveResponse(u64 id);
+
+  // Decompresses a zlib packet that must inflate to exactly the output size.
+  bool InflatePacket(const u8* input, size_t input_size, u8* output, size_t output_size);
 };
 
 } // namespace polymer
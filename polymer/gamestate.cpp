@@ -12,16 +12,23 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <chrono>
+
 using polymer::render::kRenderLayerCount;
 using polymer::render::RenderLayer;
+using polymer::world::ChunkColumn;
 using polymer::world::ChunkMesh;
 using polymer::world::ChunkSection;
 using polymer::world::ChunkSectionInfo;
-using polymer::world::kChunkCacheSize;
 using polymer::world::kChunkColumnCount;
 
 namespace polymer {
 
+using ms_float = std::chrono::duration<float, std::milli>;
+
+// How long the main thread can spend snapshotting chunks for the mesh workers each frame.
+constexpr float kBuildSubmitBudgetMs = 2.0f;
+
 void OnSwapchainCreate(render::Swapchain& swapchain, void* user_data) {
   GameState* gamestate = (GameState*)user_data;
 
@@ -76,23 +83,10 @@ void OnSwapchainCleanup(render::Swapchain& swapchain, void* user_data) {
 
 GameState::GameState(render::VulkanRenderer* renderer, MemoryArena* perm_arena, MemoryArena* trans_arena)
     : perm_arena(perm_arena), trans_arena(trans_arena), connection(*perm_arena), renderer(renderer),
-      block_registry(*perm_arena), block_mesher(*trans_arena), chat_window(*trans_arena) {
-  for (u32 chunk_z = 0; chunk_z < kChunkCacheSize; ++chunk_z) {
-    for (u32 chunk_x = 0; chunk_x < kChunkCacheSize; ++chunk_x) {
-      ChunkSection* section = &world.chunks[chunk_z][chunk_x];
-      ChunkSectionInfo* section_info = &world.chunk_infos[chunk_z][chunk_x];
-
-      section->info = section_info;
-
-      ChunkMesh* meshes = world.meshes[chunk_z][chunk_x];
-
-      for (u32 chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
-        for (s32 i = 0; i < kRenderLayerCount; ++i) {
-          meshes[chunk_y].meshes[i].vertex_count = 0;
-        }
-      }
-    }
-  }
+      block_registry(*perm_arena), chat_window(*trans_arena) {
+  world.Initialize(*perm_arena, world::kDefaultViewDistance);
+  build_scheduler.Initialize(*perm_arena);
+  light_engine.Initialize(*perm_arena);
 
   camera.near = 0.1f;
   camera.far = 1024.0f;
@@ -152,6 +146,9 @@ void GameState::Update(float dt, InputState* input) {
     }
   }
 
+  PublishDecodedChunks(false);
+  FlushLight();
+  FlushDirtySections();
   ProcessBuildQueue();
 
   u32 anim_frame = (u32)(animation_accumulator * 8.0f);
@@ -165,6 +162,9 @@ void GameState::SubmitFrame() {
 
   vkEndCommandBuffer(command_buffer);
 
+  // Any meshes or textures uploaded this frame need to be submitted before the frame that draws them.
+  renderer->SubmitUploads();
+
   VkSubmitInfo submit_info = {};
   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
@@ -251,20 +251,103 @@ void GameState::ProcessMovement(float dt, InputState* input) {
 }
 
 void GameState::ProcessBuildQueue() {
-  for (size_t i = 0; i < build_queue.count;) {
-    s32 chunk_x = build_queue.data[i].x;
-    s32 chunk_z = build_queue.data[i].z;
+  UploadCompletedMeshes();
 
-    // TODO: Put a cap on the distance away so it's not constantly grabbing the neighbors of the outer unmeshed chunks.
-    render::ChunkBuildContext ctx(chunk_x, chunk_z);
+  auto start = std::chrono::high_resolution_clock::now();
+
+  build_scheduler.Prioritize(camera);
+
+  // Only take a chunk when the whole column can be submitted so it doesn't have to be tracked partially built.
+  while (mesh_pool.GetFreeJobCount() >= kChunkColumnCount) {
+    auto now = std::chrono::high_resolution_clock::now();
+    if (std::chrono::duration_cast<ms_float>(now - start).count() >= kBuildSubmitBudgetMs) break;
+
+    world::ChunkCoord coord;
+    if (!build_scheduler.PopReady(&coord)) break;
+
+    render::ChunkBuildContext ctx(coord.x, coord.z);
 
+    // Readiness is kept up to date by the scheduler, so this only fills out the neighbor pointers.
     if (ctx.GetNeighbors(&world)) {
       BuildChunkMesh(&ctx);
-      build_queue.data[i] = build_queue.data[--build_queue.count];
+    }
+  }
+}
+
+void GameState::UploadCompletedMeshes() {
+  render::ChunkMeshJob* job = mesh_pool.PopCompleted();
+
+  while (job) {
+    // The chunk could have been unloaded or replaced while this was being meshed.
+    ChunkColumn* column = world.GetLoadedColumn(job->chunk_x, job->chunk_z);
+
+    if (column && column->version == job->column_version &&
+        column->section_versions[job->chunk_y] == job->section_version) {
+      UploadChunkMesh(column, job->chunk_y, job->vertex_data);
+    }
+
+    mesh_pool.Release(job);
+    job = mesh_pool.PopCompleted();
+  }
+}
+
+void GameState::PublishDecodedChunks(bool wait) {
+  world::ChunkDecodeJob* job = decode_pool.PopCompleted(wait);
+
+  while (job) {
+    ChunkColumn* column = world.CreateColumn(job->chunk_x, job->chunk_z);
+
+    if (column) {
+      // The decoded sections are swapped in whole, so the old storage goes back to the pool when the job is released.
+      for (size_t chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
+        world::Chunk old_chunk = column->section.chunks[chunk_y];
+
+        column->section.chunks[chunk_y] = job->chunks[chunk_y];
+        job->chunks[chunk_y] = old_chunk;
+      }
+
+      column->info.bitmask = job->bitmask;
+      ++column->version;
+
+      for (size_t chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
+        ++column->section_versions[chunk_y];
+      }
+
+      OnChunkLoad(job->chunk_x, job->chunk_z);
+      ApplyDeferredChanges(job);
     } else {
-      ++i;
+      fprintf(stderr, "Failed to create chunk column (%d, %d).\n", job->chunk_x, job->chunk_z);
+    }
+
+    decode_pool.Release(job);
+    job = decode_pool.PopCompleted(false);
+  }
+}
+
+void GameState::ApplyDeferredChanges(world::ChunkDecodeJob* job) {
+  size_t offset = 0;
+
+  while (offset < job->deferred_size) {
+    world::DeferredChange* change = (world::DeferredChange*)(job->deferred + offset);
+    u8* data = (u8*)(change + 1);
+
+    switch (change->type) {
+    case world::DeferredChangeType::Block: {
+      OnBlockChange(change->x, change->y, change->z, change->bid);
+    } break;
+    case world::DeferredChangeType::Light: {
+      SpanReader reader(data, change->size);
+
+      OnLightUpdate(change->x, change->z, reader);
+    } break;
     }
+
+    size_t padded_size = (change->size + alignof(world::DeferredChange) - 1) & ~(alignof(world::DeferredChange) - 1);
+
+    offset += sizeof(world::DeferredChange) + padded_size;
   }
+
+  job->deferred_size = 0;
 }
 
 void GameState::OnWindowMouseMove(s32 dx, s32 dy) {
@@ -288,16 +371,33 @@ void GameState::OnPlayerPositionAndLook(const Vector3f& position, float yaw, flo
 }
 
 void GameState::BuildChunkMesh(render::ChunkBuildContext* ctx, s32 chunk_x, s32 chunk_y, s32 chunk_z) {
+  if (render::IsSectionHidden(block_registry, ctx, chunk_y)) {
+    // Uploading the empty vertex data frees whatever mesh the section had before.
+    render::ChunkVertexData vertex_data;
+
+    UploadChunkMesh(ctx->column, chunk_y, vertex_data);
+    return;
+  }
+
   u8* arena_snapshot = trans_arena->current;
 
-  render::ChunkVertexData vertex_data = block_mesher.CreateMesh(assets, block_registry, ctx, chunk_y);
+  render::BorderedChunk* bordered_chunk = render::CreateBorderedChunk(*trans_arena, ctx, chunk_y);
+  render::ChunkVertexData vertex_data =
+      block_mesher.CreateMesh(assets, block_registry, bordered_chunk, chunk_x, chunk_y, chunk_z);
 
-  ChunkMesh* meshes = world.meshes[ctx->z_index][ctx->x_index];
+  UploadChunkMesh(ctx->column, chunk_y, vertex_data);
+
+  // Reset the arena to where it was before this allocation. The data was already sent to the GPU so it's no longer
+  // useful.
+  trans_arena->current = arena_snapshot;
+  block_mesher.Reset();
+}
+
+void GameState::UploadChunkMesh(ChunkColumn* column, s32 chunk_y, render::ChunkVertexData& vertex_data) {
+  ChunkMesh* meshes = column->meshes;
 
   for (s32 i = 0; i < kRenderLayerCount; ++i) {
     if (meshes[chunk_y].meshes[i].vertex_count > 0) {
-      // TODO: This should be done in a better way
-      renderer->WaitForIdle();
       renderer->FreeMesh(&meshes[chunk_y].meshes[i]);
       meshes[chunk_y].meshes[i].vertex_count = 0;
     }
@@ -310,139 +410,91 @@ void GameState::BuildChunkMesh(render::ChunkBuildContext* ctx, s32 chunk_x, s32
       meshes[chunk_y].meshes[i].vertex_count = (u32)vertex_data.vertex_count[i];
       meshes[chunk_y].meshes[i] =
           renderer->AllocateMesh(vertex_data.vertices[i], data_size, vertex_data.vertex_count[i],
-                                 vertex_data.indices[i], vertex_data.index_count[i]);
+                                 vertex_data.indices[i], vertex_data.index_count[i], vertex_data.tints[i],
+                                 vertex_data.tint_count[i]);
     }
   }
-
-  // Reset the arena to where it was before this allocation. The data was already sent to the GPU so it's no longer
-  // useful.
-  trans_arena->current = arena_snapshot;
-  block_mesher.Reset();
 }
 
 void GameState::BuildChunkMesh(render::ChunkBuildContext* ctx) {
-  // TODO:
-  // This should probably be done on a separate thread or in a compute shader ideally.
-  // Either an index buffer or face merging should be done to reduce buffer size.
-
-  u32 x_index = world.GetChunkCacheIndex(ctx->chunk_x);
-  u32 z_index = world.GetChunkCacheIndex(ctx->chunk_z);
-
-  ChunkSectionInfo* section_info = &world.chunk_infos[z_index][x_index];
-
-  renderer->BeginMeshAllocation();
-
-  ChunkMesh* meshes = world.meshes[ctx->z_index][ctx->x_index];
+  ChunkColumn* column = ctx->column;
 
   for (s32 chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
-    if (!(section_info->bitmask & (1 << chunk_y))) {
+    if (!(column->info.bitmask & (1 << chunk_y)) || render::IsSectionHidden(block_registry, ctx, chunk_y)) {
+      ChunkMesh* mesh = column->meshes + chunk_y;
+
       for (s32 i = 0; i < kRenderLayerCount; ++i) {
-        meshes[chunk_y].meshes[i].vertex_count = 0;
+        if (mesh->meshes[i].vertex_count > 0) {
+          renderer->FreeMesh(&mesh->meshes[i]);
+          mesh->meshes[i].vertex_count = 0;
+        }
       }
 
       continue;
     }
 
-    BuildChunkMesh(ctx, ctx->chunk_x, chunk_y, ctx->chunk_z);
-  }
+    const render::ChunkVertexData* cached_mesh = nullptr;
 
-  renderer->EndMeshAllocation();
+    // The meshes are uploaded in UploadCompletedMeshes once the workers are done with them, unless the same section
+    // was meshed recently.
+    if (mesh_pool.Submit(ctx, chunk_y, &cached_mesh) && cached_mesh) {
+      render::ChunkVertexData vertex_data = *cached_mesh;
+
+      UploadChunkMesh(column, chunk_y, vertex_data);
+    }
+  }
 }
 
 void GameState::OnDimensionChange() {
-  renderer->WaitForIdle();
+  decode_pool.CancelAll();
+  mesh_pool.CancelAll();
 
-  for (s32 chunk_z = 0; chunk_z < kChunkCacheSize; ++chunk_z) {
-    for (s32 chunk_x = 0; chunk_x < kChunkCacheSize; ++chunk_x) {
-      ChunkSectionInfo* section_info = &world.chunk_infos[chunk_z][chunk_x];
-      ChunkMesh* meshes = world.meshes[chunk_z][chunk_x];
+  FreeMeshes();
 
-      section_info->loaded = false;
-      section_info->bitmask = 0;
+  build_scheduler.Clear(world);
+  dirty_sections.Clear(world);
+  light_engine.Clear();
 
-      for (s32 chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
-        ChunkMesh* mesh = meshes + chunk_y;
-
-        for (s32 i = 0; i < kRenderLayerCount; ++i) {
-          if (mesh->meshes[i].vertex_count > 0) {
-            renderer->FreeMesh(&mesh->meshes[i]);
-            mesh->meshes[i].vertex_count = 0;
-          }
-        }
-      }
-    }
-  }
+  world.Clear();
+}
 
-  build_queue.Clear();
+void GameState::OnViewDistanceChange(u32 view_distance) {
+  world.SetViewDistance(view_distance);
 }
 
 void GameState::OnChunkLoad(s32 chunk_x, s32 chunk_z) {
-  u32 x_index = world.GetChunkCacheIndex(chunk_x);
-  u32 z_index = world.GetChunkCacheIndex(chunk_z);
-
-  ChunkSectionInfo* section_info = &world.chunk_infos[z_index][x_index];
-  ChunkMesh* meshes = world.meshes[z_index][x_index];
+  ChunkColumn* column = world.GetColumn(chunk_x, chunk_z);
 
-  if (section_info->loaded) {
-    renderer->WaitForIdle();
+  if (!column) return;
 
-    build_queue.Dequeue(section_info->x, section_info->z);
+  // The server can resend a column that is already loaded, so anything built from the old data is thrown out.
+  if (column->info.loaded) {
+    build_scheduler.Dequeue(column);
+    mesh_pool.Cancel(chunk_x, chunk_z);
 
-    // Force clear any existing meshes
-    for (s32 chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
-      ChunkMesh* mesh = meshes + chunk_y;
-
-      for (s32 i = 0; i < kRenderLayerCount; ++i) {
-        if (mesh->meshes[i].vertex_count > 0) {
-          renderer->FreeMesh(&mesh->meshes[i]);
-          mesh->meshes[i].vertex_count = 0;
-        }
-      }
-    }
+    FreeColumnMeshes(column);
   }
 
-  section_info->loaded = true;
-  section_info->x = chunk_x;
-  section_info->z = chunk_z;
+  column->info.loaded = true;
 
-  build_queue.Enqueue(chunk_x, chunk_z);
+  build_scheduler.Enqueue(world, chunk_x, chunk_z);
 }
 
 void GameState::OnChunkUnload(s32 chunk_x, s32 chunk_z) {
-  u32 x_index = world.GetChunkCacheIndex(chunk_x);
-  u32 z_index = world.GetChunkCacheIndex(chunk_z);
-  ChunkSection* section = &world.chunks[z_index][x_index];
-  ChunkSectionInfo* section_info = &world.chunk_infos[z_index][x_index];
+  decode_pool.Cancel(chunk_x, chunk_z);
 
-  build_queue.Dequeue(chunk_x, chunk_z);
+  ChunkColumn* column = world.GetColumn(chunk_x, chunk_z);
 
-  // It's possible to receive an unload packet after receiving a new chunk that would take this chunk's position in
-  // the cache, so it needs to be checked before anything is changed in the cache.
-  if (section_info->x != chunk_x || section_info->z != chunk_z) {
-    return;
-  }
+  if (!column) return;
 
-  section_info->bitmask = 0;
-  section_info->loaded = false;
+  build_scheduler.Dequeue(column);
+  mesh_pool.Cancel(chunk_x, chunk_z);
 
-  for (s32 chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
-    if (section_info->bitmask & (1 << chunk_y)) {
-      memset(section->chunks[chunk_y].blocks, 0, sizeof(section->chunks[chunk_y].blocks));
-    }
-  }
-
-  ChunkMesh* meshes = world.meshes[z_index][x_index];
-
-  renderer->WaitForIdle();
+  FreeColumnMeshes(column);
+  world.FreeColumn(column);
 
-  for (s32 chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
-    for (s32 i = 0; i < kRenderLayerCount; ++i) {
-      if (meshes[chunk_y].meshes[i].vertex_count > 0) {
-        renderer->FreeMesh(&meshes[chunk_y].meshes[i]);
-        meshes[chunk_y].meshes[i].vertex_count = 0;
-      }
-    }
-  }
+  // Queued neighbors can't be built until this column is loaded again.
+  build_scheduler.OnNeighborhoodChange(world, chunk_x, chunk_z);
 }
 
 void GameState::OnBlockChange(s32 x, s32 y, s32 z, u32 new_bid) {
@@ -450,7 +502,27 @@ void GameState::OnBlockChange(s32 x, s32 y, s32 z, u32 new_bid) {
   s32 chunk_z = (s32)floorf(z / 16.0f);
   s32 chunk_y = (s32)floorf(y / 16.0f) + 4;
 
-  ChunkSection* section = &world.chunks[world.GetChunkCacheIndex(chunk_z)][world.GetChunkCacheIndex(chunk_x)];
+  if (chunk_y < 0 || chunk_y >= (s32)kChunkColumnCount) return;
+
+  // The block has to be set on top of the column's ChunkData if it's still being decoded, so it's kept until then.
+  world::ChunkDecodeJob* decode_job = decode_pool.GetDecoding(chunk_x, chunk_z);
+
+  if (decode_job) {
+    world::DeferredChange* change = decode_pool.PushDeferred(decode_job, world::DeferredChangeType::Block, 0);
+
+    if (change) {
+      change->x = x;
+      change->y = y;
+      change->z = z;
+      change->bid = new_bid;
+    }
+
+    return;
+  }
+
+  ChunkColumn* column = world.GetLoadedColumn(chunk_x, chunk_z);
+
+  if (!column) return;
 
   s32 relative_x = x % 16;
   s32 relative_y = y % 16;
@@ -468,80 +540,163 @@ void GameState::OnBlockChange(s32 x, s32 y, s32 z, u32 new_bid) {
     relative_z += 16;
   }
 
-  u32 old_bid = section->chunks[chunk_y].blocks[relative_y][relative_z][relative_x];
+  world::Chunk* chunk = column->section.chunks + chunk_y;
+  u32 old_bid = chunk->GetBlock(relative_x, relative_y, relative_z);
+
+  if (!chunk->SetBlock(world.storage_pool, relative_x, relative_y, relative_z, new_bid)) {
+    fprintf(stderr, "Failed to set block %d, %d, %d.\n", x, y, z);
+    return;
+  }
+
+  ++column->section_versions[chunk_y];
 
-  section->chunks[chunk_y].blocks[relative_y][relative_z][relative_x] = (u32)new_bid;
+  // Light is propagated in one batch before remeshing, so explosions and section updates are filled together.
+  if (!light_engine.Enqueue(x, y, z, old_bid, new_bid)) {
+    FlushLight();
+    light_engine.Enqueue(x, y, z, old_bid, new_bid);
+  }
 
   if (new_bid != 0) {
-    ChunkSectionInfo* section_info =
-        &world.chunk_infos[world.GetChunkCacheIndex(chunk_z)][world.GetChunkCacheIndex(chunk_x)];
-    section_info->bitmask |= (1 << chunk_y);
+    column->info.bitmask |= (1 << chunk_y);
   }
 
-  // TODO: Block changes should be batched to update a chunk once in the frame when it changes
-  renderer->BeginMeshAllocation();
-
-  render::ChunkBuildContext ctx(chunk_x, chunk_z);
-  ImmediateRebuild(&ctx, chunk_y);
+  // The rebuilds are deferred to FlushDirtySections so a section is only meshed once per frame.
+  dirty_sections.Mark(world, chunk_x, chunk_y, chunk_z);
 
   if (relative_x == 0) {
-    // Rebuild west
-    render::ChunkBuildContext nearby_ctx(chunk_x - 1, chunk_z);
-    ImmediateRebuild(&nearby_ctx, chunk_y);
+    dirty_sections.Mark(world, chunk_x - 1, chunk_y, chunk_z);
   } else if (relative_x == 15) {
-    // Rebuild east
-    render::ChunkBuildContext nearby_ctx(chunk_x + 1, chunk_z);
-    ImmediateRebuild(&nearby_ctx, chunk_y);
+    dirty_sections.Mark(world, chunk_x + 1, chunk_y, chunk_z);
   }
 
   if (relative_z == 0) {
-    // Rebuild north
-    render::ChunkBuildContext nearby_ctx(chunk_x, chunk_z - 1);
-    ImmediateRebuild(&nearby_ctx, chunk_y);
+    dirty_sections.Mark(world, chunk_x, chunk_y, chunk_z - 1);
   } else if (relative_z == 15) {
-    // Rebuild south
-    render::ChunkBuildContext nearby_ctx(chunk_x, chunk_z + 1);
-    ImmediateRebuild(&nearby_ctx, chunk_y);
+    dirty_sections.Mark(world, chunk_x, chunk_y, chunk_z + 1);
+  }
+
+  if (relative_y == 0) {
+    dirty_sections.Mark(world, chunk_x, chunk_y - 1, chunk_z);
+  } else if (relative_y == 15) {
+    dirty_sections.Mark(world, chunk_x, chunk_y + 1, chunk_z);
+  }
+}
+
+void GameState::OnLightUpdate(s32 chunk_x, s32 chunk_z, SpanReader& reader) {
+  ChunkColumn* column = world.GetLoadedColumn(chunk_x, chunk_z);
+
+  // Light for columns that aren't loaded is sent again with their ChunkData.
+  if (!column) return;
+
+  ArenaSnapshot snapshot = trans_arena->GetSnapshot();
+  u32 light_changes[kChunkColumnCount];
+
+  if (!world::DecodeChunkLight(*trans_arena, world.storage_pool, reader, dimension.min_y, dimension.height,
+                               column->section.chunks, light_changes)) {
+    fprintf(stderr, "Failed to read light update for chunk (%d, %d).\n", chunk_x, chunk_z);
+    fflush(stderr);
   }
 
-  if (relative_y == 0 && chunk_y > 0) {
-    // Rebuild below
-    render::ChunkBuildContext nearby_ctx(chunk_x, chunk_z);
-    ImmediateRebuild(&nearby_ctx, chunk_y - 1);
-  } else if (relative_y == 15 && chunk_y < 15) {
-    // Rebuild above
-    render::ChunkBuildContext nearby_ctx(chunk_x, chunk_z);
-    ImmediateRebuild(&nearby_ctx, chunk_y + 1);
+  trans_arena->Revert(snapshot);
+
+  for (size_t chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
+    OnLightChange(chunk_x, (s32)chunk_y, chunk_z, light_changes[chunk_y]);
   }
+}
+
+void GameState::OnLightChange(s32 chunk_x, s32 chunk_y, s32 chunk_z, u32 light_changes) {
+  if (!(light_changes & world::LightChangeFlag_Any)) return;
+
+  ChunkColumn* column = world.GetLoadedColumn(chunk_x, chunk_z);
+
+  if (column && chunk_y >= 0 && chunk_y < (s32)kChunkColumnCount) {
+    ++column->section_versions[chunk_y];
+  }
+
+  // A neighbor only samples the layer of blocks touching it, so it's only rebuilt if that border changed.
+  for (s32 dy = -1; dy <= 1; ++dy) {
+    if (dy < 0 && !(light_changes & world::LightChangeFlag_Down)) continue;
+    if (dy > 0 && !(light_changes & world::LightChangeFlag_Up)) continue;
+
+    for (s32 dz = -1; dz <= 1; ++dz) {
+      if (dz < 0 && !(light_changes & world::LightChangeFlag_North)) continue;
+      if (dz > 0 && !(light_changes & world::LightChangeFlag_South)) continue;
 
-  renderer->EndMeshAllocation();
+      for (s32 dx = -1; dx <= 1; ++dx) {
+        if (dx < 0 && !(light_changes & world::LightChangeFlag_West)) continue;
+        if (dx > 0 && !(light_changes & world::LightChangeFlag_East)) continue;
+
+        dirty_sections.Mark(world, chunk_x + dx, chunk_y + dy, chunk_z + dz);
+      }
+    }
+  }
 }
 
-void GameState::ImmediateRebuild(render::ChunkBuildContext* ctx, s32 chunk_y) {
-  s32 chunk_x = ctx->chunk_x;
-  s32 chunk_z = ctx->chunk_z;
+void GameState::FlushLight() {
+  light_engine.Update(world, dimension.flags & world::DimensionFlag_HasSkylight);
+
+  for (size_t i = 0; i < light_engine.section_change_count; ++i) {
+    world::LightSectionChange& change = light_engine.section_changes[i];
 
-  if (build_queue.IsInQueue(chunk_x, chunk_z)) return;
-  // It should always have neighbors if it's not in the build queue, but sanity check anyway.
-  if (!ctx->GetNeighbors(&world)) return;
+    OnLightChange(change.chunk_x, change.chunk_y, change.chunk_z, change.changes);
+  }
 
-  BuildChunkMesh(ctx, chunk_x, chunk_y, chunk_z);
+  light_engine.ClearSectionChanges();
+}
+
+void GameState::FlushDirtySections() {
+  for (size_t i = 0; i < dirty_sections.dirty_count; ++i) {
+    s32 chunk_x = dirty_sections.dirty_columns[i].x;
+    s32 chunk_z = dirty_sections.dirty_columns[i].z;
+
+    // The column could have been unloaded since it was marked.
+    ChunkColumn* column = world.GetLoadedColumn(chunk_x, chunk_z);
+    if (!column) continue;
+
+    u32 section_mask = column->dirty_mask;
+    column->dirty_mask = 0;
+
+    // Chunks still in the build queue will be built with the new data when they become buildable.
+    if (build_scheduler.IsInQueue(column)) continue;
+
+    render::ChunkBuildContext ctx(chunk_x, chunk_z);
+
+    if (!ctx.GetNeighbors(&world)) continue;
+
+    for (s32 chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
+      if (!(section_mask & (1 << chunk_y))) continue;
+
+      // Collapse sections that were edited back to a single block so they stop holding storage and can be skipped.
+      world::Chunk& chunk = column->section.chunks[chunk_y];
+
+      if (chunk.Compact(world.storage_pool) && chunk.IsEmpty()) {
+        column->info.bitmask &= ~(1 << chunk_y);
+      }
+
+      // Any mesh still being built on the workers for this chunk was made from the old data.
+      mesh_pool.Cancel(chunk_x, chunk_y, chunk_z);
+
+      BuildChunkMesh(&ctx, chunk_x, chunk_y, chunk_z);
+    }
+  }
+
+  dirty_sections.Clear(world);
 }
 
 void GameState::FreeMeshes() {
-  for (u32 chunk_z = 0; chunk_z < kChunkCacheSize; ++chunk_z) {
-    for (u32 chunk_x = 0; chunk_x < kChunkCacheSize; ++chunk_x) {
-      ChunkMesh* meshes = world.meshes[chunk_z][chunk_x];
-
-      for (u32 chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
-        ChunkMesh* mesh = meshes + chunk_y;
-
-        for (s32 i = 0; i < kRenderLayerCount; ++i) {
-          if (mesh->meshes[i].vertex_count > 0) {
-            renderer->FreeMesh(&mesh->meshes[i]);
-            mesh->meshes[i].vertex_count = 0;
-          }
-        }
+  for (size_t i = 0; i < world.column_count; ++i) {
+    FreeColumnMeshes(world.columns[i]);
+  }
+}
+
+void GameState::FreeColumnMeshes(ChunkColumn* column) {
+  for (u32 chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
+    ChunkMesh* mesh = column->meshes + chunk_y;
+
+    for (s32 i = 0; i < kRenderLayerCount; ++i) {
+      if (mesh->meshes[i].vertex_count > 0) {
+        renderer->FreeMesh(&mesh->meshes[i]);
+        mesh->meshes[i].vertex_count = 0;
       }
     }
   }
@@ -6,12 +6,16 @@
 #include <polymer/connection.h>
 #include <polymer/input.h>
 #include <polymer/render/block_mesher.h>
+#include <polymer/render/chunk_build_scheduler.h>
+#include <polymer/render/chunk_mesh_pool.h>
 #include <polymer/render/chunk_renderer.h>
 #include <polymer/render/font_renderer.h>
 #include <polymer/types.h>
 #include <polymer/ui/chat_window.h>
 #include <polymer/world/block.h>
+#include <polymer/world/chunk_decode_pool.h>
 #include <polymer/world/dimension.h>
+#include <polymer/world/light_engine.h>
 #include <polymer/world/world.h>
 
 namespace polymer {
@@ -74,25 +78,44 @@ struct GameState {
 
   u32 world_tick;
 
-  render::ChunkBuildQueue build_queue;
+  render::ChunkBuildScheduler build_scheduler;
+  render::DirtySectionSet dirty_sections;
+  world::LightEngine light_engine;
   render::BlockMesher block_mesher;
+  render::ChunkMeshPool mesh_pool;
+  world::ChunkDecodePool decode_pool;
 
   world::BlockRegistry block_registry;
 
   GameState(render::VulkanRenderer* renderer, MemoryArena* perm_arena, MemoryArena* trans_arena);
 
   void OnBlockChange(s32 x, s32 y, s32 z, u32 new_bid);
+  // Decodes the light arrays of an UpdateLight packet into the column.
+  void OnLightUpdate(s32 chunk_x, s32 chunk_z, SpanReader& reader);
+  // Marks a section whose light changed for remeshing, along with the neighbors that sample its changed borders.
+  void OnLightChange(s32 chunk_x, s32 chunk_y, s32 chunk_z, u32 light_changes);
   void OnChunkLoad(s32 chunk_x, s32 chunk_z);
   void OnChunkUnload(s32 chunk_x, s32 chunk_z);
   void OnPlayerPositionAndLook(const Vector3f& position, float yaw, float pitch);
   void OnDimensionChange();
+  void OnViewDistanceChange(u32 view_distance);
 
   void OnWindowMouseMove(s32 dx, s32 dy);
 
+  // Swaps every column that finished decoding into the world. Waits for at least one if wait is set.
+  void PublishDecodedChunks(bool wait);
+  // Applies the changes that arrived while the job's column was decoding on top of the published column.
+  void ApplyDeferredChanges(world::ChunkDecodeJob* job);
+
   void BuildChunkMesh(render::ChunkBuildContext* ctx);
   void BuildChunkMesh(render::ChunkBuildContext* ctx, s32 chunk_x, s32 chunk_y, s32 chunk_z);
 
-  void ImmediateRebuild(render::ChunkBuildContext* ctx, s32 chunk_y);
+  // Propagates the light around every block that changed since the last flush and marks the sections it reached.
+  void FlushLight();
+  // Rebuilds every section that had a block change since the last flush.
+  void FlushDirtySections();
+  void UploadChunkMesh(world::ChunkColumn* column, s32 chunk_y, render::ChunkVertexData& vertex_data);
+  void UploadCompletedMeshes();
 
   void Update(float dt, InputState* input);
   void ProcessMovement(float dt, InputState* input);
@@ -102,6 +125,7 @@ struct GameState {
   void ProcessBuildQueue();
 
   void FreeMeshes();
+  void FreeColumnMeshes(world::ChunkColumn* column);
 
   inline float GetCelestialAngle() {
     float result = (((s32)world_tick - 6000) % 24000) / 24000.0f;
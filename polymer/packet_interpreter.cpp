@@ -1,27 +1,31 @@
 #include <polymer/packet_interpreter.h>
 
-#include <polymer/bitset.h>
 #include <polymer/gamestate.h>
-#include <polymer/miniz.h>
 #include <polymer/nbt.h>
 #include <polymer/protocol.h>
+#include <polymer/session.h>
 #include <polymer/unicode.h>
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #define LOG_PACKET_ID 0
 
-using polymer::world::ChunkSection;
-using polymer::world::ChunkSectionInfo;
 using polymer::world::DimensionCodec;
 using polymer::world::DimensionType;
 using polymer::world::kChunkColumnCount;
 
 namespace polymer {
 
-PacketInterpreter::PacketInterpreter(GameState* game)
-    : game(game), compression(false), inflate_buffer(*game->perm_arena, 65536 * 32) {}
+// Returns how many bytes of the packet haven't been read yet.
+static inline size_t GetPacketRemaining(RingBuffer* rb, size_t packet_start, size_t pkt_size) {
+  size_t consumed = (rb->read_offset + rb->size - packet_start) % rb->size;
+
+  return consumed < pkt_size ? pkt_size - consumed : 0;
+}
+
+PacketInterpreter::PacketInterpreter(GameState* game) : game(game) {}
 
 void PacketInterpreter::InterpretPlay(RingBuffer* rb, u64 pkt_id, size_t pkt_size) {
   MemoryArena* trans_arena = game->trans_arena;
@@ -36,6 +40,7 @@ void PacketInterpreter::InterpretPlay(RingBuffer* rb, u64 pkt_id, size_t pkt_siz
 #endif
 
   auto start_snapshot = trans_arena->GetSnapshot();
+  size_t packet_start = rb->read_offset;
 
   switch (type) {
   case PlayProtocol::SystemChatMessage: {
@@ -169,10 +174,11 @@ void PacketInterpreter::InterpretPlay(RingBuffer* rb, u64 pkt_id, size_t pkt_siz
 
     game->OnChunkUnload(chunk_x, chunk_z);
   } break;
-  case PlayProtocol::KeepAlive: {
-    u64 id = rb->ReadU64();
+  case PlayProtocol::SetRenderDistance: {
+    u64 view_distance = 0;
+    rb->ReadVarInt(&view_distance);
 
-    connection->SendKeepAlive(id);
+    game->OnViewDistanceChange((u32)view_distance);
   } break;
   case PlayProtocol::PlayerPositionAndLook: {
     double x = rb->ReadDouble();
@@ -246,6 +252,8 @@ void PacketInterpreter::InterpretPlay(RingBuffer* rb, u64 pkt_id, size_t pkt_siz
     }
 
     game->dimension_codec.Parse(*game->perm_arena, *dimension_codec_nbt);
+    game->world.biome_codec.Parse(*game->perm_arena, *dimension_codec_nbt, game->assets.grass_colormap,
+                                  game->assets.foliage_colormap);
 
     String dimension_type_string;
     dimension_type_string.data = memory_arena_push_type_count(trans_arena, char, 32767);
@@ -272,6 +280,16 @@ void PacketInterpreter::InterpretPlay(RingBuffer* rb, u64 pkt_id, size_t pkt_siz
       printf("Dimension: %.*s\n", (u32)dimension_identifier.size, dimension_identifier.data);
     }
 
+    u64 hashed_seed = rb->ReadU64();
+
+    u64 max_players = 0;
+    rb->ReadVarInt(&max_players);
+
+    u64 view_distance = 0;
+    rb->ReadVarInt(&view_distance);
+
+    game->OnViewDistanceChange((u32)view_distance);
+
     printf("Entered dimension with height range of %d to %d\n", game->dimension.min_y,
            (game->dimension.height + game->dimension.min_y));
   } break;
@@ -336,253 +354,69 @@ void PacketInterpreter::InterpretPlay(RingBuffer* rb, u64 pkt_id, size_t pkt_siz
     s32 chunk_x = rb->ReadU32();
     s32 chunk_z = rb->ReadU32();
 
-    String sstr;
-    sstr.data = memory_arena_push_type_count(trans_arena, char, 32767);
-    sstr.size = 32767;
-
-    nbt::TagCompound* nbt = memory_arena_push_type(trans_arena, nbt::TagCompound);
-
-    if (!nbt::Parse(*rb, *trans_arena, nbt)) {
-      fprintf(stderr, "Failed to parse chunk nbt.\n");
-      fflush(stderr);
-    }
-
-    u64 data_size;
-    rb->ReadVarInt(&data_size);
-
-    size_t new_offset = (rb->read_offset + data_size) % rb->size;
-
-    u32 x_index = game->world.GetChunkCacheIndex(chunk_x);
-    u32 z_index = game->world.GetChunkCacheIndex(chunk_z);
-
-    ChunkSection* section = &game->world.chunks[z_index][x_index];
-    ChunkSectionInfo* section_info = &game->world.chunk_infos[z_index][x_index];
-
-    section_info->x = chunk_x;
-    section_info->z = chunk_z;
-    section_info->bitmask = 0;
+    world::ChunkDecodePool& decode_pool = game->decode_pool;
+    size_t packet_size = GetPacketRemaining(rb, packet_start, pkt_size);
 
-    if (data_size > 0) {
-      u32 end_y = kChunkColumnCount;
-      u64 start_y = 0;
-
-      if (game->dimension.height > 0) {
-        end_y = game->dimension.height / 16;
-        start_y = (game->dimension.min_y / 16) + (64 / 16);
-      }
-
-      for (u64 chunk_y = start_y; chunk_y < end_y; ++chunk_y) {
-        // Read Chunk data here
-        u16 block_count = rb->ReadU16();
-        u8 bpb = rb->ReadU8();
-
-        if (block_count > 0) {
-          section_info->bitmask |= (1 << chunk_y);
-        }
-
-        u64* palette = nullptr;
-        u64 single_palette = 0;
-
-        if (bpb == 0) {
-          rb->ReadVarInt(&single_palette);
-          palette = &single_palette;
-        } else if (bpb < 9) {
-          if (bpb < 4) bpb = 4;
-
-          u64 palette_length = 0;
-          rb->ReadVarInt(&palette_length);
-
-          palette = memory_arena_push_type_count(trans_arena, u64, (size_t)palette_length);
-
-          for (u64 i = 0; i < palette_length; ++i) {
-            u64 palette_data;
-            rb->ReadVarInt(&palette_data);
-            palette[i] = palette_data;
-          }
-        }
-
-        u32* chunk = (u32*)section->chunks[chunk_y].blocks;
-
-        u64 data_array_length;
-        rb->ReadVarInt(&data_array_length);
-
-        u64 id_mask = (1LL << bpb) - 1;
-        u64 block_index = 0;
-
-        // Fill out entire chunk with the one block palette
-        if (data_array_length == 0 && bpb == 0) {
-          for (int i = 0; i < 16 * 16 * 16; ++i) {
-            chunk[i] = (u32)single_palette;
-          }
-        }
+    world::ChunkDecodeJob* job = decode_pool.Acquire(chunk_x, chunk_z, packet_size);
 
-        for (u64 i = 0; i < data_array_length; ++i) {
-          u64 data_value = rb->ReadU64();
-
-          for (u64 j = 0; j < 64 / bpb; ++j) {
-            size_t palette_index = (size_t)((data_value >> (j * bpb)) & id_mask);
-
-            if (palette) {
-              chunk[block_index++] = (u32)palette[palette_index];
-            } else {
-              chunk[block_index++] = (u32)palette_index;
-            }
-          }
-        }
-
-        u8 biome_bpe = rb->ReadU8();
-
-        u64* biome_palette = nullptr;
-        u64 single_biome_palette = 0;
-
-        if (biome_bpe == 0) {
-          rb->ReadVarInt(&single_biome_palette);
-          biome_palette = &single_biome_palette;
-        } else if (biome_bpe < 9) {
-          u64 biome_palette_length = 0;
-          rb->ReadVarInt(&biome_palette_length);
-
-          biome_palette = memory_arena_push_type_count(trans_arena, u64, (size_t)biome_palette_length);
-
-          for (u64 i = 0; i < biome_palette_length; ++i) {
-            u64 biome_palette_data;
-            rb->ReadVarInt(&biome_palette_data);
-            biome_palette[i] = biome_palette_data;
-          }
-        }
-
-        u64 biome_data_array_length;
-        rb->ReadVarInt(&biome_data_array_length);
-
-        u64 biome_id_mask = (1LL << biome_bpe) - 1;
-        u64 biome_index = 0;
-
-        for (u64 i = 0; i < biome_data_array_length; ++i) {
-          u64 data_value = rb->ReadU64();
-
-          for (u64 j = 0; j < 64 / biome_bpe; ++j) {
-            size_t palette_index = (size_t)((data_value >> (j * biome_bpe)) & biome_id_mask);
-
-            if (biome_palette) {
-              // u32 biome_id = (u32)biome_palette[palette_index];
-            } else {
-              // u32 biome_id = (u32)palette_index;
-            }
-
-            ++biome_index;
-          }
-        }
-      }
-    }
-
-    // Delay the chunk load call until the entire section is loaded.
-    game->OnChunkLoad(chunk_x, chunk_z);
-
-    // Jump to after the data because the data_size can be larger than actual chunk data sent according to
-    // documentation.
-    rb->read_offset = new_offset;
-
-    u64 block_entity_count;
-    rb->ReadVarInt(&block_entity_count);
-
-    for (size_t i = 0; i < block_entity_count; ++i) {
-      u8 packed_xz = rb->ReadU8();
-      s16 y = rb->ReadU16();
-
-      u64 type;
-      rb->ReadVarInt(&type);
-
-      ArenaSnapshot snapshot = trans_arena->GetSnapshot();
-      nbt::TagCompound* block_entity_nbt = memory_arena_push_type(trans_arena, nbt::TagCompound);
-
-      if (!nbt::Parse(*rb, *trans_arena, block_entity_nbt)) {
-        fprintf(stderr, "Failed to parse block entity nbt.\n");
-        fflush(stderr);
-      }
-
-      trans_arena->Revert(snapshot);
-    }
-
-    BitSet skylight_mask;
-    if (!skylight_mask.Read(*trans_arena, *rb)) {
-      fprintf(stderr, "Failed to read skylight mask\n");
-      fflush(stderr);
-      break;
+    // Every job is in flight, so wait for the workers to finish some before continuing.
+    while (!job && decode_pool.GetInFlightCount() > 0) {
+      game->PublishDecodedChunks(true);
+      job = decode_pool.Acquire(chunk_x, chunk_z, packet_size);
     }
 
-    BitSet blocklight_mask;
-    if (!blocklight_mask.Read(*trans_arena, *rb)) {
-      fprintf(stderr, "Failed to read blocklight mask\n");
+    if (!job) {
+      fprintf(stderr, "Failed to acquire decode job for chunk (%d, %d).\n", chunk_x, chunk_z);
       fflush(stderr);
       break;
     }
 
-    BitSet empty_skylight_mask;
-    if (!empty_skylight_mask.Read(*trans_arena, *rb)) {
-      fprintf(stderr, "Failed to read empty skylight mask\n");
-      fflush(stderr);
-      break;
-    }
+    const u8* packet = rb->ReadContiguous(*trans_arena, packet_size);
 
-    BitSet empty_blocklight_mask;
-    if (!empty_blocklight_mask.Read(*trans_arena, *rb)) {
-      fprintf(stderr, "Failed to read empty blocklight mask\n");
-      fflush(stderr);
+    if (!packet) {
+      decode_pool.Release(job);
       break;
     }
 
-    for (size_t i = 0; i < kChunkColumnCount; ++i) {
-      memset(section->chunks[i].lightmap, 0, sizeof(section->chunks[i].lightmap));
-    }
+    // The rest of the packet is decoded on a worker and published into the world once the whole column is done.
+    memcpy(job->packet, packet, packet_size);
 
-    u64 skylight_array_count = 0;
-    rb->ReadVarInt(&skylight_array_count);
+    job->min_y = game->dimension.min_y;
+    job->height = game->dimension.height;
 
-    for (size_t i = 0; i < 26; ++i) {
-      if (!skylight_mask.IsSet(i)) continue;
+    decode_pool.Submit(job);
+  } break;
+  case PlayProtocol::UpdateLight: {
+    u64 chunk_x = 0;
+    u64 chunk_z = 0;
 
-      u64 skylight_length = 0;
+    rb->ReadVarInt(&chunk_x);
+    rb->ReadVarInt(&chunk_z);
 
-      rb->ReadVarInt(&skylight_length);
-      rb->ReadRawString(&sstr, skylight_length);
+    SpanReader light_reader = rb->ReadSpan(*trans_arena, GetPacketRemaining(rb, packet_start, pkt_size));
 
-      if (i == 0 || i == 25) continue;
+    // The light has to be applied on top of the column's ChunkData if it's still being decoded, so it's kept until
+    // the column is published.
+    world::ChunkDecodeJob* job = game->decode_pool.GetDecoding((s32)chunk_x, (s32)chunk_z);
 
-      size_t chunk_y = i - 1;
+    if (job) {
+      size_t light_size = light_reader.data ? light_reader.GetRemaining() : 0;
+      world::DeferredChange* change =
+          game->decode_pool.PushDeferred(job, world::DeferredChangeType::Light, light_size);
 
-      for (size_t index = 0; index < skylight_length; ++index) {
-        size_t block_data_index = index * 2;
-        u8* lightmap = (u8*)section->chunks[chunk_y].lightmap;
+      if (change) {
+        change->x = (s32)chunk_x;
+        change->z = (s32)chunk_z;
 
-        lightmap[block_data_index] = sstr.data[index] & 0x0F;
-        lightmap[block_data_index + 1] = (sstr.data[index] & 0xF0) >> 4;
+        if (light_size > 0) {
+          memcpy(change + 1, light_reader.data + light_reader.offset, light_size);
+        }
       }
-    }
-
-    u64 blocklight_array_count = 0;
-    rb->ReadVarInt(&blocklight_array_count);
-
-    for (size_t i = 0; i < 26; ++i) {
-      if (!blocklight_mask.IsSet(i)) continue;
 
-      u64 blocklight_length = 0;
-
-      rb->ReadVarInt(&blocklight_length);
-      rb->ReadRawString(&sstr, blocklight_length);
-
-      if (i == 0 || i == 25) continue;
-
-      size_t chunk_y = i - 1;
-
-      for (size_t index = 0; index < blocklight_length; ++index) {
-        size_t block_data_index = index * 2;
-        u8* lightmap = (u8*)section->chunks[chunk_y].lightmap;
-
-        // Merge the block lightmap into the packed chunk lightmap
-        lightmap[block_data_index] |= (sstr.data[index] & 0x0F) << 4;
-        lightmap[block_data_index + 1] |= (sstr.data[index] & 0xF0);
-      }
+      break;
     }
+
+    game->OnLightUpdate((s32)chunk_x, (s32)chunk_z, light_reader);
   } break;
   case PlayProtocol::PlayerInfoUpdate: {
     u8 action_bitmask = rb->ReadU8();
@@ -815,8 +649,60 @@ void PacketInterpreter::InterpretLogin(RingBuffer* rb, u64 pkt_id, size_t pkt_si
     connection->Disconnect();
   } break;
   case LoginProtocol::EncryptionRequest: {
-    printf("EncryptionRequest. Not yet implemented\n");
-    connection->Disconnect();
+    SpanReader reader = rb->ReadSpan(*trans_arena, pkt_size);
+    u64 server_id_size = 0;
+    u64 public_key_size = 0;
+    u64 verify_token_size = 0;
+
+    // Every length is checked against what's left in the packet before it's used, so a bad request can't make the
+    // key import or hashing read past it.
+    const u8* server_id_data = nullptr;
+    const u8* public_key = nullptr;
+    const u8* verify_token = nullptr;
+
+    if (reader.ReadVarInt(&server_id_size) && server_id_size <= kMaxServerIdSize) {
+      server_id_data = reader.ReadBytes((size_t)server_id_size);
+    }
+
+    if (server_id_data && reader.ReadVarInt(&public_key_size) && public_key_size <= kMaxPublicKeySize) {
+      public_key = reader.ReadBytes((size_t)public_key_size);
+    }
+
+    if (public_key && reader.ReadVarInt(&verify_token_size) && verify_token_size <= kMaxEncryptedSize) {
+      verify_token = reader.ReadBytes((size_t)verify_token_size);
+    }
+
+    if (!verify_token || reader.overflow) {
+      fprintf(stderr, "Received malformed encryption request.\n");
+      connection->Disconnect();
+      break;
+    }
+
+    String server_id((char*)server_id_data, (size_t)server_id_size);
+
+    encrypted_secret_size = sizeof(encrypted_secret);
+    encrypted_token_size = sizeof(encrypted_token);
+
+    if (!GenerateSharedSecret(shared_secret, sizeof(shared_secret)) ||
+        !EncryptWithPublicKey(public_key, public_key_size, shared_secret, sizeof(shared_secret), encrypted_secret,
+                              &encrypted_secret_size) ||
+        !EncryptWithPublicKey(public_key, public_key_size, verify_token, verify_token_size, encrypted_token,
+                              &encrypted_token_size)) {
+      connection->Disconnect();
+      break;
+    }
+
+    if (access_token.size > 0) {
+      char server_hash[kServerHashSize];
+
+      ComputeServerHash(server_id, shared_secret, sizeof(shared_secret), public_key, public_key_size, server_hash);
+
+      // The response is sent from Interpret once the session server accepts the join.
+      session_join.Start(access_token, profile_uuid, server_hash);
+    } else {
+      printf("Server requested encryption without an access token, so the session isn't authenticated.\n");
+      SendEncryptionResponse();
+    }
   } break;
   case LoginProtocol::LoginSuccess: {
     printf("Login success\n");
@@ -824,8 +710,15 @@ void PacketInterpreter::InterpretLogin(RingBuffer* rb, u64 pkt_id, size_t pkt_si
     fflush(stdout);
   } break;
   case LoginProtocol::SetCompression: {
-    compression = true;
-    connection->builder.flags &= ~(PacketBuilder::BuildFlag_OmitCompress);
+    u64 threshold = 0;
+
+    rb->ReadVarInt(&threshold);
+
+    // A negative threshold disables compression.
+    if ((s32)threshold >= 0) {
+      connection->builder.compression_threshold = (size_t)(s32)threshold;
+      connection->builder.flags &= ~(PacketBuilder::BuildFlag_OmitCompress);
+    }
   } break;
   default:
     break;
@@ -845,80 +738,80 @@ void PacketInterpreter::InterpretStatus(RingBuffer* rb, u64 pkt_id, size_t pkt_s
 #endif
 }
 
-void PacketInterpreter::Interpret() {
-  MemoryArena* trans_arena = game->trans_arena;
+void PacketInterpreter::SendEncryptionResponse() {
   Connection* connection = &game->connection;
-  RingBuffer* rb = &connection->read_buffer;
 
-  do {
-    size_t offset_snapshot = rb->read_offset;
-    u64 pkt_size = 0;
-    u64 pkt_id = 0;
+  connection->SendEncryptionResponse(encrypted_secret, encrypted_secret_size, encrypted_token, encrypted_token_size);
+  connection->EnableEncryption(shared_secret);
+}
 
-    if (!rb->ReadVarInt(&pkt_size)) {
-      break;
-    }
+void PacketInterpreter::Interpret() {
+  Connection* connection = &game->connection;
+  SpscQueue* inbound = &connection->inbound;
 
-    if (rb->GetReadAmount() < pkt_size) {
-      rb->read_offset = offset_snapshot;
-      break;
+  // Nothing else arrives until the encryption response is sent, since the network thread waits for the key.
+  switch (session_join.Poll()) {
+  case SessionJoin::Status::Success: {
+    if (connection->connected) {
+      SendEncryptionResponse();
     }
+  } break;
+  case SessionJoin::Status::Failure: {
+    connection->Disconnect();
+  } break;
+  default:
+    break;
+  }
 
-    size_t target_offset = (rb->read_offset + pkt_size) % rb->size;
+  // View over one packet at a time. The queue is mirrored, so the packets can be read without wrapping.
+  RingBuffer packet_buffer(*game->trans_arena, 0);
 
-    if (compression) {
-      u64 payload_size;
+  packet_buffer.data = inbound->data;
+  packet_buffer.size = inbound->size;
+  packet_buffer.mirrored = true;
 
-      rb->ReadVarInt(&payload_size);
+  RingBuffer* rb = &packet_buffer;
+  size_t available = inbound->GetReadAmount();
 
-      if (payload_size > 0) {
-        inflate_buffer.write_offset = inflate_buffer.read_offset = 0;
+  // The handlers can disconnect, which stops anything else from being interpreted.
+  while (available >= kPacketRecordHeaderSize && connection->connected) {
+    const u8* record = inbound->GetReadPointer();
+    u32 record_size = 0;
 
-        mz_ulong mz_size = (mz_ulong)inflate_buffer.size;
-        // Use the entire remaining packet as source length
-        mz_ulong source_len = (mz_ulong)(pkt_size - GetVarIntSize(payload_size));
+    memcpy(&record_size, record, sizeof(record_size));
 
-        // The connection read buffer is mirrored in virtual memory, so it is free to read off the end of the buffer for
-        // uncompressing.
-        int result =
-            mz_uncompress((u8*)inflate_buffer.data, (mz_ulong*)&mz_size, (u8*)rb->data + rb->read_offset, source_len);
+    size_t record_offset = (size_t)(record - inbound->data);
 
-        if (result == MZ_OK) {
-          // Swap to inflate buffer and set pkt_size to new decompressed size.
-          rb = &inflate_buffer;
-          pkt_size = mz_size;
-        } else {
-          // Decompression failed.
-          fprintf(stderr, "Failed to decompress packet. Skipping.\n");
-          fflush(stderr);
-          rb->read_offset = target_offset;
-          continue;
-        }
-      }
-    }
+    rb->read_offset = (record_offset + kPacketRecordHeaderSize) % rb->size;
+    rb->write_offset = (rb->read_offset + record_size) % rb->size;
 
-    bool id_read = rb->ReadVarInt(&pkt_id);
-    assert(id_read);
+    size_t id_offset = rb->read_offset;
+    u64 pkt_id = 0;
 
-    switch (connection->protocol_state) {
-    case ProtocolState::Status:
-      this->InterpretStatus(rb, pkt_id, (size_t)pkt_size);
-      break;
-    case ProtocolState::Login:
-      this->InterpretLogin(rb, pkt_id, (size_t)pkt_size);
-      break;
-    case ProtocolState::Play:
-      this->InterpretPlay(rb, pkt_id, (size_t)pkt_size);
-      break;
-    default:
-      break;
-    }
+    if (record_size > 0 && rb->ReadVarInt(&pkt_id)) {
+      // The handlers are given the size of the packet after its id.
+      size_t id_size = (rb->read_offset + rb->size - id_offset) % rb->size;
+      size_t pkt_size = record_size - id_size;
 
-    rb = &connection->read_buffer;
+      switch (connection->protocol_state) {
+      case ProtocolState::Status:
+        this->InterpretStatus(rb, pkt_id, pkt_size);
+        break;
+      case ProtocolState::Login:
+        this->InterpretLogin(rb, pkt_id, pkt_size);
+        break;
+      case ProtocolState::Play:
+        this->InterpretPlay(rb, pkt_id, pkt_size);
+        break;
+      default:
+        break;
+      }
+    }
 
-    // Always skip to the next packet in case some data wasn't read.
-    rb->read_offset = target_offset;
-  } while (rb->read_offset != rb->write_offset);
+    // The network thread only queues whole packets, so this never passes the write offset.
+    inbound->CommitRead(kPacketRecordHeaderSize + record_size);
+    available -= kPacketRecordHeaderSize + record_size;
+  }
 }
 
 } // namespace polymer
@@ -2,6 +2,8 @@
 #define POLYMER_PACKET_INTERPRETER_H_
 
 #include <polymer/buffer.h>
+#include <polymer/cipher.h>
+#include <polymer/session.h>
 #include <polymer/types.h>
 
 namespace polymer {
@@ -10,15 +12,29 @@ struct GameState;
 
 struct PacketInterpreter {
   GameState* game;
-  bool compression;
 
-  RingBuffer inflate_buffer;
+  // Used to join the session when the server requests encryption. Empty when playing offline.
+  String access_token;
+  String profile_uuid;
+
+  // The encryption response is held back until the session join completes, since the server checks the session as
+  // soon as it gets the response.
+  SessionJoin session_join;
+  u8 shared_secret[kCipherKeySize];
+  u8 encrypted_secret[kMaxEncryptedSize];
+  u8 encrypted_token[kMaxEncryptedSize];
+  size_t encrypted_secret_size = 0;
+  size_t encrypted_token_size = 0;
 
   PacketInterpreter(GameState* game);
 
+  // Interprets every packet that the network thread has queued.
   void Interpret();
 
 private:
+  void SendEncryptionResponse();
+
+  // The pkt_size is the number of bytes in the packet after its id.
   void InterpretStatus(RingBuffer* rb, u64 pkt_id, size_t pkt_size);
   void InterpretLogin(RingBuffer* rb, u64 pkt_id, size_t pkt_size);
   void InterpretPlay(RingBuffer* rb, u64 pkt_id, size_t pkt_size);
@@ -95,12 +95,16 @@ struct LaunchArgs {
   String username;
   String server;
   u16 server_port;
+  String access_token;
+  String profile_uuid;
   bool help;
 
   static LaunchArgs Create(ArgParser& args) {
     const String kUsernameArgs[] = {POLY_STR("username"), POLY_STR("user"), POLY_STR("u")};
     const String kServerArgs[] = {POLY_STR("server"), POLY_STR("s")};
     const String kHelpArgs[] = {POLY_STR("help"), POLY_STR("h")};
+    const String kAccessTokenArgs[] = {POLY_STR("access-token"), POLY_STR("token")};
+    const String kUuidArgs[] = {POLY_STR("uuid")};
 
     constexpr const char* kDefaultServerIp = "127.0.0.1";
     constexpr u16 kDefaultServerPort = 25565;
@@ -138,6 +142,9 @@ struct LaunchArgs {
       }
     }
 
+    result.access_token = args.GetValue(kAccessTokenArgs, polymer_array_count(kAccessTokenArgs));
+    result.profile_uuid = args.GetValue(kUuidArgs, polymer_array_count(kUuidArgs));
+
     result.help = args.HasValue(kHelpArgs, polymer_array_count(kHelpArgs));
 
     return result;
@@ -150,6 +157,8 @@ inline void PrintUsage() {
   printf("OPTIONS:\n");
   printf("\t-u, --user, --username\tOffline username. Default: polymer\n");
   printf("\t-s, --server\t\tDirect server. Default: 127.0.0.1:25565\n");
+  printf("\t--token, --access-token\tAccount access token for joining online mode servers.\n");
+  printf("\t--uuid\t\t\tAccount profile id for joining online mode servers.\n");
 }
 
 } // namespace polymer
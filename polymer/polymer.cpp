@@ -31,6 +31,7 @@ Polymer::Polymer(MemoryArena& perm_arena, MemoryArena& trans_arena, int argc, ch
 
 int Polymer::Run(InputState* input) {
   constexpr size_t kMirrorBufferSize = 65536 * 32;
+  constexpr size_t kInboundQueueSize = 65536 * 256;
 
   renderer.platform = &platform;
 
@@ -71,19 +72,36 @@ int Polymer::Run(InputState* input) {
 
   connection->interpreter = &interpreter;
 
+  interpreter.access_token = args.access_token;
+  interpreter.profile_uuid = args.profile_uuid;
+
   // Allocate mirrored ring buffers so they can always be inflated
   connection->read_buffer.size = kMirrorBufferSize;
   connection->read_buffer.data = AllocateMirroredBuffer(connection->read_buffer.size);
   connection->write_buffer.size = kMirrorBufferSize;
   connection->write_buffer.data = AllocateMirroredBuffer(connection->write_buffer.size);
+  connection->read_buffer.mirrored = true;
+  connection->write_buffer.mirrored = true;
+
+  // Holds the decompressed packets until the game thread gets to them, so it needs room for a join's worth of chunks.
+  connection->inbound.size = kInboundQueueSize;
+  connection->inbound.data = AllocateMirroredBuffer(connection->inbound.size);
 
   assert(connection->read_buffer.data);
   assert(connection->write_buffer.data);
+  assert(connection->inbound.data);
 
   this->window = platform.WindowCreate(kWidth, kHeight);
 
   renderer.Initialize(window);
 
+  const size_t kMaxChunkMeshes = world::kMaxChunkColumns * world::kChunkColumnCount * render::kRenderLayerCount;
+
+  if (!renderer.CreateMeshHeap(sizeof(render::ChunkVertex), render::kChunkHeapVertexCapacity,
+                               render::kChunkHeapIndexCapacity, render::kChunkHeapTintCapacity, kMaxChunkMeshes)) {
+    return 1;
+  }
+
   {
     auto start = std::chrono::high_resolution_clock::now();
 
@@ -104,6 +122,15 @@ int Polymer::Run(InputState* input) {
     game->font_renderer.glyph_size_table = game->assets.glyph_size_table;
 
     game->block_mesher.mapping.Initialize(game->block_registry);
+    game->light_engine.LoadBlocks(perm_arena, game->block_registry);
+
+    if (!game->mesh_pool.Initialize(perm_arena, game->assets, game->block_registry, game->block_mesher)) {
+      return 1;
+    }
+
+    if (!game->decode_pool.Initialize(perm_arena, game->world.storage_pool)) {
+      return 1;
+    }
   }
 
   game->chunk_renderer.CreateLayoutSet(renderer, renderer.device);
@@ -141,6 +168,11 @@ int Polymer::Run(InputState* input) {
                             ProtocolState::Login);
   connection->SendLoginStart(args.username.data, args.username.size);
 
+  if (!connection->StartNetworkThread()) {
+    connection->Disconnect();
+    return 1;
+  }
+
   memcpy(game->player_manager.client_name, args.username.data, args.username.size);
   game->player_manager.client_name[args.username.size] = 0;
 
@@ -206,6 +238,13 @@ int Polymer::Run(InputState* input) {
     average_frame_time = average_frame_time * 0.9f + frame_time * 0.1f;
   }
 
+  connection->Disconnect();
+
+  game->decode_pool.Shutdown();
+  game->mesh_pool.Shutdown();
+  // The decode and mesh workers are done with the sections, so their storage can be given back.
+  game->world.storage_pool.Shutdown();
+
   vkDeviceWaitIdle(renderer.device);
   game->FreeMeshes();
 
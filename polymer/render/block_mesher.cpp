@@ -21,72 +21,222 @@ using polymer::world::RenderableFace;
 namespace polymer {
 namespace render {
 
-struct BorderedChunk {
-  constexpr static size_t kElementCount = 18 * 18 * 18;
+struct LayerData {
+  render::ChunkVertex* vertices;
+  u32* count;
+};
+
+// The tintindex values that the block models are set up with.
+constexpr u32 kGrassTintIndex = 0;
+constexpr u32 kLeafTintIndex = 1;
+constexpr u32 kSpruceLeafTintIndex = 2;
+constexpr u32 kBirchLeafTintIndex = 3;
+constexpr u32 kWaterTintIndex = 50;
+
+// Spruce and birch leaves aren't affected by biome coloring.
+constexpr u32 kSpruceLeafColor = 0x619961;
+constexpr u32 kBirchLeafColor = 0x80A755;
+
+constexpr u32 kUntintedColor = 0xFFFFFFFF;
+
+// Blends the colors in the 5x5 area around the block, which is the vanilla client's default biome blend radius.
+// The area covers at most two cells on each axis, so the cells are weighted by how many of its blocks they contain.
+static u32 BlendBiomeColor(const u32* colors, size_t x, size_t y, size_t z) {
+  s32 start_x = (s32)x - 2;
+  s32 start_z = (s32)z - 2;
+
+  s32 cell_x = (start_x + 4) / 4 - 1;
+  s32 cell_z = (start_z + 4) / 4 - 1;
+  s32 cell_y = (s32)y / 4;
+
+  s32 first_x = (cell_x + 1) * 4 - start_x;
+  s32 first_z = (cell_z + 1) * 4 - start_z;
+
+  s32 weights_x[2] = {first_x < 5 ? first_x : 5, first_x < 5 ? 5 - first_x : 0};
+  s32 weights_z[2] = {first_z < 5 ? first_z : 5, first_z < 5 ? 5 - first_z : 0};
+
+  u32 r = 0;
+  u32 g = 0;
+  u32 b = 0;
 
-  u32 blocks[kElementCount];
+  for (s32 i = 0; i < 2; ++i) {
+    for (s32 j = 0; j < 2; ++j) {
+      u32 weight = (u32)(weights_x[i] * weights_z[j]);
 
-  // The bottom 4 bits contain the skylight data and the upper 4 bits contain the block
-  u8 lightmap[kElementCount];
+      if (weight == 0) continue;
 
-  // Position is chunk relative
-  inline u8 GetBlockLight(size_t index) const {
-    return lightmap[index] >> 4;
+      u32 color = colors[BorderedChunk::GetBiomeCellIndex(cell_x + i, cell_y, cell_z + j)];
+
+      r += ((color >> 16) & 0xFF) * weight;
+      g += ((color >> 8) & 0xFF) * weight;
+      b += (color & 0xFF) * weight;
+    }
   }
 
-  // Position is chunk relative
-  inline u8 GetSkyLight(size_t index) const {
-    return lightmap[index] & 0x0F;
+  return ((r / 25) << 16) | ((g / 25) << 8) | (b / 25);
+}
+
+// Packs a 0xRRGGBB color into the vertex's RGBA8 tint. The tinted textures are darkened to account for the tint, so
+// they are brightened back up here instead of in the shader.
+inline u32 PackTint(u32 color) {
+  u32 r = ((color >> 16) & 0xFF) * 10 / 9;
+  u32 g = ((color >> 8) & 0xFF) * 10 / 9;
+  u32 b = (color & 0xFF) * 10 / 9;
+
+  r = r > 0xFF ? 0xFF : r;
+  g = g > 0xFF ? 0xFF : g;
+  b = b > 0xFF ? 0xFF : b;
+
+  return r | (g << 8) | (b << 16) | (0xFF << 24);
+}
+
+u8 TintPalette::GetIndex(u32 color) {
+  if (count > 0 && color == last_color) return last_index;
+
+  size_t index = 0;
+
+  while (index < count && colors[index] != color) {
+    ++index;
   }
-};
 
-BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s32 chunk_y);
+  if (index == count) {
+    if (count < render::kChunkTintPaletteSize) {
+      colors[count++] = color;
+    } else {
+      // Only possible with a lot of blended biome borders in one section, so the closest color is close enough.
+      u32 best_distance = 0xFFFFFFFF;
+
+      for (size_t i = 0; i < count; ++i) {
+        s32 dr = (s32)(colors[i] & 0xFF) - (s32)(color & 0xFF);
+        s32 dg = (s32)((colors[i] >> 8) & 0xFF) - (s32)((color >> 8) & 0xFF);
+        s32 db = (s32)((colors[i] >> 16) & 0xFF) - (s32)((color >> 16) & 0xFF);
+        u32 distance = (u32)(dr * dr + dg * dg + db * db);
+
+        if (distance < best_distance) {
+          best_distance = distance;
+          index = i;
+        }
+      }
+    }
+  }
 
-struct LayerData {
-  render::ChunkVertex* vertices;
-  u32* count;
-};
+  last_color = color;
+  last_index = (u8)index;
+
+  return last_index;
+}
 
 struct PushContext {
   MemoryArena* vertex_arenas[kRenderLayerCount];
   MemoryArena* index_arenas[kRenderLayerCount];
+  TintPalette* tint_palettes[kRenderLayerCount];
   bool anim_repeat;
 
+  // The tints of the block being meshed. They are only blended the first time one of its faces is tinted.
+  BorderedChunk* bordered_chunk = nullptr;
+  size_t tint_x = 0;
+  size_t tint_y = 0;
+  size_t tint_z = 0;
+  bool tints_resolved = false;
+  u32 grass_tint = 0;
+  u32 foliage_tint = 0;
+  u32 water_tint = 0;
+
   PushContext(bool anim_repeat) : anim_repeat(anim_repeat) {}
 
-  void SetLayerData(RenderLayer layer, MemoryArena* vertex_arena, MemoryArena* index_arena) {
+  void SetLayerData(RenderLayer layer, MemoryArena* vertex_arena, MemoryArena* index_arena, TintPalette* tint_palette) {
     vertex_arenas[(size_t)layer] = vertex_arena;
     index_arenas[(size_t)layer] = index_arena;
+    tint_palettes[(size_t)layer] = tint_palette;
+  }
+
+  void SetTintBlock(size_t x, size_t y, size_t z) {
+    tint_x = x;
+    tint_y = y;
+    tint_z = z;
+    tints_resolved = false;
+  }
+
+  u32 GetTint(u32 tintindex) {
+    switch (tintindex) {
+    case kGrassTintIndex:
+    case kLeafTintIndex:
+    case kWaterTintIndex: {
+      if (!tints_resolved) {
+        grass_tint = PackTint(BlendBiomeColor(bordered_chunk->grass_colors, tint_x, tint_y, tint_z));
+        foliage_tint = PackTint(BlendBiomeColor(bordered_chunk->foliage_colors, tint_x, tint_y, tint_z));
+        water_tint = PackTint(BlendBiomeColor(bordered_chunk->water_colors, tint_x, tint_y, tint_z));
+        tints_resolved = true;
+      }
+
+      if (tintindex == kGrassTintIndex) return grass_tint;
+      if (tintindex == kLeafTintIndex) return foliage_tint;
+
+      return water_tint;
+    }
+    case kSpruceLeafTintIndex: {
+      return PackTint(kSpruceLeafColor);
+    }
+    case kBirchLeafTintIndex: {
+      return PackTint(kBirchLeafColor);
+    }
+    default: {
+      return kUntintedColor;
+    }
+    }
   }
 };
 
+inline u32 PackVertexPosition(const Vector3f& position) {
+  s32 x = (s32)floorf((position.x + kChunkVertexPositionOffset) * kChunkVertexPositionScale + 0.5f);
+  s32 y = (s32)floorf((position.y + kChunkVertexPositionOffset) * kChunkVertexPositionScale + 0.5f);
+  s32 z = (s32)floorf((position.z + kChunkVertexPositionOffset) * kChunkVertexPositionScale + 0.5f);
+
+  x = Clamp(x, 0, 0x3FF);
+  y = Clamp(y, 0, 0x3FF);
+  z = Clamp(z, 0, 0x3FF);
+
+  return (u32)x | ((u32)y << 10) | ((u32)z << 20);
+}
+
+// Position is relative to the section origin.
 inline u16 PushVertex(PushContext& ctx, const Vector3f& position, const Vector2f& uv, RenderableFace* face, u16 light,
-                      u32 axis_data = 0) {
-  render::ChunkVertex* vertex =
-      (render::ChunkVertex*)ctx.vertex_arenas[face->render_layer]->Allocate(sizeof(render::ChunkVertex), 1);
+                      u32 tint, u32 axis_data = 0) {
+  MemoryArena* arena = ctx.vertex_arenas[face->render_layer];
+
+  // The arena holds exactly as many vertices as a u16 can index. Quads past that collapse onto the first vertex so they
+  // become degenerate instead of wrapping around to other geometry.
+  if ((size_t)(arena->current - arena->base) + sizeof(render::ChunkVertex) > arena->max_size) {
+    assert(!"Section layer has too many vertices");
+    return 0;
+  }
 
-  vertex->position = position;
+  render::ChunkVertex* vertex = (render::ChunkVertex*)arena->Allocate(sizeof(render::ChunkVertex), 1);
 
-  u16 uv_x = (u16)(uv.x * 16);
-  u16 uv_y = (u16)(uv.y * 16);
+  vertex->packed_position = PackVertexPosition(position);
 
-  vertex->packed_uv = (uv_x << 5) | (uv_y & 0x1F);
+  u32 uv_x = (u32)(uv.x * 16);
+  u32 uv_y = (u32)(uv.y * 16);
 
-  vertex->texture_id = face->texture_id;
+  assert(face->texture_id <= 0x3FFF);
+  vertex->packed_texture = (face->texture_id & 0x3FFF) | ((uv_x & 0x1FF) << 14) | ((uv_y & 0x1FF) << 23);
 
   u8 packed_anim = (ctx.anim_repeat << 7) | (u8)face->frame_count;
-  u8 tintindex = (u8)face->tintindex;
+  u8 tint_index = ctx.tint_palettes[face->render_layer]->GetIndex(tint);
   light |= (axis_data << 14);
 
-  vertex->packed_light = (packed_anim << 24) | (tintindex << 16) | light;
+  vertex->packed_light = (packed_anim << 24) | (tint_index << 16) | light;
 
-  size_t index = (vertex - (render::ChunkVertex*)ctx.vertex_arenas[face->render_layer]->base);
-  assert(index <= 65535);
-  return (u16)index;
+  return (u16)(vertex - (render::ChunkVertex*)arena->base);
 }
 
 inline void PushIndex(PushContext& ctx, u32 render_layer, u16 index) {
-  u16* out = (u16*)ctx.index_arenas[render_layer]->Allocate(sizeof(index), 1);
+  MemoryArena* arena = ctx.index_arenas[render_layer];
+
+  // Only the indices of collapsed quads can run past the end. They come in sixes, so whole faces are dropped.
+  if ((size_t)(arena->current - arena->base) + sizeof(index) > arena->max_size) return;
+
+  u16* out = (u16*)arena->Allocate(sizeof(index), 1);
   *out = index;
 }
 
@@ -347,6 +497,90 @@ inline u32 CalculateVertexLight(BorderedChunk* bordered_chunk, size_t* indices,
   return (block_sum << 6) | sky_sum;
 }
 
+struct FaceVertexData {
+  FaceQuad quad;
+
+  // Ambient occlusion and light packed for each corner.
+  u32 bl_light;
+  u32 br_light;
+  u32 tl_light;
+  u32 tr_light;
+
+  u32 axis_data;
+  u32 tint;
+};
+
+inline void PushQuad(PushContext& context, RenderableFace* face, const FaceVertexData& data) {
+  const FaceQuad& quad = data.quad;
+
+  u16 bli = PushVertex(context, quad.bl_pos, quad.bl_uv, face, data.bl_light, data.tint, data.axis_data);
+  u16 bri = PushVertex(context, quad.br_pos, quad.br_uv, face, data.br_light, data.tint, data.axis_data);
+  u16 tri = PushVertex(context, quad.tr_pos, quad.tr_uv, face, data.tr_light, data.tint, data.axis_data);
+  u16 tli = PushVertex(context, quad.tl_pos, quad.tl_uv, face, data.tl_light, data.tint, data.axis_data);
+
+  PushIndex(context, face->render_layer, bli);
+  PushIndex(context, face->render_layer, bri);
+  PushIndex(context, face->render_layer, tri);
+
+  PushIndex(context, face->render_layer, tri);
+  PushIndex(context, face->render_layer, tli);
+  PushIndex(context, face->render_layer, bli);
+}
+
+// Only plain full cube faces can be merged. They need to cover the entire texture once so the merged face can rely on
+// the sampler repeating it.
+inline bool IsGreedyMergeable(BlockModel* model, BlockElement* element, RenderableFace* face) {
+  if (model->element_count != 1 || model->has_variant_rotation) return false;
+  if (model->random_horizontal_offset || model->random_vertical_offset || model->random_vertical_uv) return false;
+  if (element->rescale || face->random_flip || face->quad) return false;
+  // The flora sampler clamps so it can't be tiled.
+  if (face->render_layer == (u32)RenderLayer::Flora) return false;
+
+  if (element->from.x != 0.0f || element->from.y != 0.0f || element->from.z != 0.0f) return false;
+  if (element->to.x != 1.0f || element->to.y != 1.0f || element->to.z != 1.0f) return false;
+
+  return face->uv_from.x == 0.0f && face->uv_from.y == 0.0f && face->uv_to.x == 1.0f && face->uv_to.y == 1.0f;
+}
+
+// The greedy mask is stored as slices along the face normal. The u and v axes match the uv axes of GetFaceQuad, so a
+// merged face can be created by scaling the element and its uvs.
+inline size_t GetGreedyIndex(BlockFace direction, size_t x, size_t y, size_t z) {
+  size_t slice = 0;
+  size_t u = 0;
+  size_t v = 0;
+
+  switch (direction) {
+  case BlockFace::Down:
+  case BlockFace::Up: {
+    slice = y;
+    u = x;
+    v = z;
+  } break;
+  case BlockFace::North:
+  case BlockFace::South: {
+    slice = z;
+    u = x;
+    v = y;
+  } break;
+  case BlockFace::West:
+  case BlockFace::East: {
+    slice = x;
+    u = z;
+    v = y;
+  } break;
+  }
+
+  return (size_t)direction * 16 * 16 * 16 + slice * 16 * 16 + v * 16 + u;
+}
+
+inline bool IsGreedyMatch(const GreedyFace& a, const GreedyFace& b) {
+  if (!a.face || !b.face) return false;
+
+  return a.face->texture_id == b.face->texture_id && a.face->tintindex == b.face->tintindex &&
+         a.face->frame_count == b.face->frame_count && a.face->render_layer == b.face->render_layer &&
+         a.light == b.light && a.axis_data == b.axis_data && a.tint == b.tint;
+}
+
 struct FaceMesh {
   Vector3f direction;
   bool reduced_ao = false;
@@ -463,20 +697,21 @@ struct FaceMesh {
     return Vector3f(x_offset, vertical ? y_offset : 0.0f, z_offset);
   }
 
-  void Mesh(BlockRegistry& registry, BorderedChunk* bordered_chunk, PushContext& context, BlockModel* model,
-            BlockElement* element, const Vector3f& chunk_base, const Vector3f& relative_base, BlockFace direction) {
+  // Calculates the final quad and the packed light of each corner without pushing anything.
+  void Compute(BlockRegistry& registry, BorderedChunk* bordered_chunk, BlockModel* model, BlockElement* element,
+               const Vector3f& chunk_base, const Vector3f& relative_base, BlockFace direction,
+               FaceVertexData* out) {
     RenderableFace* face = element->faces + (size_t)direction;
 
-    if (!face->render) return;
-
     FaceQuad quad = GetFaceQuad(*element, direction);
 
+    // The vertices are section relative, but the random offset needs to be based on the world position.
     Vector3f coord = chunk_base + relative_base;
 
-    quad.bl_pos += coord;
-    quad.br_pos += coord;
-    quad.tl_pos += coord;
-    quad.tr_pos += coord;
+    quad.bl_pos += relative_base;
+    quad.br_pos += relative_base;
+    quad.tl_pos += relative_base;
+    quad.tr_pos += relative_base;
 
     if (model->random_horizontal_offset || model->random_vertical_offset) {
       quad.bl_pos += GetRandomOffset(coord, model->random_vertical_offset);
@@ -546,18 +781,46 @@ struct FaceMesh {
       RandomizeVerticalFaceTexture(world_x, world_y, world_z, quad.bl_uv, quad.br_uv, quad.tr_uv, quad.tl_uv);
     }
 
-    u16 bli = PushVertex(context, quad.bl_pos, quad.bl_uv, face, ele_ao_bl, axis_data);
-    u16 bri = PushVertex(context, quad.br_pos, quad.br_uv, face, ele_ao_br, axis_data);
-    u16 tri = PushVertex(context, quad.tr_pos, quad.tr_uv, face, ele_ao_tr, axis_data);
-    u16 tli = PushVertex(context, quad.tl_pos, quad.tl_uv, face, ele_ao_tl, axis_data);
+    out->quad = quad;
+    out->bl_light = ele_ao_bl;
+    out->br_light = ele_ao_br;
+    out->tl_light = ele_ao_tl;
+    out->tr_light = ele_ao_tr;
+    out->axis_data = axis_data;
+  }
 
-    PushIndex(context, face->render_layer, bli);
-    PushIndex(context, face->render_layer, bri);
-    PushIndex(context, face->render_layer, tri);
+  // Meshes the face if it can't be merged, otherwise it's stored in the greedy mask to be merged after the chunk is
+  // done.
+  void MeshOrDefer(BlockMesher& mesher, BlockRegistry& registry, BorderedChunk* bordered_chunk, PushContext& context,
+                   BlockModel* model, BlockElement* element, const Vector3f& chunk_base,
+                   const Vector3f& relative_base, BlockFace direction) {
+    RenderableFace* face = element->faces + (size_t)direction;
 
-    PushIndex(context, face->render_layer, tri);
-    PushIndex(context, face->render_layer, tli);
-    PushIndex(context, face->render_layer, bli);
+    if (!face->render) return;
+
+    FaceVertexData data;
+    Compute(registry, bordered_chunk, model, element, chunk_base, relative_base, direction, &data);
+
+    data.tint = context.GetTint(face->tintindex);
+
+    // Faces can only be merged if the light is the same across the whole face, otherwise interpolation would change.
+    bool uniform = data.bl_light == data.br_light && data.bl_light == data.tl_light && data.bl_light == data.tr_light;
+
+    if (mesher.greedy_meshing && uniform && IsGreedyMergeable(model, element, face)) {
+      size_t x = (size_t)relative_base.x;
+      size_t y = (size_t)relative_base.y;
+      size_t z = (size_t)relative_base.z;
+
+      GreedyFace* greedy_face = mesher.greedy_faces + GetGreedyIndex(direction, x, y, z);
+
+      greedy_face->face = face;
+      greedy_face->light = data.bl_light;
+      greedy_face->axis_data = data.axis_data;
+      greedy_face->tint = data.tint;
+      return;
+    }
+
+    PushQuad(context, face, data);
   }
 };
 
@@ -607,7 +870,8 @@ static void MeshBlock(BlockMesher& mesher, PushContext& context, BlockRegistry&
         face_mesh.reduced_ao = true;
       }
 
-      face_mesh.Mesh(block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos, BlockFace::Up);
+      face_mesh.MeshOrDefer(mesher, block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
+                            BlockFace::Up);
     }
   }
 
@@ -618,8 +882,8 @@ static void MeshBlock(BlockMesher& mesher, PushContext& context, BlockRegistry&
           Vector3f(0, -1, 0),
       };
 
-      face_mesh.Mesh(block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
-                     BlockFace::Down);
+      face_mesh.MeshOrDefer(mesher, block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
+                            BlockFace::Down);
     }
   }
 
@@ -630,8 +894,8 @@ static void MeshBlock(BlockMesher& mesher, PushContext& context, BlockRegistry&
           Vector3f(0, 0, -1),
       };
 
-      face_mesh.Mesh(block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
-                     BlockFace::North);
+      face_mesh.MeshOrDefer(mesher, block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
+                            BlockFace::North);
     }
   }
 
@@ -642,8 +906,8 @@ static void MeshBlock(BlockMesher& mesher, PushContext& context, BlockRegistry&
           Vector3f(0, 0, 1),
       };
 
-      face_mesh.Mesh(block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
-                     BlockFace::South);
+      face_mesh.MeshOrDefer(mesher, block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
+                            BlockFace::South);
     }
   }
 
@@ -654,8 +918,8 @@ static void MeshBlock(BlockMesher& mesher, PushContext& context, BlockRegistry&
           Vector3f(-1, 0, 0),
       };
 
-      face_mesh.Mesh(block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
-                     BlockFace::West);
+      face_mesh.MeshOrDefer(mesher, block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
+                            BlockFace::West);
     }
   }
 
@@ -666,8 +930,8 @@ static void MeshBlock(BlockMesher& mesher, PushContext& context, BlockRegistry&
           Vector3f(1, 0, 0),
       };
 
-      face_mesh.Mesh(block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
-                     BlockFace::East);
+      face_mesh.MeshOrDefer(mesher, block_registry, bordered_chunk, context, model, element, chunk_base, relative_pos,
+                            BlockFace::East);
     }
   }
 }
@@ -680,7 +944,6 @@ static void MeshFluid(BlockMesher& mesher, PushContext& context, BlockRegistry&
   float x = (float)relative_x;
   float y = (float)relative_y;
   float z = (float)relative_z;
-  Vector3f position = chunk_base + Vector3f(x, y, z);
 
   size_t above_index = (relative_y + 2) * 18 * 18 + (relative_z + 1) * 18 + (relative_x + 1);
   size_t below_index = (relative_y + 0) * 18 * 18 + (relative_z + 1) * 18 + (relative_x + 1);
@@ -741,6 +1004,7 @@ static void MeshFluid(BlockMesher& mesher, PushContext& context, BlockRegistry&
   face_.tintindex = tintindex;
   face_.render_layer = (int)layer;
   RenderableFace* face = &face_;
+  u32 tint = context.GetTint(tintindex);
 
   bool fluid_below = GetMaterialDescription(mesher.mapping, below_id).fluid;
 
@@ -777,10 +1041,10 @@ static void MeshFluid(BlockMesher& mesher, PushContext& context, BlockRegistry&
     u32 ele_ao_tl = (l_tl << 2) | 3;
     u32 ele_ao_tr = (l_tr << 2) | 3;
 
-    u16 bli = PushVertex(context, bottom_left + chunk_base, bl_uv, face, ele_ao_bl);
-    u16 bri = PushVertex(context, bottom_right + chunk_base, br_uv, face, ele_ao_br);
-    u16 tri = PushVertex(context, top_right + chunk_base, tr_uv, face, ele_ao_tr);
-    u16 tli = PushVertex(context, top_left + chunk_base, tl_uv, face, ele_ao_tl);
+    u16 bli = PushVertex(context, bottom_left, bl_uv, face, ele_ao_bl, tint);
+    u16 bri = PushVertex(context, bottom_right, br_uv, face, ele_ao_br, tint);
+    u16 tri = PushVertex(context, top_right, tr_uv, face, ele_ao_tr, tint);
+    u16 tli = PushVertex(context, top_left, tl_uv, face, ele_ao_tl, tint);
 
     PushIndex(context, face->render_layer, bli);
     PushIndex(context, face->render_layer, bri);
@@ -825,10 +1089,10 @@ static void MeshFluid(BlockMesher& mesher, PushContext& context, BlockRegistry&
     u32 ele_ao_tl = (l_tl << 2) | 3;
     u32 ele_ao_tr = (l_tr << 2) | 3;
 
-    u16 bli = PushVertex(context, bottom_left + chunk_base, bl_uv, face, ele_ao_bl);
-    u16 bri = PushVertex(context, bottom_right + chunk_base, br_uv, face, ele_ao_br);
-    u16 tri = PushVertex(context, top_right + chunk_base, tr_uv, face, ele_ao_tr);
-    u16 tli = PushVertex(context, top_left + chunk_base, tl_uv, face, ele_ao_tl);
+    u16 bli = PushVertex(context, bottom_left, bl_uv, face, ele_ao_bl, tint);
+    u16 bri = PushVertex(context, bottom_right, br_uv, face, ele_ao_br, tint);
+    u16 tri = PushVertex(context, top_right, tr_uv, face, ele_ao_tr, tint);
+    u16 tli = PushVertex(context, top_left, tl_uv, face, ele_ao_tl, tint);
 
     PushIndex(context, face->render_layer, bli);
     PushIndex(context, face->render_layer, bri);
@@ -879,10 +1143,10 @@ static void MeshFluid(BlockMesher& mesher, PushContext& context, BlockRegistry&
     u32 ele_ao_tl = (l_tl << 2) | 3;
     u32 ele_ao_tr = (l_tr << 2) | 3;
 
-    u16 bli = PushVertex(context, bottom_left + chunk_base, bl_uv, face, ele_ao_bl);
-    u16 bri = PushVertex(context, bottom_right + chunk_base, br_uv, face, ele_ao_br);
-    u16 tri = PushVertex(context, top_right + chunk_base, tr_uv, face, ele_ao_tr);
-    u16 tli = PushVertex(context, top_left + chunk_base, tl_uv, face, ele_ao_tl);
+    u16 bli = PushVertex(context, bottom_left, bl_uv, face, ele_ao_bl, tint);
+    u16 bri = PushVertex(context, bottom_right, br_uv, face, ele_ao_br, tint);
+    u16 tri = PushVertex(context, top_right, tr_uv, face, ele_ao_tr, tint);
+    u16 tli = PushVertex(context, top_left, tl_uv, face, ele_ao_tl, tint);
 
     PushIndex(context, face->render_layer, bli);
     PushIndex(context, face->render_layer, bri);
@@ -927,10 +1191,10 @@ static void MeshFluid(BlockMesher& mesher, PushContext& context, BlockRegistry&
     u32 ele_ao_tl = (l_tl << 2) | 3;
     u32 ele_ao_tr = (l_tr << 2) | 3;
 
-    u16 bli = PushVertex(context, bottom_left + chunk_base, bl_uv, face, ele_ao_bl);
-    u16 bri = PushVertex(context, bottom_right + chunk_base, br_uv, face, ele_ao_br);
-    u16 tri = PushVertex(context, top_right + chunk_base, tr_uv, face, ele_ao_tr);
-    u16 tli = PushVertex(context, top_left + chunk_base, tl_uv, face, ele_ao_tl);
+    u16 bli = PushVertex(context, bottom_left, bl_uv, face, ele_ao_bl, tint);
+    u16 bri = PushVertex(context, bottom_right, br_uv, face, ele_ao_br, tint);
+    u16 tri = PushVertex(context, top_right, tr_uv, face, ele_ao_tr, tint);
+    u16 tli = PushVertex(context, top_left, tl_uv, face, ele_ao_tl, tint);
 
     PushIndex(context, face->render_layer, bli);
     PushIndex(context, face->render_layer, bri);
@@ -975,10 +1239,10 @@ static void MeshFluid(BlockMesher& mesher, PushContext& context, BlockRegistry&
     u32 ele_ao_tl = (l_tl << 2) | 3;
     u32 ele_ao_tr = (l_tr << 2) | 3;
 
-    u16 bli = PushVertex(context, bottom_left + chunk_base, bl_uv, face, ele_ao_bl);
-    u16 bri = PushVertex(context, bottom_right + chunk_base, br_uv, face, ele_ao_br);
-    u16 tri = PushVertex(context, top_right + chunk_base, tr_uv, face, ele_ao_tr);
-    u16 tli = PushVertex(context, top_left + chunk_base, tl_uv, face, ele_ao_tl);
+    u16 bli = PushVertex(context, bottom_left, bl_uv, face, ele_ao_bl, tint);
+    u16 bri = PushVertex(context, bottom_right, br_uv, face, ele_ao_br, tint);
+    u16 tri = PushVertex(context, top_right, tr_uv, face, ele_ao_tr, tint);
+    u16 tli = PushVertex(context, top_left, tl_uv, face, ele_ao_tl, tint);
 
     PushIndex(context, face->render_layer, bli);
     PushIndex(context, face->render_layer, bri);
@@ -1023,10 +1287,10 @@ static void MeshFluid(BlockMesher& mesher, PushContext& context, BlockRegistry&
     u32 ele_ao_tl = (l_tl << 2) | 3;
     u32 ele_ao_tr = (l_tr << 2) | 3;
 
-    u16 bli = PushVertex(context, bottom_left + chunk_base, bl_uv, face, ele_ao_bl);
-    u16 bri = PushVertex(context, bottom_right + chunk_base, br_uv, face, ele_ao_br);
-    u16 tri = PushVertex(context, top_right + chunk_base, tr_uv, face, ele_ao_tr);
-    u16 tli = PushVertex(context, top_left + chunk_base, tl_uv, face, ele_ao_tl);
+    u16 bli = PushVertex(context, bottom_left, bl_uv, face, ele_ao_bl, tint);
+    u16 bri = PushVertex(context, bottom_right, br_uv, face, ele_ao_br, tint);
+    u16 tri = PushVertex(context, top_right, tr_uv, face, ele_ao_tr, tint);
+    u16 tli = PushVertex(context, top_left, tl_uv, face, ele_ao_tl, tint);
 
     PushIndex(context, face->render_layer, bli);
     PushIndex(context, face->render_layer, bri);
@@ -1046,14 +1310,116 @@ static void MeshFluid(BlockMesher& mesher, PushContext& context, BlockRegistry&
   }
 }
 
+static void PushGreedyQuad(PushContext& context, BlockFace direction, size_t slice, size_t u, size_t v, size_t width,
+                           size_t height, const GreedyFace& greedy_face) {
+  Vector3f relative_base;
+  Vector3f extent;
+
+  switch (direction) {
+  case BlockFace::Down:
+  case BlockFace::Up: {
+    relative_base = Vector3f((float)u, (float)slice, (float)v);
+    extent = Vector3f((float)width, 1.0f, (float)height);
+  } break;
+  case BlockFace::North:
+  case BlockFace::South: {
+    relative_base = Vector3f((float)u, (float)v, (float)slice);
+    extent = Vector3f((float)width, (float)height, 1.0f);
+  } break;
+  case BlockFace::West:
+  case BlockFace::East: {
+    relative_base = Vector3f((float)slice, (float)v, (float)u);
+    extent = Vector3f(1.0f, (float)height, (float)width);
+  } break;
+  }
+
+  // Scale a full cube element to the size of the merged face so GetFaceQuad gives the correct winding and uvs.
+  BlockElement element = {};
+
+  element.from = Vector3f(0, 0, 0);
+  element.to = extent;
+
+  RenderableFace* face = element.faces + (size_t)direction;
+
+  *face = *greedy_face.face;
+  face->uv_from = Vector2f(0, 0);
+  face->uv_to = Vector2f((float)width, (float)height);
+  face->quad = nullptr;
+
+  FaceVertexData data;
+
+  data.quad = GetFaceQuad(element, direction);
+
+  data.quad.bl_pos += relative_base;
+  data.quad.br_pos += relative_base;
+  data.quad.tl_pos += relative_base;
+  data.quad.tr_pos += relative_base;
+
+  data.bl_light = data.br_light = data.tl_light = data.tr_light = greedy_face.light;
+  data.axis_data = greedy_face.axis_data;
+  data.tint = greedy_face.tint;
+
+  PushQuad(context, face, data);
+}
+
+// Merges the deferred faces of each slice into the largest rectangles that share the same texture and light.
+// The mask is cleared as it's consumed so it's ready for the next chunk.
+static void MeshGreedyFaces(BlockMesher& mesher, PushContext& context) {
+  for (size_t direction = 0; direction < 6; ++direction) {
+    for (size_t slice = 0; slice < 16; ++slice) {
+      GreedyFace* mask = mesher.greedy_faces + direction * 16 * 16 * 16 + slice * 16 * 16;
+
+      for (size_t v = 0; v < 16; ++v) {
+        for (size_t u = 0; u < 16;) {
+          GreedyFace current = mask[v * 16 + u];
+
+          if (!current.face) {
+            ++u;
+            continue;
+          }
+
+          size_t width = 1;
+
+          while (u + width < 16 && IsGreedyMatch(current, mask[v * 16 + u + width])) {
+            ++width;
+          }
+
+          size_t height = 1;
+
+          while (v + height < 16) {
+            bool row_match = true;
+
+            for (size_t i = 0; i < width; ++i) {
+              if (!IsGreedyMatch(current, mask[(v + height) * 16 + u + i])) {
+                row_match = false;
+                break;
+              }
+            }
+
+            if (!row_match) break;
+
+            ++height;
+          }
+
+          for (size_t dv = 0; dv < height; ++dv) {
+            for (size_t du = 0; du < width; ++du) {
+              mask[(v + dv) * 16 + u + du].face = nullptr;
+            }
+          }
+
+          PushGreedyQuad(context, (BlockFace)direction, slice, u, v, width, height, current);
+
+          u += width;
+        }
+      }
+    }
+  }
+}
+
 ChunkVertexData BlockMesher::CreateMesh(asset::AssetSystem& assets, BlockRegistry& block_registry,
-                                        ChunkBuildContext* ctx, s32 chunk_y) {
+                                        BorderedChunk* bordered_chunk, s32 chunk_x, s32 chunk_y, s32 chunk_z) {
   ChunkVertexData vertex_data;
 
-  s32 chunk_x = ctx->chunk_x;
-  s32 chunk_z = ctx->chunk_z;
-
-  BorderedChunk* bordered_chunk = CreateBorderedChunk(trans_arena, ctx, chunk_y);
   if (!bordered_chunk) return vertex_data;
 
   water_texture = assets.GetTextureRange(POLY_STR("assets/minecraft/textures/block/water_still.png"));
@@ -1063,10 +1429,11 @@ ChunkVertexData BlockMesher::CreateMesh(asset::AssetSystem& assets, BlockRegistr
   Vector3f chunk_base(chunk_x * 16.0f, chunk_y * 16.0f - 64.0f, chunk_z * 16.0f);
 
   PushContext context(false);
+  context.bordered_chunk = bordered_chunk;
 
   for (size_t i = 0; i < kRenderLayerCount; ++i) {
     RenderLayer layer = (RenderLayer)i;
-    context.SetLayerData(layer, &vertex_arenas[i], &index_arenas[i]);
+    context.SetLayerData(layer, &vertex_arenas[i], &index_arenas[i], &tint_palettes[i]);
   }
 
   for (size_t relative_y = 0; relative_y < 16; ++relative_y) {
@@ -1076,6 +1443,8 @@ ChunkVertexData BlockMesher::CreateMesh(asset::AssetSystem& assets, BlockRegistr
 
         u32 bid = bordered_chunk->blocks[index];
 
+        context.SetTintBlock(relative_x, relative_y, relative_z);
+
         MaterialDescription desc = GetMaterialDescription(mapping, bid);
 
         if (desc.fluid) {
@@ -1101,6 +1470,10 @@ ChunkVertexData BlockMesher::CreateMesh(asset::AssetSystem& assets, BlockRegistr
     }
   }
 
+  if (greedy_meshing) {
+    MeshGreedyFaces(*this, context);
+  }
+
   for (size_t i = 0; i < kRenderLayerCount; ++i) {
     MemoryArena& vertex_arena = vertex_arenas[i];
     MemoryArena& index_arena = index_arenas[i];
@@ -1111,14 +1484,58 @@ ChunkVertexData BlockMesher::CreateMesh(asset::AssetSystem& assets, BlockRegistr
 
     vertex_data.SetVertices(layer, vertex_arenas[i].base, vertex_count);
     vertex_data.SetIndices(layer, (u16*)index_arenas[i].base, index_count);
+    vertex_data.SetTints(layer, tint_palettes[i].colors, tint_palettes[i].count);
   }
 
   return vertex_data;
 }
 
+// Returns true if a block of this state hides every face of another block of the same state.
+static bool IsUniformOccluder(BlockRegistry& block_registry, u32 bid) {
+  BlockModel* model = &block_registry.states[bid].model;
+
+  if (model->element_count == 0) return false;
+
+  for (size_t i = 0; i < 6; ++i) {
+    if (!IsOccluding(model, model, (BlockFace)i)) return false;
+  }
+
+  return true;
+}
+
+bool IsSectionHidden(BlockRegistry& block_registry, ChunkBuildContext* ctx, s32 chunk_y) {
+  const world::Chunk& chunk = ctx->section->chunks[chunk_y];
+
+  if (chunk.IsEmpty()) return true;
+  if (!chunk.IsUniform()) return false;
+
+  // The top and bottom sections always have an exposed face to the outside of the world.
+  if (chunk_y <= 0 || chunk_y >= (s32)kChunkColumnCount - 1) return false;
+
+  u32 bid = chunk.single_value;
+
+  const world::Chunk* neighbors[] = {
+      &ctx->section->chunks[chunk_y - 1],   &ctx->section->chunks[chunk_y + 1], &ctx->north_section->chunks[chunk_y],
+      &ctx->south_section->chunks[chunk_y], &ctx->west_section->chunks[chunk_y], &ctx->east_section->chunks[chunk_y],
+  };
+
+  // A solid section is only hidden if it's surrounded by more of itself, so none of its faces can be seen.
+  for (size_t i = 0; i < polymer_array_count(neighbors); ++i) {
+    if (!neighbors[i]->IsUniform() || neighbors[i]->single_value != bid) return false;
+  }
+
+  return IsUniformOccluder(block_registry, bid);
+}
+
 BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s32 chunk_y) {
   BorderedChunk* bordered_chunk = memory_arena_push_type(&arena, BorderedChunk);
 
+  FillBorderedChunk(bordered_chunk, ctx, chunk_y);
+
+  return bordered_chunk;
+}
+
+void FillBorderedChunk(BorderedChunk* bordered_chunk, ChunkBuildContext* ctx, s32 chunk_y) {
   memset(bordered_chunk, 0, sizeof(BorderedChunk));
 
   ChunkSection* section = ctx->section;
@@ -1131,15 +1548,12 @@ BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s
   ChunkSection* south_east_section = ctx->south_east_section;
   ChunkSection* south_west_section = ctx->south_west_section;
 
-  for (s64 y = 0; y < 16; ++y) {
-    for (s64 z = 0; z < 16; ++z) {
-      for (s64 x = 0; x < 16; ++x) {
-        size_t index = (size_t)((y + 1) * 18 * 18 + (z + 1) * 18 + (x + 1));
+  {
+    // Decode the center of the chunk in bulk since it's most of the work.
+    size_t index = (size_t)(1 * 18 * 18 + 1 * 18 + 1);
 
-        bordered_chunk->blocks[index] = section->chunks[chunk_y].blocks[y][z][x];
-        bordered_chunk->lightmap[index] = section->chunks[chunk_y].lightmap[y][z][x];
-      }
-    }
+    section->chunks[chunk_y].DecodeBlocks(bordered_chunk->blocks + index, 18, 18 * 18);
+    section->chunks[chunk_y].DecodeLight(bordered_chunk->lightmap + index, 18, 18 * 18);
   }
 
   // Load west blocks
@@ -1147,8 +1561,8 @@ BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s
     for (s64 z = 0; z < 16; ++z) {
       size_t index = (size_t)((y + 1) * 18 * 18 + (z + 1) * 18 + 0);
 
-      bordered_chunk->blocks[index] = west_section->chunks[chunk_y].blocks[y][z][15];
-      bordered_chunk->lightmap[index] = west_section->chunks[chunk_y].lightmap[y][z][15];
+      bordered_chunk->blocks[index] = west_section->chunks[chunk_y].GetBlock(15, y, z);
+      bordered_chunk->lightmap[index] = west_section->chunks[chunk_y].GetLight(15, y, z);
     }
   }
 
@@ -1157,8 +1571,8 @@ BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s
     for (s64 z = 0; z < 16; ++z) {
       size_t index = (size_t)((y + 1) * 18 * 18 + (z + 1) * 18 + 17);
 
-      bordered_chunk->blocks[index] = east_section->chunks[chunk_y].blocks[y][z][0];
-      bordered_chunk->lightmap[index] = east_section->chunks[chunk_y].lightmap[y][z][0];
+      bordered_chunk->blocks[index] = east_section->chunks[chunk_y].GetBlock(0, y, z);
+      bordered_chunk->lightmap[index] = east_section->chunks[chunk_y].GetLight(0, y, z);
     }
   }
 
@@ -1167,8 +1581,8 @@ BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s
     for (s64 x = 0; x < 16; ++x) {
       size_t index = (size_t)((y + 1) * 18 * 18 + (x + 1));
 
-      bordered_chunk->blocks[index] = north_section->chunks[chunk_y].blocks[y][15][x];
-      bordered_chunk->lightmap[index] = north_section->chunks[chunk_y].lightmap[y][15][x];
+      bordered_chunk->blocks[index] = north_section->chunks[chunk_y].GetBlock(x, y, 15);
+      bordered_chunk->lightmap[index] = north_section->chunks[chunk_y].GetLight(x, y, 15);
     }
   }
 
@@ -1177,8 +1591,8 @@ BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s
     for (s64 x = 0; x < 16; ++x) {
       size_t index = (size_t)((y + 1) * 18 * 18 + 17 * 18 + (x + 1));
 
-      bordered_chunk->blocks[index] = south_section->chunks[chunk_y].blocks[y][0][x];
-      bordered_chunk->lightmap[index] = south_section->chunks[chunk_y].lightmap[y][0][x];
+      bordered_chunk->blocks[index] = south_section->chunks[chunk_y].GetBlock(x, y, 0);
+      bordered_chunk->lightmap[index] = south_section->chunks[chunk_y].GetLight(x, y, 0);
     }
   }
 
@@ -1186,42 +1600,42 @@ BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s
   for (size_t y = 0; y < 16; ++y) {
     size_t index = (size_t)((y + 1) * 18 * 18 + 17 * 18 + 17);
 
-    bordered_chunk->blocks[index] = south_east_section->chunks[chunk_y].blocks[y][0][0];
-    bordered_chunk->lightmap[index] = south_east_section->chunks[chunk_y].lightmap[y][0][0];
+    bordered_chunk->blocks[index] = south_east_section->chunks[chunk_y].GetBlock(0, y, 0);
+    bordered_chunk->lightmap[index] = south_east_section->chunks[chunk_y].GetLight(0, y, 0);
   }
 
   // North-east corner
   for (size_t y = 0; y < 16; ++y) {
     size_t index = (size_t)((y + 1) * 18 * 18 + 0 * 18 + 17);
 
-    bordered_chunk->blocks[index] = north_east_section->chunks[chunk_y].blocks[y][15][0];
-    bordered_chunk->lightmap[index] = north_east_section->chunks[chunk_y].lightmap[y][15][0];
+    bordered_chunk->blocks[index] = north_east_section->chunks[chunk_y].GetBlock(0, y, 15);
+    bordered_chunk->lightmap[index] = north_east_section->chunks[chunk_y].GetLight(0, y, 15);
   }
 
   // South-west corner
   for (size_t y = 0; y < 16; ++y) {
     size_t index = (size_t)((y + 1) * 18 * 18 + 17 * 18 + 0);
 
-    bordered_chunk->blocks[index] = south_west_section->chunks[chunk_y].blocks[y][0][15];
-    bordered_chunk->lightmap[index] = south_west_section->chunks[chunk_y].lightmap[y][0][15];
+    bordered_chunk->blocks[index] = south_west_section->chunks[chunk_y].GetBlock(15, y, 0);
+    bordered_chunk->lightmap[index] = south_west_section->chunks[chunk_y].GetLight(15, y, 0);
   }
 
   // North-west corner
   for (size_t y = 0; y < 16; ++y) {
     size_t index = (size_t)((y + 1) * 18 * 18 + 0 * 18 + 0);
 
-    bordered_chunk->blocks[index] = north_west_section->chunks[chunk_y].blocks[y][15][15];
-    bordered_chunk->lightmap[index] = north_west_section->chunks[chunk_y].lightmap[y][15][15];
+    bordered_chunk->blocks[index] = north_west_section->chunks[chunk_y].GetBlock(15, y, 15);
+    bordered_chunk->lightmap[index] = north_west_section->chunks[chunk_y].GetLight(15, y, 15);
   }
 
-  if (chunk_y < kChunkColumnCount) {
+  if (chunk_y < kChunkColumnCount - 1) {
     // Load above blocks
     for (s64 z = 0; z < 16; ++z) {
       for (s64 x = 0; x < 16; ++x) {
         size_t index = (size_t)(17 * 18 * 18 + (z + 1) * 18 + (x + 1));
 
-        bordered_chunk->blocks[index] = section->chunks[chunk_y + 1].blocks[0][z][x];
-        bordered_chunk->lightmap[index] = section->chunks[chunk_y + 1].lightmap[0][z][x];
+        bordered_chunk->blocks[index] = section->chunks[chunk_y + 1].GetBlock(x, 0, z);
+        bordered_chunk->lightmap[index] = section->chunks[chunk_y + 1].GetLight(x, 0, z);
       }
     }
 
@@ -1229,64 +1643,64 @@ BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s
     for (s64 x = 0; x < 16; ++x) {
       size_t index = (size_t)(17 * 18 * 18 + 17 * 18 + (x + 1));
 
-      bordered_chunk->blocks[index] = south_section->chunks[chunk_y + 1].blocks[0][0][x];
-      bordered_chunk->lightmap[index] = south_section->chunks[chunk_y + 1].lightmap[0][0][x];
+      bordered_chunk->blocks[index] = south_section->chunks[chunk_y + 1].GetBlock(x, 0, 0);
+      bordered_chunk->lightmap[index] = south_section->chunks[chunk_y + 1].GetLight(x, 0, 0);
     }
 
     // Load above-north
     for (s64 x = 0; x < 16; ++x) {
       size_t index = (size_t)(17 * 18 * 18 + 0 * 18 + (x + 1));
 
-      bordered_chunk->blocks[index] = north_section->chunks[chunk_y + 1].blocks[0][15][x];
-      bordered_chunk->lightmap[index] = north_section->chunks[chunk_y + 1].lightmap[0][15][x];
+      bordered_chunk->blocks[index] = north_section->chunks[chunk_y + 1].GetBlock(x, 0, 15);
+      bordered_chunk->lightmap[index] = north_section->chunks[chunk_y + 1].GetLight(x, 0, 15);
     }
 
     // Load above-east
     for (s64 z = 0; z < 16; ++z) {
       size_t index = (size_t)(17 * 18 * 18 + (z + 1) * 18 + 17);
 
-      bordered_chunk->blocks[index] = east_section->chunks[chunk_y + 1].blocks[0][z][0];
-      bordered_chunk->lightmap[index] = east_section->chunks[chunk_y + 1].lightmap[0][z][0];
+      bordered_chunk->blocks[index] = east_section->chunks[chunk_y + 1].GetBlock(0, 0, z);
+      bordered_chunk->lightmap[index] = east_section->chunks[chunk_y + 1].GetLight(0, 0, z);
     }
 
     // Load above-west
     for (s64 z = 0; z < 16; ++z) {
       size_t index = (size_t)(17 * 18 * 18 + (z + 1) * 18 + 0);
 
-      bordered_chunk->blocks[index] = west_section->chunks[chunk_y + 1].blocks[0][z][15];
-      bordered_chunk->lightmap[index] = west_section->chunks[chunk_y + 1].lightmap[0][z][15];
+      bordered_chunk->blocks[index] = west_section->chunks[chunk_y + 1].GetBlock(15, 0, z);
+      bordered_chunk->lightmap[index] = west_section->chunks[chunk_y + 1].GetLight(15, 0, z);
     }
 
     {
       // Load above-south-east
       size_t index = (size_t)(17 * 18 * 18 + 17 * 18 + 17);
 
-      bordered_chunk->blocks[index] = south_east_section->chunks[chunk_y + 1].blocks[0][0][0];
-      bordered_chunk->lightmap[index] = south_east_section->chunks[chunk_y + 1].lightmap[0][0][0];
+      bordered_chunk->blocks[index] = south_east_section->chunks[chunk_y + 1].GetBlock(0, 0, 0);
+      bordered_chunk->lightmap[index] = south_east_section->chunks[chunk_y + 1].GetLight(0, 0, 0);
     }
 
     {
       size_t index = (size_t)(17 * 18 * 18 + 17 * 18 + 0);
 
       // Load above-south-west
-      bordered_chunk->blocks[index] = south_west_section->chunks[chunk_y + 1].blocks[0][0][15];
-      bordered_chunk->lightmap[index] = south_west_section->chunks[chunk_y + 1].lightmap[0][0][15];
+      bordered_chunk->blocks[index] = south_west_section->chunks[chunk_y + 1].GetBlock(15, 0, 0);
+      bordered_chunk->lightmap[index] = south_west_section->chunks[chunk_y + 1].GetLight(15, 0, 0);
     }
 
     {
       size_t index = (size_t)(17 * 18 * 18 + 0 * 18 + 17);
 
       // Load above-north-east
-      bordered_chunk->blocks[index] = north_east_section->chunks[chunk_y + 1].blocks[0][15][0];
-      bordered_chunk->lightmap[index] = north_east_section->chunks[chunk_y + 1].lightmap[0][15][0];
+      bordered_chunk->blocks[index] = north_east_section->chunks[chunk_y + 1].GetBlock(0, 0, 15);
+      bordered_chunk->lightmap[index] = north_east_section->chunks[chunk_y + 1].GetLight(0, 0, 15);
     }
 
     {
       size_t index = (size_t)(17 * 18 * 18 + 0 * 18 + 0);
 
       // Load above-north-west
-      bordered_chunk->blocks[index] = north_west_section->chunks[chunk_y + 1].blocks[0][15][15];
-      bordered_chunk->lightmap[index] = north_west_section->chunks[chunk_y + 1].lightmap[0][15][15];
+      bordered_chunk->blocks[index] = north_west_section->chunks[chunk_y + 1].GetBlock(15, 0, 15);
+      bordered_chunk->lightmap[index] = north_west_section->chunks[chunk_y + 1].GetLight(15, 0, 15);
     }
   }
 
@@ -1296,8 +1710,8 @@ BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s
       for (s64 x = 0; x < 16; ++x) {
         size_t index = (size_t)((z + 1) * 18 + (x + 1));
 
-        bordered_chunk->blocks[index] = section->chunks[chunk_y - 1].blocks[15][z][x];
-        bordered_chunk->lightmap[index] = section->chunks[chunk_y - 1].lightmap[15][z][x];
+        bordered_chunk->blocks[index] = section->chunks[chunk_y - 1].GetBlock(x, 15, z);
+        bordered_chunk->lightmap[index] = section->chunks[chunk_y - 1].GetLight(x, 15, z);
       }
     }
 
@@ -1305,68 +1719,99 @@ BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s
     for (s64 x = 0; x < 16; ++x) {
       size_t index = (size_t)(0 * 18 * 18 + 17 * 18 + (x + 1));
 
-      bordered_chunk->blocks[index] = south_section->chunks[chunk_y - 1].blocks[15][0][x];
-      bordered_chunk->lightmap[index] = south_section->chunks[chunk_y - 1].lightmap[15][0][x];
+      bordered_chunk->blocks[index] = south_section->chunks[chunk_y - 1].GetBlock(x, 15, 0);
+      bordered_chunk->lightmap[index] = south_section->chunks[chunk_y - 1].GetLight(x, 15, 0);
     }
 
     // Load below-north
     for (s64 x = 0; x < 16; ++x) {
       size_t index = (size_t)(0 * 18 * 18 + 0 * 18 + (x + 1));
 
-      bordered_chunk->blocks[index] = north_section->chunks[chunk_y - 1].blocks[15][15][x];
-      bordered_chunk->lightmap[index] = north_section->chunks[chunk_y - 1].lightmap[15][15][x];
+      bordered_chunk->blocks[index] = north_section->chunks[chunk_y - 1].GetBlock(x, 15, 15);
+      bordered_chunk->lightmap[index] = north_section->chunks[chunk_y - 1].GetLight(x, 15, 15);
     }
 
     // Load below-east
     for (s64 z = 0; z < 16; ++z) {
       size_t index = (size_t)(0 * 18 * 18 + (z + 1) * 18 + 17);
 
-      bordered_chunk->blocks[index] = east_section->chunks[chunk_y - 1].blocks[15][z][0];
-      bordered_chunk->lightmap[index] = east_section->chunks[chunk_y - 1].lightmap[15][z][0];
+      bordered_chunk->blocks[index] = east_section->chunks[chunk_y - 1].GetBlock(0, 15, z);
+      bordered_chunk->lightmap[index] = east_section->chunks[chunk_y - 1].GetLight(0, 15, z);
     }
 
     // Load below-west
     for (s64 z = 0; z < 16; ++z) {
       size_t index = (size_t)(0 * 18 * 18 + (z + 1) * 18 + 0);
 
-      bordered_chunk->blocks[index] = west_section->chunks[chunk_y - 1].blocks[15][z][15];
-      bordered_chunk->lightmap[index] = west_section->chunks[chunk_y - 1].lightmap[15][z][15];
+      bordered_chunk->blocks[index] = west_section->chunks[chunk_y - 1].GetBlock(15, 15, z);
+      bordered_chunk->lightmap[index] = west_section->chunks[chunk_y - 1].GetLight(15, 15, z);
     }
 
     {
       size_t index = (size_t)(0 * 18 * 18 + 17 * 18 + 17);
 
       // Load below-south-east
-      bordered_chunk->blocks[index] = south_east_section->chunks[chunk_y - 1].blocks[15][0][0];
-      bordered_chunk->lightmap[index] = south_east_section->chunks[chunk_y - 1].lightmap[15][0][0];
+      bordered_chunk->blocks[index] = south_east_section->chunks[chunk_y - 1].GetBlock(0, 15, 0);
+      bordered_chunk->lightmap[index] = south_east_section->chunks[chunk_y - 1].GetLight(0, 15, 0);
     }
 
     {
       size_t index = (size_t)(0 * 18 * 18 + 17 * 18 + 0);
 
       // Load below-south-west
-      bordered_chunk->blocks[index] = south_west_section->chunks[chunk_y - 1].blocks[15][0][15];
-      bordered_chunk->lightmap[index] = south_west_section->chunks[chunk_y - 1].lightmap[15][0][15];
+      bordered_chunk->blocks[index] = south_west_section->chunks[chunk_y - 1].GetBlock(15, 15, 0);
+      bordered_chunk->lightmap[index] = south_west_section->chunks[chunk_y - 1].GetLight(15, 15, 0);
     }
 
     {
       size_t index = (size_t)(0 * 18 * 18 + 0 * 18 + 17);
 
       // Load below-north-east
-      bordered_chunk->blocks[index] = north_east_section->chunks[chunk_y - 1].blocks[15][15][0];
-      bordered_chunk->lightmap[index] = north_east_section->chunks[chunk_y - 1].lightmap[15][15][0];
+      bordered_chunk->blocks[index] = north_east_section->chunks[chunk_y - 1].GetBlock(0, 15, 15);
+      bordered_chunk->lightmap[index] = north_east_section->chunks[chunk_y - 1].GetLight(0, 15, 15);
     }
 
     {
       size_t index = (size_t)(0 * 18 * 18 + 0 * 18 + 0);
 
       // Load below-north-west
-      bordered_chunk->blocks[index] = north_west_section->chunks[chunk_y - 1].blocks[15][15][15];
-      bordered_chunk->lightmap[index] = north_west_section->chunks[chunk_y - 1].lightmap[15][15][15];
+      bordered_chunk->blocks[index] = north_west_section->chunks[chunk_y - 1].GetBlock(15, 15, 15);
+      bordered_chunk->lightmap[index] = north_west_section->chunks[chunk_y - 1].GetLight(15, 15, 15);
     }
   }
 
-  return bordered_chunk;
+
+  // Resolve the colors of every biome cell, taking the border cells from the neighboring sections.
+  ChunkSection* cell_sections[3][3] = {
+      {north_west_section, north_section, north_east_section},
+      {west_section, section, east_section},
+      {south_west_section, south_section, south_east_section},
+  };
+
+  const world::BiomeCodec* biome_codec = ctx->biome_codec;
+
+  for (s32 cell_y = 0; cell_y < 4; ++cell_y) {
+    for (s32 cell_z = -1; cell_z <= 4; ++cell_z) {
+      for (s32 cell_x = -1; cell_x <= 4; ++cell_x) {
+        ChunkSection* cell_section = cell_sections[(cell_z + 4) / 4][(cell_x + 4) / 4];
+        u16 biome_id = cell_section->chunks[chunk_y].biomes.GetBiome(cell_x & 3, cell_y, cell_z & 3);
+
+        size_t index = BorderedChunk::GetBiomeCellIndex(cell_x, cell_y, cell_z);
+
+        if (biome_codec) {
+          const world::Biome* biome = biome_codec->GetBiome(biome_id);
+
+          bordered_chunk->grass_colors[index] = biome->grass_color;
+          bordered_chunk->foliage_colors[index] = biome->foliage_color;
+          bordered_chunk->water_colors[index] = biome->water_color;
+        } else {
+          bordered_chunk->grass_colors[index] = world::kDefaultGrassColor;
+          bordered_chunk->foliage_colors[index] = world::kDefaultFoliageColor;
+          bordered_chunk->water_colors[index] = world::kDefaultWaterColor;
+        }
+      }
+    }
+  }
 }
 
 } // namespace render
@@ -3,48 +3,63 @@
 
 #include <polymer/asset/asset_system.h>
 #include <polymer/memory.h>
+#include <polymer/render/chunk_renderer.h>
 #include <polymer/types.h>
 #include <polymer/world/world.h>
 
+#include <stdio.h>
+#include <string.h>
+
 namespace polymer {
 
 namespace world {
 
 struct BlockRegistry;
+struct RenderableFace;
 
 } // namespace world
 
 namespace render {
 
-struct ChunkBuildQueue {
-  size_t count;
-  world::ChunkCoord data[1024];
+// Sections that need to be remeshed because their blocks changed. They are collected while packets are processed and
+// rebuilt once per frame, so a section is only meshed once no matter how many of its blocks changed.
+// The dirty bits live on the columns themselves, and this keeps the coordinates of the columns that have any.
+struct DirtySectionSet {
+  constexpr static size_t kMaxDirtyColumns = world::kMaxChunkColumns;
 
-  inline void Enqueue(s32 chunk_x, s32 chunk_z) {
-    data[count++] = {chunk_x, chunk_z};
-  }
+  world::ChunkCoord dirty_columns[kMaxDirtyColumns];
+  size_t dirty_count = 0;
+
+  inline void Mark(world::World& world, s32 chunk_x, s32 chunk_y, s32 chunk_z) {
+    if (chunk_y < 0 || chunk_y >= (s32)world::kChunkColumnCount) return;
+
+    world::ChunkColumn* column = world.GetLoadedColumn(chunk_x, chunk_z);
 
-  inline void Dequeue(s32 chunk_x, s32 chunk_z) {
-    for (size_t i = 0; i < count; ++i) {
-      if (data[i].x == chunk_x && data[i].z == chunk_z) {
-        data[i] = data[--count];
+    // Columns that aren't loaded will be fully built when they arrive.
+    if (!column) return;
+
+    if (column->dirty_mask == 0) {
+      if (dirty_count >= kMaxDirtyColumns) {
+        fprintf(stderr, "Too many dirty columns to rebuild (%d, %d).\n", chunk_x, chunk_z);
         return;
       }
+
+      dirty_columns[dirty_count++] = {chunk_x, chunk_z};
     }
+
+    column->dirty_mask |= (1 << chunk_y);
   }
 
-  inline bool IsInQueue(s32 chunk_x, s32 chunk_z) {
-    for (size_t i = 0; i < count; ++i) {
-      if (data[i].x == chunk_x && data[i].z == chunk_z) {
-        return true;
+  inline void Clear(world::World& world) {
+    for (size_t i = 0; i < dirty_count; ++i) {
+      world::ChunkColumn* column = world.GetColumn(dirty_columns[i].x, dirty_columns[i].z);
+
+      if (column) {
+        column->dirty_mask = 0;
       }
     }
 
-    return false;
-  }
-
-  inline void Clear() {
-    count = 0;
+    dirty_count = 0;
   }
 };
 
@@ -52,8 +67,7 @@ struct ChunkBuildContext {
   s32 chunk_x;
   s32 chunk_z;
 
-  u32 x_index = 0;
-  u32 z_index = 0;
+  world::ChunkColumn* column = nullptr;
 
   world::ChunkSection* section = nullptr;
   world::ChunkSection* east_section = nullptr;
@@ -65,48 +79,77 @@ struct ChunkBuildContext {
   world::ChunkSection* north_east_section = nullptr;
   world::ChunkSection* north_west_section = nullptr;
 
+  const world::BiomeCodec* biome_codec = nullptr;
+
   ChunkBuildContext(s32 chunk_x, s32 chunk_z) : chunk_x(chunk_x), chunk_z(chunk_z) {}
 
-  bool IsBuildable() {
-    return (east_section->info->loaded && east_section->info->x == chunk_x + 1 && east_section->info->z == chunk_z) &&
-           (west_section->info->loaded && west_section->info->x == chunk_x - 1 && west_section->info->z == chunk_z) &&
-           (north_section->info->loaded && north_section->info->z == chunk_z - 1 &&
-            north_section->info->x == chunk_x) &&
-           (south_section->info->loaded && south_section->info->z == chunk_z + 1 &&
-            south_section->info->x == chunk_x) &&
-           (south_east_section->info->loaded && south_east_section->info->z == chunk_z + 1 &&
-            south_east_section->info->x == chunk_x + 1) &&
-           (south_west_section->info->loaded && south_west_section->info->z == chunk_z + 1 &&
-            south_west_section->info->x == chunk_x - 1) &&
-           (north_east_section->info->loaded && north_east_section->info->z == chunk_z - 1 &&
-            north_east_section->info->x == chunk_x + 1) &&
-           (north_west_section->info->loaded && north_west_section->info->z == chunk_z - 1 &&
-            north_west_section->info->x == chunk_x - 1);
+  // Returns true if the column and all 8 of its neighbors are loaded.
+  bool GetNeighbors(world::World* world) {
+    column = world->GetLoadedColumn(chunk_x, chunk_z);
+    if (!column) return false;
+
+    section = &column->section;
+    biome_codec = &world->biome_codec;
+
+    return GetNeighbor(world, chunk_x + 1, chunk_z, &east_section) &&
+           GetNeighbor(world, chunk_x - 1, chunk_z, &west_section) &&
+           GetNeighbor(world, chunk_x, chunk_z - 1, &north_section) &&
+           GetNeighbor(world, chunk_x, chunk_z + 1, &south_section) &&
+           GetNeighbor(world, chunk_x + 1, chunk_z + 1, &south_east_section) &&
+           GetNeighbor(world, chunk_x - 1, chunk_z + 1, &south_west_section) &&
+           GetNeighbor(world, chunk_x + 1, chunk_z - 1, &north_east_section) &&
+           GetNeighbor(world, chunk_x - 1, chunk_z - 1, &north_west_section);
   }
 
-  bool GetNeighbors(world::World* world) {
-    x_index = world->GetChunkCacheIndex(chunk_x);
-    z_index = world->GetChunkCacheIndex(chunk_z);
-
-    u32 xeast_index = world->GetChunkCacheIndex(chunk_x + 1);
-    u32 xwest_index = world->GetChunkCacheIndex(chunk_x - 1);
-    u32 znorth_index = world->GetChunkCacheIndex(chunk_z - 1);
-    u32 zsouth_index = world->GetChunkCacheIndex(chunk_z + 1);
-
-    section = &world->chunks[z_index][x_index];
-    east_section = &world->chunks[z_index][xeast_index];
-    west_section = &world->chunks[z_index][xwest_index];
-    north_section = &world->chunks[znorth_index][x_index];
-    south_section = &world->chunks[zsouth_index][x_index];
-    south_east_section = &world->chunks[zsouth_index][xeast_index];
-    south_west_section = &world->chunks[zsouth_index][xwest_index];
-    north_east_section = &world->chunks[znorth_index][xeast_index];
-    north_west_section = &world->chunks[znorth_index][xwest_index];
-
-    return IsBuildable();
+private:
+  static inline bool GetNeighbor(world::World* world, s32 x, s32 z, world::ChunkSection** result) {
+    world::ChunkColumn* neighbor = world->GetLoadedColumn(x, z);
+
+    *result = neighbor ? &neighbor->section : nullptr;
+
+    return neighbor != nullptr;
   }
 };
 
+struct BorderedChunk {
+  constexpr static size_t kElementCount = 18 * 18 * 18;
+  // The 4x4x4 biome cells of the section with a border of one cell on each horizontal side.
+  constexpr static size_t kBiomeCellCount = 6 * 4 * 6;
+
+  u32 blocks[kElementCount];
+
+  // The bottom 4 bits contain the skylight data and the upper 4 bits contain the block
+  u8 lightmap[kElementCount];
+
+  // Biome colors are resolved when the chunk is filled so meshing doesn't depend on the biome codec.
+  u32 grass_colors[kBiomeCellCount];
+  u32 foliage_colors[kBiomeCellCount];
+  u32 water_colors[kBiomeCellCount];
+
+  // Cell x and z range from -1 to 4 and y ranges from 0 to 3.
+  static inline size_t GetBiomeCellIndex(s32 cell_x, s32 cell_y, s32 cell_z) {
+    return (size_t)((cell_y * 6 + (cell_z + 1)) * 6 + (cell_x + 1));
+  }
+
+  // Position is chunk relative
+  inline u8 GetBlockLight(size_t index) const {
+    return lightmap[index] >> 4;
+  }
+
+  // Position is chunk relative
+  inline u8 GetSkyLight(size_t index) const {
+    return lightmap[index] & 0x0F;
+  }
+};
+
+// Copies the chunk and the border blocks of its neighbors out of the world so it can be meshed independently of it.
+void FillBorderedChunk(BorderedChunk* bordered_chunk, ChunkBuildContext* ctx, s32 chunk_y);
+BorderedChunk* CreateBorderedChunk(MemoryArena& arena, ChunkBuildContext* ctx, s32 chunk_y);
+
+// Returns true if the section can't produce any faces, either because it's air or because it's a single solid block
+// state surrounded on every side by the same state. These are skipped entirely instead of being copied and meshed.
+bool IsSectionHidden(world::BlockRegistry& block_registry, ChunkBuildContext* ctx, s32 chunk_y);
+
 struct ChunkVertexData {
   u8* vertices[render::kRenderLayerCount];
   size_t vertex_count[render::kRenderLayerCount];
@@ -114,6 +157,9 @@ struct ChunkVertexData {
   u16* indices[render::kRenderLayerCount];
   size_t index_count[render::kRenderLayerCount];
 
+  u32* tints[render::kRenderLayerCount];
+  size_t tint_count[render::kRenderLayerCount];
+
   ChunkVertexData() {
     for (size_t i = 0; i < render::kRenderLayerCount; ++i) {
       vertices[i] = nullptr;
@@ -121,6 +167,9 @@ struct ChunkVertexData {
 
       indices[i] = nullptr;
       index_count[i] = 0;
+
+      tints[i] = nullptr;
+      tint_count[i] = 0;
     }
   }
 
@@ -133,6 +182,11 @@ struct ChunkVertexData {
     indices[(size_t)layer] = new_indices;
     index_count[(size_t)layer] = new_index_count;
   }
+
+  inline void SetTints(render::RenderLayer layer, u32* new_tints, size_t new_tint_count) {
+    tints[(size_t)layer] = new_tints;
+    tint_count[(size_t)layer] = new_tint_count;
+  }
 };
 
 struct BlockMesherMapping {
@@ -168,11 +222,51 @@ private:
   }
 };
 
+// A face that was deferred to the greedy pass so it can be merged with matching neighbors.
+struct GreedyFace {
+  world::RenderableFace* face;
+  u32 light;
+  u32 axis_data;
+  u32 tint;
+};
+
+// The distinct tints that the vertices of one layer use. Vertices store an index into it instead of the color so they
+// stay 12 bytes.
+struct TintPalette {
+  u32 colors[render::kChunkTintPaletteSize];
+  size_t count = 0;
+
+  // Faces of a block and its neighbors usually share a tint, so the last lookup is checked first.
+  u32 last_color = 0;
+  u8 last_index = 0;
+
+  // Adds the color if it isn't in the palette yet. The closest color is used once the palette is full.
+  u8 GetIndex(u32 color);
+
+  void Reset() {
+    count = 0;
+  }
+};
+
 struct BlockMesher {
-  BlockMesher(MemoryArena& trans_arena) : trans_arena(trans_arena) {
+  // One 16x16x16 mask for each face direction.
+  constexpr static size_t kGreedyFaceCount = 6 * 16 * 16 * 16;
+  // Indices are u16, so one layer of a section can't reference more vertices than this.
+  constexpr static size_t kMaxLayerVertexCount = 65536;
+  // Double sided faces push 12 indices for every 4 vertices, which is the most indices a vertex can have.
+  constexpr static size_t kMaxLayerIndexCount = kMaxLayerVertexCount * 3;
+
+  BlockMesher() {
     for (size_t i = 0; i < render::kRenderLayerCount; ++i) {
-      vertex_arenas[i] = CreateArena(Megabytes(16));
-      index_arenas[i] = CreateArena(Megabytes(4));
+      vertex_arenas[i] = CreateArena(kMaxLayerVertexCount * sizeof(render::ChunkVertex));
+      index_arenas[i] = CreateArena(kMaxLayerIndexCount * sizeof(u16));
+    }
+
+    greedy_arena = CreateArena(sizeof(GreedyFace) * kGreedyFaceCount);
+    greedy_faces = memory_arena_push_type_count(&greedy_arena, GreedyFace, kGreedyFaceCount);
+
+    for (size_t i = 0; i < kGreedyFaceCount; ++i) {
+      greedy_faces[i].face = nullptr;
     }
   }
 
@@ -181,24 +275,33 @@ struct BlockMesher {
       vertex_arenas[i].Destroy();
       index_arenas[i].Destroy();
     }
+
+    greedy_arena.Destroy();
   }
 
   void Reset() {
     for (size_t i = 0; i < render::kRenderLayerCount; ++i) {
       vertex_arenas[i].Reset();
       index_arenas[i].Reset();
+      tint_palettes[i].Reset();
     }
   }
 
   asset::TextureIdRange water_texture;
-  MemoryArena& trans_arena;
   MemoryArena vertex_arenas[render::kRenderLayerCount];
   MemoryArena index_arenas[render::kRenderLayerCount];
+  TintPalette tint_palettes[render::kRenderLayerCount];
 
   BlockMesherMapping mapping;
 
-  ChunkVertexData CreateMesh(asset::AssetSystem& assets, world::BlockRegistry& block_registry, ChunkBuildContext* ctx,
-                             s32 chunk_y);
+  // Merges full cube faces with the same texture and light into larger quads.
+  bool greedy_meshing = true;
+  MemoryArena greedy_arena;
+  GreedyFace* greedy_faces;
+
+  // The returned vertex data points into the mesher arenas, so it's only valid until the next Reset.
+  ChunkVertexData CreateMesh(asset::AssetSystem& assets, world::BlockRegistry& block_registry,
+                             BorderedChunk* bordered_chunk, s32 chunk_x, s32 chunk_y, s32 chunk_z);
 };
 
 } // namespace render
@@ -0,0 +1,209 @@
+#include <polymer/render/chunk_build_scheduler.h>
+
+#include <polymer/camera.h>
+#include <polymer/memory.h>
+#include <polymer/render/block_mesher.h>
+
+#include <stdio.h>
+
+namespace polymer {
+namespace render {
+
+using world::ChunkColumn;
+
+// Columns outside of the frustum are treated as if they were this many times further away so the visible ones are
+// built first, but close columns behind the camera are still ready when turning around.
+constexpr float kHiddenPriorityScale = 4.0f;
+
+void ChunkBuildScheduler::Initialize(MemoryArena& arena) {
+  ready = memory_arena_push_type_count(&arena, ChunkColumn*, world::kMaxChunkColumns);
+  ready_capacity = ready ? world::kMaxChunkColumns : 0;
+  ready_count = 0;
+
+  if (!ready) {
+    fprintf(stderr, "Failed to allocate chunk build heap.\n");
+  }
+}
+
+void ChunkBuildScheduler::Enqueue(world::World& world, s32 chunk_x, s32 chunk_z) {
+  ChunkColumn* column = world.GetLoadedColumn(chunk_x, chunk_z);
+
+  if (!column) return;
+
+  if ((State)column->build_state == State::None) {
+    column->build_state = (u8)State::Waiting;
+    column->build_priority = 0.0f;
+    ++waiting_count;
+  }
+
+  OnNeighborhoodChange(world, chunk_x, chunk_z);
+}
+
+void ChunkBuildScheduler::Dequeue(ChunkColumn* column) {
+  State state = (State)column->build_state;
+
+  if (state == State::Ready) {
+    RemoveReady(column);
+  } else if (state == State::Waiting) {
+    --waiting_count;
+  }
+
+  column->build_state = (u8)State::None;
+}
+
+void ChunkBuildScheduler::OnNeighborhoodChange(world::World& world, s32 chunk_x, s32 chunk_z) {
+  for (s32 z = chunk_z - 1; z <= chunk_z + 1; ++z) {
+    for (s32 x = chunk_x - 1; x <= chunk_x + 1; ++x) {
+      ChunkColumn* column = world.GetColumn(x, z);
+
+      if (column && IsInQueue(column)) {
+        Refresh(world, column);
+      }
+    }
+  }
+}
+
+void ChunkBuildScheduler::Refresh(world::World& world, ChunkColumn* column) {
+  ChunkBuildContext ctx(column->info.x, column->info.z);
+
+  bool buildable = ctx.GetNeighbors(&world);
+  State state = (State)column->build_state;
+
+  if (buildable && state == State::Waiting) {
+    // Stay waiting if the heap can't grow so it's picked up on the next change around it.
+    if (!PushReady(column)) return;
+
+    --waiting_count;
+    column->build_state = (u8)State::Ready;
+  } else if (!buildable && state == State::Ready) {
+    RemoveReady(column);
+    column->build_state = (u8)State::Waiting;
+    ++waiting_count;
+  }
+}
+
+void ChunkBuildScheduler::Prioritize(Camera& camera) {
+  if (ready_count == 0) return;
+
+  Frustum frustum = camera.GetViewFrustum();
+
+  for (size_t i = 0; i < ready_count; ++i) {
+    ChunkColumn* column = ready[i];
+
+    float dx = column->info.x * 16.0f + 8.0f - camera.position.x;
+    float dz = column->info.z * 16.0f + 8.0f - camera.position.z;
+
+    column->build_priority = dx * dx + dz * dz;
+
+    Vector3f column_min(column->info.x * 16.0f, -64.0f, column->info.z * 16.0f);
+    Vector3f column_max(column->info.x * 16.0f + 16.0f, world::kChunkColumnCount * 16.0f - 64.0f,
+                        column->info.z * 16.0f + 16.0f);
+
+    if (!frustum.Intersects(column_min, column_max)) {
+      column->build_priority *= kHiddenPriorityScale;
+    }
+  }
+
+  for (size_t i = ready_count / 2; i-- > 0;) {
+    SiftDown(i);
+  }
+}
+
+bool ChunkBuildScheduler::PopReady(world::ChunkCoord* coord) {
+  if (ready_count == 0) return false;
+
+  ChunkColumn* column = ready[0];
+
+  coord->x = column->info.x;
+  coord->z = column->info.z;
+
+  SwapReady(0, --ready_count);
+  SiftDown(0);
+
+  column->build_state = (u8)State::None;
+
+  return true;
+}
+
+void ChunkBuildScheduler::Clear(world::World& world) {
+  for (size_t i = 0; i < world.column_count; ++i) {
+    world.columns[i]->build_state = (u8)State::None;
+  }
+
+  ready_count = 0;
+  waiting_count = 0;
+}
+
+bool ChunkBuildScheduler::PushReady(ChunkColumn* column) {
+  if (ready_count >= ready_capacity) {
+    fprintf(stderr, "Chunk build heap is full.\n");
+    return false;
+  }
+
+  // The priority is from the last Prioritize, so it's placed with that until the next one.
+  column->build_heap_index = (u32)ready_count;
+  ready[ready_count++] = column;
+
+  SiftUp(ready_count - 1);
+
+  return true;
+}
+
+void ChunkBuildScheduler::RemoveReady(ChunkColumn* column) {
+  size_t heap_index = column->build_heap_index;
+
+  SwapReady(heap_index, --ready_count);
+
+  // The column that was moved into the hole can belong either above or below it.
+  if (heap_index < ready_count) {
+    ChunkColumn* moved = ready[heap_index];
+
+    SiftUp(heap_index);
+    SiftDown(moved->build_heap_index);
+  }
+}
+
+void ChunkBuildScheduler::SiftUp(size_t heap_index) {
+  while (heap_index > 0) {
+    size_t parent = (heap_index - 1) / 2;
+
+    if (ready[parent]->build_priority <= ready[heap_index]->build_priority) break;
+
+    SwapReady(heap_index, parent);
+    heap_index = parent;
+  }
+}
+
+void ChunkBuildScheduler::SiftDown(size_t heap_index) {
+  while (true) {
+    size_t left = heap_index * 2 + 1;
+    size_t right = left + 1;
+    size_t smallest = heap_index;
+
+    if (left < ready_count && ready[left]->build_priority < ready[smallest]->build_priority) {
+      smallest = left;
+    }
+
+    if (right < ready_count && ready[right]->build_priority < ready[smallest]->build_priority) {
+      smallest = right;
+    }
+
+    if (smallest == heap_index) break;
+
+    SwapReady(heap_index, smallest);
+    heap_index = smallest;
+  }
+}
+
+void ChunkBuildScheduler::SwapReady(size_t a, size_t b) {
+  ChunkColumn* temp = ready[a];
+
+  ready[a] = ready[b];
+  ready[b] = temp;
+
+  ready[a]->build_heap_index = (u32)a;
+  ready[b]->build_heap_index = (u32)b;
+}
+
+} // namespace render
+} // namespace polymer
@@ -0,0 +1,69 @@
+#ifndef POLYMER_RENDER_CHUNK_BUILD_SCHEDULER_H_
+#define POLYMER_RENDER_CHUNK_BUILD_SCHEDULER_H_
+
+#include <polymer/types.h>
+#include <polymer/world/world.h>
+
+namespace polymer {
+
+struct Camera;
+struct MemoryArena;
+
+namespace render {
+
+// Tracks the chunk columns that are waiting to be meshed. A column only becomes ready once all 8 of its neighbors are
+// loaded, which is re-evaluated when a column in its neighborhood loads or unloads instead of polling every frame.
+// Ready columns are handed out closest first, with columns outside of the view frustum pushed back.
+// The per-column state is stored on the world's columns, so this only holds the ready heap.
+struct ChunkBuildScheduler {
+  enum class State : u8 { None, Waiting, Ready };
+
+  // Min-heap of ready columns ordered by priority. Every column is in it at most once, so it's sized for the whole
+  // chunk cache up front.
+  world::ChunkColumn** ready = nullptr;
+  size_t ready_count = 0;
+  size_t ready_capacity = 0;
+
+  size_t waiting_count = 0;
+
+  void Initialize(MemoryArena& arena);
+
+  // The column must already be marked as loaded in the world.
+  void Enqueue(world::World& world, s32 chunk_x, s32 chunk_z);
+  void Dequeue(world::ChunkColumn* column);
+
+  inline bool IsInQueue(const world::ChunkColumn* column) const {
+    return (State)column->build_state != State::None;
+  }
+
+  // Must be called after a column in the world loads or unloads so the columns around it can be re-evaluated.
+  void OnNeighborhoodChange(world::World& world, s32 chunk_x, s32 chunk_z);
+
+  // Recalculates the priority of every ready column from the camera and rebuilds the heap.
+  // This must be called before popping in a frame since the camera moves and the queue changes between frames.
+  void Prioritize(Camera& camera);
+
+  // Removes the highest priority ready column from the scheduler. Returns false if nothing is ready.
+  bool PopReady(world::ChunkCoord* coord);
+
+  void Clear(world::World& world);
+
+  inline size_t GetQueuedCount() const {
+    return waiting_count + ready_count;
+  }
+
+private:
+  void Refresh(world::World& world, world::ChunkColumn* column);
+
+  bool PushReady(world::ChunkColumn* column);
+  void RemoveReady(world::ChunkColumn* column);
+
+  void SiftUp(size_t heap_index);
+  void SiftDown(size_t heap_index);
+  void SwapReady(size_t a, size_t b);
+};
+
+} // namespace render
+} // namespace polymer
+
+#endif
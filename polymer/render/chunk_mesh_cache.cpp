@@ -0,0 +1,220 @@
+#include <polymer/render/chunk_mesh_cache.h>
+
+#include <polymer/platform/platform.h>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace polymer {
+namespace render {
+
+constexpr u64 kHashPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr u64 kHashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr u64 kHashPrime3 = 0x165667B19E3779F9ULL;
+
+static inline u64 RotateLeft(u64 value, u32 amount) {
+  return (value << amount) | (value >> (64 - amount));
+}
+
+static inline u64 HashRound(u64 accumulator, u64 value) {
+  accumulator += value * kHashPrime2;
+  accumulator = RotateLeft(accumulator, 31);
+
+  return accumulator * kHashPrime1;
+}
+
+static inline u64 ReadU64(const u8* data) {
+  u64 value;
+
+  memcpy(&value, data, sizeof(value));
+
+  return value;
+}
+
+u64 HashBorderedChunk(const BorderedChunk& bordered_chunk, s32 chunk_x, s32 chunk_y, s32 chunk_z) {
+  const u8* data = (const u8*)&bordered_chunk;
+  constexpr size_t kSize = sizeof(BorderedChunk);
+
+  // Four independent lanes so the multiplies don't wait on each other. The snapshot is zeroed before it's filled, so
+  // the same blocks, light and colors always hash the same.
+  u64 lanes[4] = {kHashPrime1 + kHashPrime2, kHashPrime2, 0, 0 - kHashPrime1};
+  size_t offset = 0;
+
+  for (; offset + 32 <= kSize; offset += 32) {
+    lanes[0] = HashRound(lanes[0], ReadU64(data + offset + 0));
+    lanes[1] = HashRound(lanes[1], ReadU64(data + offset + 8));
+    lanes[2] = HashRound(lanes[2], ReadU64(data + offset + 16));
+    lanes[3] = HashRound(lanes[3], ReadU64(data + offset + 24));
+  }
+
+  u64 hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+
+  for (; offset + 8 <= kSize; offset += 8) {
+    hash ^= HashRound(0, ReadU64(data + offset));
+    hash = RotateLeft(hash, 27) * kHashPrime1 + kHashPrime3;
+  }
+
+  for (; offset < kSize; ++offset) {
+    hash ^= data[offset] * kHashPrime3;
+    hash = RotateLeft(hash, 11) * kHashPrime1;
+  }
+
+  u64 position = ((u64)(u32)chunk_x << 32) | (u64)(u32)chunk_z;
+
+  hash ^= HashRound(0, position);
+  hash = RotateLeft(hash, 27) * kHashPrime1 + kHashPrime3;
+  hash ^= HashRound(0, (u64)(u32)chunk_y);
+  hash = RotateLeft(hash, 27) * kHashPrime1 + kHashPrime3;
+
+  hash ^= hash >> 33;
+  hash *= kHashPrime2;
+  hash ^= hash >> 29;
+  hash *= kHashPrime3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
+
+bool ChunkMeshCache::Initialize(MemoryArena& arena, size_t memory_budget) {
+  this->memory_budget = memory_budget;
+
+  entries = memory_arena_push_type_count(&arena, ChunkMeshCacheEntry, kEntryCount);
+  buckets = memory_arena_push_type_count(&arena, ChunkMeshCacheEntry*, kBucketCount);
+
+  if (!entries || !buckets) {
+    fprintf(stderr, "Failed to allocate chunk mesh cache.\n");
+    return false;
+  }
+
+  memset(buckets, 0, sizeof(ChunkMeshCacheEntry*) * kBucketCount);
+
+  free_entries = nullptr;
+
+  for (size_t i = 0; i < kEntryCount; ++i) {
+    ChunkMeshCacheEntry* entry = entries + i;
+
+    entry->output = nullptr;
+    entry->next = free_entries;
+    free_entries = entry;
+  }
+
+  head = tail = nullptr;
+  entry_count = 0;
+  memory_usage = 0;
+
+  return true;
+}
+
+void ChunkMeshCache::Clear() {
+  while (tail) {
+    Evict(tail);
+  }
+}
+
+const ChunkVertexData* ChunkMeshCache::Find(u64 key) {
+  for (ChunkMeshCacheEntry* entry = *GetBucket(key); entry; entry = entry->bucket_next) {
+    if (entry->key == key) {
+      Unlink(entry);
+      PushHead(entry);
+
+      return &entry->vertex_data;
+    }
+  }
+
+  return nullptr;
+}
+
+void ChunkMeshCache::Insert(u64 key, u8* output, size_t output_size, const ChunkVertexData& vertex_data) {
+  if (!entries || output_size > memory_budget) {
+    if (output) {
+      g_Platform.Free(output);
+    }
+
+    return;
+  }
+
+  // The same snapshot could have been meshed twice if it was submitted again before the first one finished.
+  for (ChunkMeshCacheEntry* entry = *GetBucket(key); entry; entry = entry->bucket_next) {
+    if (entry->key == key) {
+      Evict(entry);
+      break;
+    }
+  }
+
+  while (tail && (!free_entries || memory_usage + output_size > memory_budget)) {
+    Evict(tail);
+  }
+
+  ChunkMeshCacheEntry* entry = free_entries;
+  free_entries = entry->next;
+
+  entry->key = key;
+  entry->output = output;
+  entry->output_size = output_size;
+  entry->vertex_data = vertex_data;
+
+  ChunkMeshCacheEntry** bucket = GetBucket(key);
+
+  entry->bucket_next = *bucket;
+  *bucket = entry;
+
+  PushHead(entry);
+
+  memory_usage += output_size;
+  ++entry_count;
+}
+
+void ChunkMeshCache::Unlink(ChunkMeshCacheEntry* entry) {
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    head = entry->next;
+  }
+
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    tail = entry->prev;
+  }
+
+  entry->prev = entry->next = nullptr;
+}
+
+void ChunkMeshCache::PushHead(ChunkMeshCacheEntry* entry) {
+  entry->prev = nullptr;
+  entry->next = head;
+
+  if (head) {
+    head->prev = entry;
+  } else {
+    tail = entry;
+  }
+
+  head = entry;
+}
+
+void ChunkMeshCache::Evict(ChunkMeshCacheEntry* entry) {
+  Unlink(entry);
+
+  ChunkMeshCacheEntry** link = GetBucket(entry->key);
+
+  while (*link != entry) {
+    link = &(*link)->bucket_next;
+  }
+
+  *link = entry->bucket_next;
+
+  if (entry->output) {
+    g_Platform.Free(entry->output);
+    entry->output = nullptr;
+  }
+
+  memory_usage -= entry->output_size;
+  --entry_count;
+
+  entry->next = free_entries;
+  free_entries = entry;
+}
+
+} // namespace render
+} // namespace polymer
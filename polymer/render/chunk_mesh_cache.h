@@ -0,0 +1,74 @@
+#ifndef POLYMER_RENDER_CHUNK_MESH_CACHE_H_
+#define POLYMER_RENDER_CHUNK_MESH_CACHE_H_
+
+#include <polymer/memory.h>
+#include <polymer/render/block_mesher.h>
+#include <polymer/types.h>
+
+namespace polymer {
+namespace render {
+
+// Hashes everything a section's mesh is built from, which is its snapshot with the neighbor borders and its position,
+// since the vertices are placed and textured by their world position.
+u64 HashBorderedChunk(const BorderedChunk& bordered_chunk, s32 chunk_x, s32 chunk_y, s32 chunk_z);
+
+struct ChunkMeshCacheEntry {
+  u64 key;
+
+  // Single allocation that holds the vertex and index data, or null if the section had no geometry.
+  u8* output;
+  size_t output_size;
+  ChunkVertexData vertex_data;
+
+  // Most recently used entries are at the head of the list and evicted from the tail.
+  ChunkMeshCacheEntry* prev;
+  ChunkMeshCacheEntry* next;
+
+  ChunkMeshCacheEntry* bucket_next;
+};
+
+// Keeps the vertex data of recently meshed sections keyed by the hash of the snapshot they were built from. Sections
+// that are sent again unchanged, such as when moving back and forth across the view distance, can then be uploaded
+// without meshing them again. Only accessed from the main thread.
+struct ChunkMeshCache {
+  constexpr static size_t kEntryCount = 8192;
+  constexpr static size_t kBucketCount = 16384;
+  constexpr static size_t kDefaultMemoryBudget = Megabytes(128);
+
+  ChunkMeshCacheEntry* entries = nullptr;
+  ChunkMeshCacheEntry* free_entries = nullptr;
+  ChunkMeshCacheEntry** buckets = nullptr;
+
+  ChunkMeshCacheEntry* head = nullptr;
+  ChunkMeshCacheEntry* tail = nullptr;
+
+  size_t entry_count = 0;
+  size_t memory_budget = 0;
+  size_t memory_usage = 0;
+
+  bool Initialize(MemoryArena& arena, size_t memory_budget);
+  // Frees every cached mesh.
+  void Clear();
+
+  // Returns the cached vertex data and marks it as recently used, or null if it isn't cached.
+  // The data is only valid until the next insert.
+  const ChunkVertexData* Find(u64 key);
+
+  // Takes ownership of the output allocation that the vertex data points into. Least recently used meshes are evicted
+  // until it fits in the memory budget.
+  void Insert(u64 key, u8* output, size_t output_size, const ChunkVertexData& vertex_data);
+
+private:
+  inline ChunkMeshCacheEntry** GetBucket(u64 key) {
+    return buckets + (key & (kBucketCount - 1));
+  }
+
+  void Unlink(ChunkMeshCacheEntry* entry);
+  void PushHead(ChunkMeshCacheEntry* entry);
+  void Evict(ChunkMeshCacheEntry* entry);
+};
+
+} // namespace render
+} // namespace polymer
+
+#endif
@@ -0,0 +1,339 @@
+#include <polymer/render/chunk_mesh_pool.h>
+
+#include <polymer/memory.h>
+#include <polymer/platform/platform.h>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace polymer {
+namespace render {
+
+bool ChunkMeshPool::Initialize(MemoryArena& perm_arena, asset::AssetSystem& assets,
+                               world::BlockRegistry& block_registry, const BlockMesher& settings) {
+  this->assets = &assets;
+  this->block_registry = &block_registry;
+
+  jobs = memory_arena_push_type_count(&perm_arena, ChunkMeshJob, kJobCount);
+  if (!jobs) {
+    fprintf(stderr, "Failed to allocate chunk mesh jobs.\n");
+    return false;
+  }
+
+  free_jobs = nullptr;
+  free_count = 0;
+
+  for (size_t i = 0; i < kJobCount; ++i) {
+    ChunkMeshJob* job = jobs + i;
+
+    job->output = nullptr;
+    job->next = free_jobs;
+    free_jobs = job;
+    ++free_count;
+  }
+
+  pending_head = pending_tail = completed = nullptr;
+
+  if (!cache.Initialize(perm_arena, ChunkMeshCache::kDefaultMemoryBudget)) {
+    return false;
+  }
+
+  // Leave a core for the main thread.
+  size_t hardware_count = (size_t)std::thread::hardware_concurrency();
+  worker_count = hardware_count > 1 ? hardware_count - 1 : 1;
+
+  if (worker_count > kMaxWorkers) {
+    worker_count = kMaxWorkers;
+  }
+
+  running = true;
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers[i] = perm_arena.Construct<ChunkMeshWorker>();
+    workers[i]->mesher.mapping = settings.mapping;
+    workers[i]->mesher.greedy_meshing = settings.greedy_meshing;
+    active[i] = nullptr;
+  }
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers[i]->thread = std::thread(&ChunkMeshPool::WorkerMain, this, i);
+  }
+
+  printf("Chunk mesh workers: %zu\n", worker_count);
+
+  return true;
+}
+
+void ChunkMeshPool::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+
+  work_signal.notify_all();
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    if (workers[i]->thread.joinable()) {
+      workers[i]->thread.join();
+    }
+
+    workers[i]->~ChunkMeshWorker();
+  }
+
+  worker_count = 0;
+
+  for (size_t i = 0; i < kJobCount; ++i) {
+    if (jobs[i].output) {
+      g_Platform.Free(jobs[i].output);
+      jobs[i].output = nullptr;
+    }
+  }
+
+  cache.Clear();
+}
+
+bool ChunkMeshPool::Submit(ChunkBuildContext* ctx, s32 chunk_y, const ChunkVertexData** cached_mesh) {
+  *cached_mesh = nullptr;
+
+  ChunkMeshJob* job = free_jobs;
+
+  if (!job) return false;
+
+  // The snapshot is taken on the main thread so the world can keep changing while the workers mesh.
+  FillBorderedChunk(&job->bordered_chunk, ctx, chunk_y);
+
+  job->content_hash = HashBorderedChunk(job->bordered_chunk, ctx->chunk_x, chunk_y, ctx->chunk_z);
+
+  const ChunkVertexData* cached = cache.Find(job->content_hash);
+
+  if (cached) {
+    // Anything still meshing for this section is older than the mesh that is about to be uploaded.
+    Cancel(ctx->chunk_x, chunk_y, ctx->chunk_z);
+
+    *cached_mesh = cached;
+    return true;
+  }
+
+  free_jobs = job->next;
+  --free_count;
+
+  job->chunk_x = ctx->chunk_x;
+  job->chunk_y = chunk_y;
+  job->chunk_z = ctx->chunk_z;
+  job->cancelled = false;
+  job->meshed = false;
+  job->column_version = ctx->column ? ctx->column->version : 0;
+  job->section_version = ctx->column ? ctx->column->section_versions[chunk_y] : 0;
+  job->output = nullptr;
+  job->output_size = 0;
+  job->next = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (pending_tail) {
+      pending_tail->next = job;
+    } else {
+      pending_head = job;
+    }
+
+    pending_tail = job;
+  }
+
+  work_signal.notify_one();
+
+  return true;
+}
+
+ChunkMeshJob* ChunkMeshPool::PopCompleted() {
+  while (true) {
+    ChunkMeshJob* job = nullptr;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      job = completed;
+      if (!job) return nullptr;
+
+      completed = job->next;
+      job->next = nullptr;
+    }
+
+    if (!job->cancelled) {
+      return job;
+    }
+
+    Release(job);
+  }
+
+  return nullptr;
+}
+
+void ChunkMeshPool::Release(ChunkMeshJob* job) {
+  // The mesh is keyed by its content, so it's still valid for the next time the same snapshot is submitted even if
+  // this one was cancelled or its column was unloaded.
+  if (job->meshed) {
+    cache.Insert(job->content_hash, job->output, job->output_size, job->vertex_data);
+  } else if (job->output) {
+    g_Platform.Free(job->output);
+  }
+
+  job->output = nullptr;
+
+  job->next = free_jobs;
+  free_jobs = job;
+  ++free_count;
+}
+
+void ChunkMeshPool::Cancel(s32 chunk_x, s32 chunk_z) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (ChunkMeshJob* job = pending_head; job; job = job->next) {
+    if (job->chunk_x == chunk_x && job->chunk_z == chunk_z) job->cancelled = true;
+  }
+
+  for (ChunkMeshJob* job = completed; job; job = job->next) {
+    if (job->chunk_x == chunk_x && job->chunk_z == chunk_z) job->cancelled = true;
+  }
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    ChunkMeshJob* job = active[i];
+
+    if (job && job->chunk_x == chunk_x && job->chunk_z == chunk_z) job->cancelled = true;
+  }
+}
+
+void ChunkMeshPool::Cancel(s32 chunk_x, s32 chunk_y, s32 chunk_z) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (ChunkMeshJob* job = pending_head; job; job = job->next) {
+    if (job->chunk_x == chunk_x && job->chunk_y == chunk_y && job->chunk_z == chunk_z) job->cancelled = true;
+  }
+
+  for (ChunkMeshJob* job = completed; job; job = job->next) {
+    if (job->chunk_x == chunk_x && job->chunk_y == chunk_y && job->chunk_z == chunk_z) job->cancelled = true;
+  }
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    ChunkMeshJob* job = active[i];
+
+    if (job && job->chunk_x == chunk_x && job->chunk_y == chunk_y && job->chunk_z == chunk_z) job->cancelled = true;
+  }
+}
+
+void ChunkMeshPool::CancelAll() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (ChunkMeshJob* job = pending_head; job; job = job->next) {
+    job->cancelled = true;
+  }
+
+  for (ChunkMeshJob* job = completed; job; job = job->next) {
+    job->cancelled = true;
+  }
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    if (active[i]) active[i]->cancelled = true;
+  }
+}
+
+void ChunkMeshPool::WorkerMain(size_t worker_index) {
+  BlockMesher& mesher = workers[worker_index]->mesher;
+
+  while (true) {
+    ChunkMeshJob* job = nullptr;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      work_signal.wait(lock, [this] { return !running || pending_head != nullptr; });
+
+      if (!running) break;
+
+      job = pending_head;
+      pending_head = job->next;
+
+      if (!pending_head) {
+        pending_tail = nullptr;
+      }
+
+      job->next = nullptr;
+
+      if (job->cancelled) {
+        // Skip the meshing and let the main thread put it back in the free list.
+        job->next = completed;
+        completed = job;
+        continue;
+      }
+
+      active[worker_index] = job;
+    }
+
+    ChunkVertexData vertex_data =
+        mesher.CreateMesh(*assets, *block_registry, &job->bordered_chunk, job->chunk_x, job->chunk_y, job->chunk_z);
+
+    // Copy the data out of the mesher arenas into one allocation so the mesher can be reused for the next job while
+    // this one waits to be uploaded.
+    size_t output_size = 0;
+
+    for (size_t i = 0; i < kRenderLayerCount; ++i) {
+      output_size += vertex_data.vertex_count[i] * sizeof(ChunkVertex);
+      output_size += vertex_data.tint_count[i] * sizeof(u32);
+      output_size += vertex_data.index_count[i] * sizeof(u16);
+    }
+
+    if (output_size > 0) {
+      job->output = g_Platform.Allocate(output_size);
+    }
+
+    job->output_size = job->output ? output_size : 0;
+
+    if (job->output) {
+      u8* write = job->output;
+
+      // Vertices and tints are written first so they stay aligned.
+      for (size_t i = 0; i < kRenderLayerCount; ++i) {
+        size_t size = vertex_data.vertex_count[i] * sizeof(ChunkVertex);
+
+        memcpy(write, vertex_data.vertices[i], size);
+        job->vertex_data.SetVertices((RenderLayer)i, write, vertex_data.vertex_count[i]);
+        write += size;
+      }
+
+      for (size_t i = 0; i < kRenderLayerCount; ++i) {
+        size_t size = vertex_data.tint_count[i] * sizeof(u32);
+
+        memcpy(write, vertex_data.tints[i], size);
+        job->vertex_data.SetTints((RenderLayer)i, (u32*)write, vertex_data.tint_count[i]);
+        write += size;
+      }
+
+      for (size_t i = 0; i < kRenderLayerCount; ++i) {
+        size_t size = vertex_data.index_count[i] * sizeof(u16);
+
+        memcpy(write, vertex_data.indices[i], size);
+        job->vertex_data.SetIndices((RenderLayer)i, (u16*)write, vertex_data.index_count[i]);
+        write += size;
+      }
+    } else {
+      job->vertex_data = ChunkVertexData();
+    }
+
+    mesher.Reset();
+
+    // A mesh whose output failed to allocate is uploaded empty, so it must not be cached.
+    job->meshed = output_size == 0 || job->output != nullptr;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      active[worker_index] = nullptr;
+
+      job->next = completed;
+      completed = job;
+    }
+  }
+}
+
+} // namespace render
+} // namespace polymer
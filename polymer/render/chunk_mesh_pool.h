@@ -0,0 +1,112 @@
+#ifndef POLYMER_RENDER_CHUNK_MESH_POOL_H_
+#define POLYMER_RENDER_CHUNK_MESH_POOL_H_
+
+#include <polymer/render/block_mesher.h>
+#include <polymer/render/chunk_mesh_cache.h>
+#include <polymer/types.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace polymer {
+
+struct MemoryArena;
+
+namespace render {
+
+struct ChunkMeshJob {
+  s32 chunk_x;
+  s32 chunk_y;
+  s32 chunk_z;
+
+  // Set when the world data that was snapshotted is no longer valid, so the result should be thrown away.
+  bool cancelled;
+  // Set by the worker once the mesh is built, so it can be cached even if the job was cancelled afterwards.
+  bool meshed;
+
+  // The versions of the column and section when they were snapshotted. The mesh is dropped if either changed since.
+  u32 column_version;
+  u32 section_version;
+
+  // Copy of the chunk and its neighbor borders so the workers never have to read from the world.
+  BorderedChunk bordered_chunk;
+  // Hash of the snapshot that the finished mesh is cached under.
+  u64 content_hash;
+
+  // Single allocation that holds all of the finished vertex and index data. The vertex data points into this.
+  u8* output;
+  size_t output_size;
+  ChunkVertexData vertex_data;
+
+  ChunkMeshJob* next;
+};
+
+struct ChunkMeshWorker {
+  std::thread thread;
+  BlockMesher mesher;
+};
+
+// Meshes chunks on a set of worker threads. Jobs are submitted and collected from the main thread, which is the only
+// thread that touches the world or the renderer.
+struct ChunkMeshPool {
+  constexpr static size_t kMaxWorkers = 16;
+  constexpr static size_t kJobCount = 256;
+
+  asset::AssetSystem* assets = nullptr;
+  world::BlockRegistry* block_registry = nullptr;
+
+  ChunkMeshWorker* workers[kMaxWorkers];
+  size_t worker_count = 0;
+
+  ChunkMeshJob* jobs = nullptr;
+
+  // Only accessed by the main thread. Finished meshes are moved into it when their job is released.
+  ChunkMeshCache cache;
+
+  // Only accessed by the main thread.
+  ChunkMeshJob* free_jobs = nullptr;
+  size_t free_count = 0;
+
+  // Everything below is protected by the mutex.
+  std::mutex mutex;
+  std::condition_variable work_signal;
+
+  ChunkMeshJob* pending_head = nullptr;
+  ChunkMeshJob* pending_tail = nullptr;
+  ChunkMeshJob* completed = nullptr;
+  // Jobs that are currently being meshed by a worker.
+  ChunkMeshJob* active[kMaxWorkers];
+
+  bool running = false;
+
+  bool Initialize(MemoryArena& perm_arena, asset::AssetSystem& assets, world::BlockRegistry& block_registry,
+                  const BlockMesher& settings);
+  void Shutdown();
+
+  inline size_t GetFreeJobCount() const {
+    return free_count;
+  }
+
+  // Snapshots the chunk from the world and queues it for meshing. Returns false if there are no free jobs.
+  // If the same snapshot was meshed recently, nothing is queued and cached_mesh is set to its vertex data, which must
+  // be uploaded before anything else is released. Otherwise cached_mesh is set to null.
+  bool Submit(ChunkBuildContext* ctx, s32 chunk_y, const ChunkVertexData** cached_mesh);
+
+  // Returns a finished job or null if there are none. The job must be given back with Release after it's uploaded.
+  ChunkMeshJob* PopCompleted();
+  // Moves the finished mesh into the cache and puts the job back in the free list.
+  void Release(ChunkMeshJob* job);
+
+  void Cancel(s32 chunk_x, s32 chunk_z);
+  void Cancel(s32 chunk_x, s32 chunk_y, s32 chunk_z);
+  void CancelAll();
+
+private:
+  void WorkerMain(size_t worker_index);
+};
+
+} // namespace render
+} // namespace polymer
+
+#endif
@@ -1,9 +1,11 @@
 #include <polymer/render/chunk_renderer.h>
 
+#include <polymer/platform/platform.h>
 #include <polymer/render/render.h>
 #include <polymer/world/world.h>
 
 #include <stdio.h>
+#include <string.h>
 
 #pragma warning(disable : 26812) // disable unscoped enum warning
 
@@ -15,6 +17,9 @@ const char* kRenderLayerNames[kRenderLayerCount] = {"opaque", "flora", "leaf", "
 static const char* kChunkVertShader = "shaders/chunk_vert.spv";
 static const char* kChunkFragShader = "shaders/chunk_frag.spv";
 
+// Enough for every section in the chunk cache to be visible at once.
+constexpr size_t kMaxSectionDraws = world::kMaxChunkColumns * world::kChunkColumnCount;
+
 bool ChunkRenderLayout::Create(VkDevice device) {
   VkDescriptorSetLayoutBinding ubo_binding = {};
   ubo_binding.binding = 0;
@@ -29,7 +34,13 @@ bool ChunkRenderLayout::Create(VkDevice device) {
   sampler_binding.pImmutableSamplers = nullptr;
   sampler_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-  VkDescriptorSetLayoutBinding layout_bindings[] = {ubo_binding, sampler_binding};
+  VkDescriptorSetLayoutBinding tint_binding = {};
+  tint_binding.binding = 2;
+  tint_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  tint_binding.descriptorCount = 1;
+  tint_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+  VkDescriptorSetLayoutBinding layout_bindings[] = {ubo_binding, sampler_binding, tint_binding};
 
   VkDescriptorSetLayoutCreateInfo layout_create_info = {};
   layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -45,8 +56,6 @@ bool ChunkRenderLayout::Create(VkDevice device) {
   pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipeline_layout_create_info.setLayoutCount = 1;
   pipeline_layout_create_info.pSetLayouts = &descriptor_layout;
-  pipeline_layout_create_info.pushConstantRangeCount = 0;
-  pipeline_layout_create_info.pPushConstantRanges = nullptr;
 
   if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
     fprintf(stderr, "Failed to create pipeline layout.\n");
@@ -142,39 +151,66 @@ void ChunkRenderer::CreatePipeline(MemoryArena& trans_arena, VkDevice device, Vk
   frag_shader_create_info.module = frag_shader;
   frag_shader_create_info.pName = "main";
 
+  // The layer is a specialization constant so the vertex shader can pick its tint palette out of the draw data.
+  u32 layer_index = 0;
+
+  VkSpecializationMapEntry layer_entry = {};
+  layer_entry.constantID = 0;
+  layer_entry.offset = 0;
+  layer_entry.size = sizeof(layer_index);
+
+  VkSpecializationInfo layer_specialization = {};
+  layer_specialization.mapEntryCount = 1;
+  layer_specialization.pMapEntries = &layer_entry;
+  layer_specialization.dataSize = sizeof(layer_index);
+  layer_specialization.pData = &layer_index;
+
+  vert_shader_create_info.pSpecializationInfo = &layer_specialization;
+
   VkPipelineShaderStageCreateInfo shader_stages[] = {vert_shader_create_info, frag_shader_create_info};
 
-  VkVertexInputBindingDescription binding_description = {};
+  VkVertexInputBindingDescription binding_descriptions[2] = {};
 
-  binding_description.binding = 0;
-  binding_description.stride = sizeof(ChunkVertex);
-  binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  binding_descriptions[0].binding = 0;
+  binding_descriptions[0].stride = sizeof(ChunkVertex);
+  binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-  VkVertexInputAttributeDescription attribute_descriptions[4];
+  binding_descriptions[1].binding = 1;
+  binding_descriptions[1].stride = sizeof(ChunkDrawData);
+  binding_descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  VkVertexInputAttributeDescription attribute_descriptions[5];
   attribute_descriptions[0].binding = 0;
   attribute_descriptions[0].location = 0;
-  attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attribute_descriptions[0].offset = offsetof(ChunkVertex, position);
+  attribute_descriptions[0].format = VK_FORMAT_R32_UINT;
+  attribute_descriptions[0].offset = offsetof(ChunkVertex, packed_position);
 
   attribute_descriptions[1].binding = 0;
   attribute_descriptions[1].location = 1;
   attribute_descriptions[1].format = VK_FORMAT_R32_UINT;
-  attribute_descriptions[1].offset = offsetof(ChunkVertex, texture_id);
+  attribute_descriptions[1].offset = offsetof(ChunkVertex, packed_light);
 
   attribute_descriptions[2].binding = 0;
   attribute_descriptions[2].location = 2;
   attribute_descriptions[2].format = VK_FORMAT_R32_UINT;
-  attribute_descriptions[2].offset = offsetof(ChunkVertex, packed_light);
+  attribute_descriptions[2].offset = offsetof(ChunkVertex, packed_texture);
 
-  attribute_descriptions[3].binding = 0;
+  attribute_descriptions[3].binding = 1;
   attribute_descriptions[3].location = 3;
-  attribute_descriptions[3].format = VK_FORMAT_R16_UINT;
-  attribute_descriptions[3].offset = offsetof(ChunkVertex, packed_uv);
+  attribute_descriptions[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  attribute_descriptions[3].offset = offsetof(ChunkDrawData, origin);
+
+  static_assert(kRenderLayerCount == 4, "Tint offsets are read as one uvec4.");
+
+  attribute_descriptions[4].binding = 1;
+  attribute_descriptions[4].location = 4;
+  attribute_descriptions[4].format = VK_FORMAT_R32G32B32A32_UINT;
+  attribute_descriptions[4].offset = offsetof(ChunkDrawData, tint_offsets);
 
   VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
   vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertex_input_info.vertexBindingDescriptionCount = 1;
-  vertex_input_info.pVertexBindingDescriptions = &binding_description;
+  vertex_input_info.vertexBindingDescriptionCount = polymer_array_count(binding_descriptions);
+  vertex_input_info.pVertexBindingDescriptions = binding_descriptions;
   vertex_input_info.vertexAttributeDescriptionCount = polymer_array_count(attribute_descriptions);
   vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions;
 
@@ -287,6 +323,8 @@ void ChunkRenderer::CreatePipeline(MemoryArena& trans_arena, VkDevice device, Vk
   pipeline_info.basePipelineIndex = -1;
 
   for (size_t i = 0; i < kRenderLayerCount - 1; ++i) {
+    layer_index = (u32)i;
+
     if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, pipelines + i) != VK_SUCCESS) {
       fprintf(stderr, "Failed to create graphics pipeline.\n");
     }
@@ -296,6 +334,8 @@ void ChunkRenderer::CreatePipeline(MemoryArena& trans_arena, VkDevice device, Vk
   blend_attachment.blendEnable = VK_TRUE;
 
   size_t alpha_index = (size_t)RenderLayer::Alpha;
+  layer_index = (u32)alpha_index;
+
   if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, pipelines + alpha_index) !=
       VK_SUCCESS) {
     fprintf(stderr, "Failed to create alpha pipeline.\n");
@@ -350,7 +390,7 @@ void ChunkRenderer::CreateDescriptors(VkDevice device, VkDescriptorPool descript
     block_image_info.imageView = block_textures->image_view;
     block_image_info.sampler = block_textures->sampler;
 
-    VkWriteDescriptorSet descriptor_writes[8] = {};
+    VkWriteDescriptorSet descriptor_writes[8 + kRenderLayerCount] = {};
     descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptor_writes[0].dstSet = descriptor_sets[(size_t)RenderLayer::Standard].descriptors[i];
     descriptor_writes[0].dstBinding = 0;
@@ -447,6 +487,26 @@ void ChunkRenderer::CreateDescriptors(VkDevice device, VkDescriptorPool descript
     descriptor_writes[7].pBufferInfo = nullptr;
     descriptor_writes[7].pTexelBufferView = nullptr;
 
+    VkDescriptorBufferInfo tint_buffer_info = {};
+
+    tint_buffer_info.buffer = renderer->mesh_heap.tint_buffer;
+    tint_buffer_info.offset = 0;
+    tint_buffer_info.range = VK_WHOLE_SIZE;
+
+    for (size_t j = 0; j < kRenderLayerCount; ++j) {
+      VkWriteDescriptorSet& write = descriptor_writes[8 + j];
+
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = descriptor_sets[j].descriptors[i];
+      write.dstBinding = 2;
+      write.dstArrayElement = 0;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      write.descriptorCount = 1;
+      write.pBufferInfo = &tint_buffer_info;
+      write.pImageInfo = nullptr;
+      write.pTexelBufferView = nullptr;
+    }
+
     vkUpdateDescriptorSets(device, polymer_array_count(descriptor_writes), descriptor_writes, 0, nullptr);
   }
 }
@@ -473,13 +533,96 @@ void ChunkRenderer::Draw(VkCommandBuffer command_buffer, size_t current_frame, w
 
   Frustum frustum = camera.GetViewFrustum();
 
-  VkDeviceSize offsets[] = {0};
-  VkDeviceSize offset = {};
+  // Every mesh lives in the renderer's mesh heap, so the buffers only need to be bound once per layer.
+  ChunkFrameDrawBuffers& draw_buffers = frame_draw_buffers[current_frame];
+  VkBuffer vertex_buffers[] = {renderer->mesh_heap.vertex_buffer, draw_buffers.draw_data_buffer};
+  VkBuffer index_buffer = renderer->mesh_heap.index_buffer;
+  VkDeviceSize offsets[] = {0, 0};
 
 #if DISPLAY_PERF_STATS
   stats.Reset();
 #endif
 
+  u32 draw_data_count = 0;
+  u32 draw_counts[kRenderLayerCount] = {};
+
+  // Indirect commands are written straight into this frame's mapped buffers.
+  VkDrawIndexedIndirectCommand* commands[kRenderLayerCount];
+
+  for (size_t i = 0; i < kRenderLayerCount; ++i) {
+    commands[i] = indirect_draw ? draw_buffers.indirect_commands[i] : direct_commands[i];
+  }
+
+  size_t max_draws = draw_buffers.draw_data ? kMaxSectionDraws : 0;
+
+  // Collect all of the visible layer meshes first. They are either issued as one indirect draw per layer or one direct
+  // draw each. The firstInstance of each draw selects the section origin.
+  for (size_t column_index = 0; column_index < world.column_count; ++column_index) {
+    world::ChunkColumn* column = world.columns[column_index];
+    world::ChunkSectionInfo* section_info = &column->info;
+
+    if (!section_info->loaded) {
+      continue;
+    }
+
+    world::ChunkMesh* meshes = column->meshes;
+
+    for (s32 chunk_y = 0; chunk_y < world::kChunkColumnCount; ++chunk_y) {
+      world::ChunkMesh* mesh = meshes + chunk_y;
+
+      if (!(section_info->bitmask & (1 << chunk_y))) continue;
+      if (draw_data_count >= max_draws) break;
+
+      Vector3f chunk_min(section_info->x * 16.0f, chunk_y * 16.0f - 64.0f, section_info->z * 16.0f);
+      Vector3f chunk_max(section_info->x * 16.0f + 16.0f, chunk_y * 16.0f - 48.0f, section_info->z * 16.0f + 16.0f);
+
+      if (!frustum.Intersects(chunk_min, chunk_max)) continue;
+
+      u32 draw_data_index = draw_data_count;
+      ChunkDrawData& draw_data = draw_buffers.draw_data[draw_data_index];
+      bool rendered = false;
+
+      for (s32 i = 0; i < render::kRenderLayerCount; ++i) {
+        render::RenderMesh* layer_mesh = &mesh->meshes[i];
+
+        if (layer_mesh->vertex_count == 0 || !commands[i]) continue;
+
+        VkDrawIndexedIndirectCommand* command = commands[i] + draw_counts[i]++;
+
+        command->indexCount = layer_mesh->index_count;
+        command->instanceCount = 1;
+        command->firstIndex = layer_mesh->index_offset;
+        command->vertexOffset = (s32)layer_mesh->vertex_offset;
+        command->firstInstance = draw_data_index;
+
+        draw_data.tint_offsets[i] = layer_mesh->tint_offset;
+
+        rendered = true;
+#if DISPLAY_PERF_STATS
+        stats.vertex_counts[i] += layer_mesh->vertex_count;
+#endif
+      }
+
+      if (rendered) {
+        // The origin is computed relative to the camera here so the vertices never need large world positions.
+        Vector4f& origin = draw_data.origin;
+
+        ++draw_data_count;
+
+        origin.x = (float)((double)section_info->x * 16.0 - camera.position.x);
+        origin.y = (float)((double)chunk_y * 16.0 - 64.0 - camera.position.y);
+        origin.z = (float)((double)section_info->z * 16.0 - camera.position.z);
+        origin.w = 0.0f;
+
+#if DISPLAY_PERF_STATS
+        ++stats.chunk_render_count;
+#endif
+      }
+    }
+  }
+
+  vmaFlushAllocation(renderer->allocator, draw_buffers.draw_data_allocation, 0, VK_WHOLE_SIZE);
+
   ChunkFrameCommandBuffers& buffers = frame_command_buffers[current_frame];
 
   VkCommandBufferInheritanceInfo inherit = {};
@@ -493,67 +636,122 @@ void ChunkRenderer::Draw(VkCommandBuffer command_buffer, size_t current_frame, w
   begin_info.pInheritanceInfo = &inherit;
 
   for (size_t i = 0; i < kRenderLayerCount; ++i) {
+    VkCommandBuffer current_buffer = buffers.command_buffers[i];
     VkDescriptorSet descriptor = descriptor_sets[i].descriptors[current_frame];
 
-    vkBeginCommandBuffer(buffers.command_buffers[i], &begin_info);
+    vkBeginCommandBuffer(current_buffer, &begin_info);
 
-    vkCmdBindPipeline(buffers.command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[i]);
-    vkCmdBindDescriptorSets(buffers.command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, this->layout.pipeline_layout,
-                            0, 1, &descriptor, 0, nullptr);
-  }
+    if (draw_counts[i] > 0) {
+      vkCmdBindPipeline(current_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[i]);
+      vkCmdBindDescriptorSets(current_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->layout.pipeline_layout, 0, 1,
+                              &descriptor, 0, nullptr);
+      vkCmdBindVertexBuffers(current_buffer, 0, polymer_array_count(vertex_buffers), vertex_buffers, offsets);
+      vkCmdBindIndexBuffer(current_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT16);
+
+      if (indirect_draw) {
+        vmaFlushAllocation(renderer->allocator, draw_buffers.indirect_allocations[i], 0,
+                           sizeof(VkDrawIndexedIndirectCommand) * draw_counts[i]);
 
-  for (s32 chunk_z = 0; chunk_z < (s32)world::kChunkCacheSize; ++chunk_z) {
-    for (s32 chunk_x = 0; chunk_x < (s32)world::kChunkCacheSize; ++chunk_x) {
-      world::ChunkSectionInfo* section_info = &world.chunk_infos[chunk_z][chunk_x];
+        // The draws are split up if there are more than the device can issue in one call.
+        u32 max_batch = renderer->max_draw_indirect_count > 0 ? renderer->max_draw_indirect_count : 1;
 
-      if (!section_info->loaded) {
-        continue;
+        for (u32 first = 0; first < draw_counts[i]; first += max_batch) {
+          u32 batch_count = draw_counts[i] - first < max_batch ? draw_counts[i] - first : max_batch;
+          VkDeviceSize batch_offset = sizeof(VkDrawIndexedIndirectCommand) * first;
+
+          vkCmdDrawIndexedIndirect(current_buffer, draw_buffers.indirect_buffers[i], batch_offset, batch_count,
+                                   sizeof(VkDrawIndexedIndirectCommand));
+        }
+      } else {
+        for (u32 j = 0; j < draw_counts[i]; ++j) {
+          VkDrawIndexedIndirectCommand* command = commands[i] + j;
+
+          vkCmdDrawIndexed(current_buffer, command->indexCount, command->instanceCount, command->firstIndex,
+                           command->vertexOffset, command->firstInstance);
+        }
       }
+    }
 
-      world::ChunkMesh* meshes = world.meshes[chunk_z][chunk_x];
+    vkEndCommandBuffer(current_buffer);
 
-      for (s32 chunk_y = 0; chunk_y < world::kChunkColumnCount; ++chunk_y) {
-        world::ChunkMesh* mesh = meshes + chunk_y;
+    vkCmdExecuteCommands(command_buffer, 1, buffers.command_buffers + i);
+  }
+}
 
-        if ((section_info->bitmask & (1 << chunk_y))) {
-          Vector3f chunk_min(section_info->x * 16.0f, chunk_y * 16.0f - 64.0f, section_info->z * 16.0f);
-          Vector3f chunk_max(section_info->x * 16.0f + 16.0f, chunk_y * 16.0f - 48.0f, section_info->z * 16.0f + 16.0f);
+void ChunkRenderer::CreateDrawBuffers() {
+  indirect_draw = renderer->supports_indirect_draw;
 
-          if (frustum.Intersects(chunk_min, chunk_max)) {
-#if DISPLAY_PERF_STATS
-            bool rendered = false;
-#endif
-            for (s32 i = 0; i < render::kRenderLayerCount; ++i) {
-              render::RenderMesh* layer_mesh = &mesh->meshes[i];
+  printf("Chunk draw mode: %s\n", indirect_draw ? "indirect" : "direct");
 
-              if (layer_mesh->vertex_count > 0) {
-                VkCommandBuffer current_buffer = buffers.command_buffers[i];
+  for (size_t i = 0; i < kRenderLayerCount; ++i) {
+    direct_commands[i] = nullptr;
 
-                vkCmdBindVertexBuffers(current_buffer, 0, 1, &layer_mesh->vertex_buffer, offsets);
-                vkCmdBindIndexBuffer(current_buffer, layer_mesh->index_buffer, offset, VK_INDEX_TYPE_UINT16);
-                vkCmdDrawIndexed(current_buffer, layer_mesh->index_count, 1, 0, 0, 0);
-#if DISPLAY_PERF_STATS
-                stats.vertex_counts[i] += layer_mesh->vertex_count;
-                rendered = true;
-#endif
-              }
-            }
+    if (indirect_draw) continue;
 
-#if DISPLAY_PERF_STATS
-            if (rendered) {
-              ++stats.chunk_render_count;
-            }
-#endif
-          }
-        }
+    direct_commands[i] = (VkDrawIndexedIndirectCommand*)g_Platform.Allocate(sizeof(VkDrawIndexedIndirectCommand) *
+                                                                            kMaxSectionDraws);
+
+    if (!direct_commands[i]) {
+      fprintf(stderr, "Failed to allocate chunk draw commands.\n");
+    }
+  }
+
+  VkBufferCreateInfo buffer_info = {};
+
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VmaAllocationCreateInfo alloc_create_info = {};
+
+  alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+  alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+  for (size_t i = 0; i < kMaxFramesInFlight; ++i) {
+    ChunkFrameDrawBuffers& draw_buffers = frame_draw_buffers[i];
+    VmaAllocationInfo alloc_info = {};
+
+    buffer_info.size = sizeof(ChunkDrawData) * kMaxSectionDraws;
+    buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+    if (vmaCreateBuffer(renderer->allocator, &buffer_info, &alloc_create_info, &draw_buffers.draw_data_buffer,
+                        &draw_buffers.draw_data_allocation, &alloc_info) != VK_SUCCESS) {
+      fprintf(stderr, "Failed to create chunk draw data buffer.\n");
+      alloc_info.pMappedData = nullptr;
+    }
+
+    draw_buffers.draw_data = (ChunkDrawData*)alloc_info.pMappedData;
+
+    buffer_info.size = sizeof(VkDrawIndexedIndirectCommand) * kMaxSectionDraws;
+    buffer_info.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+
+    for (size_t j = 0; j < kRenderLayerCount; ++j) {
+      if (vmaCreateBuffer(renderer->allocator, &buffer_info, &alloc_create_info, draw_buffers.indirect_buffers + j,
+                          draw_buffers.indirect_allocations + j, &alloc_info) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create chunk indirect buffer.\n");
+        alloc_info.pMappedData = nullptr;
       }
+
+      draw_buffers.indirect_commands[j] = (VkDrawIndexedIndirectCommand*)alloc_info.pMappedData;
     }
   }
+}
 
+void ChunkRenderer::DestroyDrawBuffers() {
   for (size_t i = 0; i < kRenderLayerCount; ++i) {
-    vkEndCommandBuffer(buffers.command_buffers[i]);
+    if (direct_commands[i]) {
+      g_Platform.Free((u8*)direct_commands[i]);
+      direct_commands[i] = nullptr;
+    }
+  }
 
-    vkCmdExecuteCommands(command_buffer, 1, buffers.command_buffers + i);
+  for (size_t i = 0; i < kMaxFramesInFlight; ++i) {
+    ChunkFrameDrawBuffers& draw_buffers = frame_draw_buffers[i];
+
+    vmaDestroyBuffer(renderer->allocator, draw_buffers.draw_data_buffer, draw_buffers.draw_data_allocation);
+
+    for (size_t j = 0; j < kRenderLayerCount; ++j) {
+      vmaDestroyBuffer(renderer->allocator, draw_buffers.indirect_buffers[j], draw_buffers.indirect_allocations[j]);
+    }
   }
 }
 
@@ -40,13 +40,38 @@ struct ChunkRenderUBO {
   u32 alpha_discard;
 };
 
-struct ChunkVertex {
-  Vector3f position;
+// Vertex positions are stored relative to the section origin in 1/32nds of a block. They are offset so models can
+// extend a bit outside of the section.
+constexpr float kChunkVertexPositionScale = 32.0f;
+constexpr float kChunkVertexPositionOffset = 8.0f;
 
-  u32 texture_id;
+struct ChunkVertex {
+  // 10 bits for each of x, y, and z.
+  u32 packed_position;
+  // Bits 0-13 are light and ambient occlusion, 14-15 are axis shading, 16-23 are the index into the mesh's tint palette
+  // and 24-31 are animation.
   u32 packed_light;
+  // Bits 0-13 are the texture id, then 9 bits each for u and v in 1/16ths of a texture so merged faces can tile.
+  u32 packed_texture;
+};
+
+static_assert(sizeof(ChunkVertex) == 12, "Chunk vertices are the bulk of the mesh heap, so they should stay small.");
+
+// Biome tints are blended while meshing and each layer mesh gets a palette of the RGBA8 colors that its vertices use.
+constexpr size_t kChunkTintPaletteSize = 256;
+
+// Size of the shared mesh heap that every chunk mesh is allocated from. That's 192MiB of vertices, 48MiB of indices and
+// 4MiB of tints.
+constexpr u32 kChunkHeapVertexCapacity = 16 * 1024 * 1024;
+constexpr u32 kChunkHeapIndexCapacity = 24 * 1024 * 1024;
+constexpr u32 kChunkHeapTintCapacity = 1024 * 1024;
 
-  u16 packed_uv;
+// Per-draw instance data. The draw's firstInstance selects which one is used.
+struct ChunkDrawData {
+  // Origin of the section being drawn relative to the camera.
+  Vector4f origin;
+  // Where each layer's tint palette starts in the mesh heap's tint buffer.
+  u32 tint_offsets[kRenderLayerCount];
 };
 
 struct ChunkRenderLayout {
@@ -78,6 +103,17 @@ struct ChunkFrameCommandBuffers {
   VkCommandBuffer command_buffers[kRenderLayerCount];
 };
 
+// Persistently mapped buffers that the visible sections are written into each frame.
+struct ChunkFrameDrawBuffers {
+  VkBuffer draw_data_buffer;
+  VmaAllocation draw_data_allocation;
+  ChunkDrawData* draw_data;
+
+  VkBuffer indirect_buffers[kRenderLayerCount];
+  VmaAllocation indirect_allocations[kRenderLayerCount];
+  VkDrawIndexedIndirectCommand* indirect_commands[kRenderLayerCount];
+};
+
 struct ChunkRenderer {
   VulkanRenderer* renderer;
   RenderPass* render_pass;
@@ -93,6 +129,14 @@ struct ChunkRenderer {
   VkSampler leaf_sampler;
 
   ChunkFrameCommandBuffers frame_command_buffers[kMaxFramesInFlight];
+  ChunkFrameDrawBuffers frame_draw_buffers[kMaxFramesInFlight];
+  // The direct path builds its commands here since it reads them back, which is slow from mapped memory. They are
+  // consumed while recording, so every frame shares them. Only allocated when indirect drawing isn't supported.
+  VkDrawIndexedIndirectCommand* direct_commands[kRenderLayerCount];
+
+  // Issues one vkCmdDrawIndexedIndirect per layer instead of one draw per section. Only enabled when the device
+  // supports multi-draw indirect with a non-zero firstInstance.
+  bool indirect_draw;
 
   TextureArray* block_textures;
 
@@ -106,12 +150,15 @@ struct ChunkRenderer {
   void CreateLayoutSet(VulkanRenderer& renderer, VkDevice device) {
     layout.Create(device);
     this->renderer = &renderer;
+
+    CreateDrawBuffers();
   }
 
   void OnSwapchainCreate(MemoryArena& trans_arena, Swapchain& swapchain, VkDescriptorPool descriptor_pool);
   void OnSwapchainDestroy(VkDevice device);
 
   void Shutdown(VkDevice device) {
+    DestroyDrawBuffers();
     layout.Shutdown(device);
   }
 
@@ -119,6 +166,8 @@ private:
   void CreateSamplers(VkDevice device);
   void CreatePipeline(MemoryArena& arena, VkDevice device, VkExtent2D swap_extent);
   void CreateDescriptors(VkDevice device, VkDescriptorPool descriptor_pool);
+  void CreateDrawBuffers();
+  void DestroyDrawBuffers();
 };
 
 } // namespace render
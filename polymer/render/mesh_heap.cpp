@@ -0,0 +1,208 @@
+#include <polymer/render/mesh_heap.h>
+
+#include <assert.h>
+#include <stdio.h>
+
+namespace polymer {
+namespace render {
+
+bool RangeAllocator::Initialize(MemoryArena& arena, u32 capacity, size_t max_ranges) {
+  Range* ranges = memory_arena_push_type_count(&arena, Range, max_ranges);
+
+  if (!ranges) {
+    fprintf(stderr, "Failed to allocate range allocator nodes.\n");
+    return false;
+  }
+
+  this->capacity = capacity;
+  this->used = 0;
+
+  unused_ranges = nullptr;
+
+  for (size_t i = 0; i < max_ranges; ++i) {
+    ranges[i].next = unused_ranges;
+    unused_ranges = ranges + i;
+  }
+
+  free_ranges = CreateRange(0, capacity, nullptr);
+
+  return true;
+}
+
+bool RangeAllocator::Allocate(u32 size, u32* offset) {
+  if (size == 0) return false;
+
+  Range* prev = nullptr;
+
+  for (Range* range = free_ranges; range; range = range->next) {
+    if (range->size >= size) {
+      *offset = range->offset;
+
+      range->offset += size;
+      range->size -= size;
+
+      if (range->size == 0) {
+        if (prev) {
+          prev->next = range->next;
+        } else {
+          free_ranges = range->next;
+        }
+
+        ReleaseRange(range);
+      }
+
+      used += size;
+      return true;
+    }
+
+    prev = range;
+  }
+
+  return false;
+}
+
+void RangeAllocator::Free(u32 offset, u32 size) {
+  if (size == 0) return;
+
+  assert(used >= size);
+  used -= size;
+
+  Range* prev = nullptr;
+  Range* next = free_ranges;
+
+  while (next && next->offset < offset) {
+    prev = next;
+    next = next->next;
+  }
+
+  bool merge_prev = prev && prev->offset + prev->size == offset;
+  bool merge_next = next && offset + size == next->offset;
+
+  if (merge_prev && merge_next) {
+    prev->size += size + next->size;
+    prev->next = next->next;
+    ReleaseRange(next);
+  } else if (merge_prev) {
+    prev->size += size;
+  } else if (merge_next) {
+    next->offset = offset;
+    next->size += size;
+  } else {
+    Range* range = CreateRange(offset, size, next);
+
+    if (!range) {
+      // The space is lost until the allocator is recreated, but nothing else breaks.
+      fprintf(stderr, "Ran out of range nodes while freeing.\n");
+      return;
+    }
+
+    if (prev) {
+      prev->next = range;
+    } else {
+      free_ranges = range;
+    }
+  }
+}
+
+RangeAllocator::Range* RangeAllocator::CreateRange(u32 offset, u32 size, Range* next) {
+  Range* range = unused_ranges;
+
+  if (!range) return nullptr;
+
+  unused_ranges = range->next;
+
+  range->offset = offset;
+  range->size = size;
+  range->next = next;
+
+  return range;
+}
+
+void RangeAllocator::ReleaseRange(Range* range) {
+  range->next = unused_ranges;
+  unused_ranges = range;
+}
+
+static bool CreateHeapBuffer(VmaAllocator allocator, size_t size, VkBufferUsageFlags usage, VkBuffer* buffer,
+                             VmaAllocation* allocation) {
+  VkBufferCreateInfo buffer_info = {};
+
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = size;
+  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VmaAllocationCreateInfo alloc_create_info = {};
+  alloc_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  alloc_create_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+  return vmaCreateBuffer(allocator, &buffer_info, &alloc_create_info, buffer, allocation, nullptr) == VK_SUCCESS;
+}
+
+bool MeshHeap::Create(MemoryArena& arena, VmaAllocator allocator, size_t vertex_stride, u32 vertex_capacity,
+                      u32 index_capacity, u32 tint_capacity, size_t max_meshes) {
+  this->allocator = allocator;
+  this->vertex_stride = vertex_stride;
+
+  // Every live mesh can split a free range, so one extra node is needed per mesh to always be able to free.
+  if (!vertex_ranges.Initialize(arena, vertex_capacity, max_meshes + 1)) {
+    return false;
+  }
+
+  if (!index_ranges.Initialize(arena, index_capacity, max_meshes + 1)) {
+    return false;
+  }
+
+  if (!tint_ranges.Initialize(arena, tint_capacity, max_meshes + 1)) {
+    return false;
+  }
+
+  if (!CreateHeapBuffer(allocator, vertex_stride * vertex_capacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertex_buffer,
+                        &vertex_allocation)) {
+    fprintf(stderr, "Failed to create mesh heap vertex buffer.\n");
+    vertex_buffer = VK_NULL_HANDLE;
+    return false;
+  }
+
+  if (!CreateHeapBuffer(allocator, sizeof(u16) * index_capacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &index_buffer,
+                        &index_allocation)) {
+    fprintf(stderr, "Failed to create mesh heap index buffer.\n");
+    vmaDestroyBuffer(allocator, vertex_buffer, vertex_allocation);
+    vertex_buffer = VK_NULL_HANDLE;
+    index_buffer = VK_NULL_HANDLE;
+    return false;
+  }
+
+  if (!CreateHeapBuffer(allocator, sizeof(u32) * tint_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &tint_buffer,
+                        &tint_allocation)) {
+    fprintf(stderr, "Failed to create mesh heap tint buffer.\n");
+    vmaDestroyBuffer(allocator, vertex_buffer, vertex_allocation);
+    vmaDestroyBuffer(allocator, index_buffer, index_allocation);
+    vertex_buffer = VK_NULL_HANDLE;
+    index_buffer = VK_NULL_HANDLE;
+    tint_buffer = VK_NULL_HANDLE;
+    return false;
+  }
+
+  return true;
+}
+
+void MeshHeap::Destroy() {
+  if (vertex_buffer != VK_NULL_HANDLE) {
+    vmaDestroyBuffer(allocator, vertex_buffer, vertex_allocation);
+    vertex_buffer = VK_NULL_HANDLE;
+  }
+
+  if (index_buffer != VK_NULL_HANDLE) {
+    vmaDestroyBuffer(allocator, index_buffer, index_allocation);
+    index_buffer = VK_NULL_HANDLE;
+  }
+
+  if (tint_buffer != VK_NULL_HANDLE) {
+    vmaDestroyBuffer(allocator, tint_buffer, tint_allocation);
+    tint_buffer = VK_NULL_HANDLE;
+  }
+}
+
+} // namespace render
+} // namespace polymer
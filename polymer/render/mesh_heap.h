@@ -0,0 +1,74 @@
+#ifndef POLYMER_RENDER_MESH_HEAP_H_
+#define POLYMER_RENDER_MESH_HEAP_H_
+
+#include <polymer/memory.h>
+#include <polymer/render/vulkan.h>
+#include <polymer/types.h>
+
+namespace polymer {
+namespace render {
+
+// Hands out ranges of a fixed size space. The free ranges are kept sorted by offset so they can be merged with their
+// neighbors when a range is given back.
+struct RangeAllocator {
+  struct Range {
+    u32 offset;
+    u32 size;
+
+    Range* next;
+  };
+
+  Range* free_ranges = nullptr;
+  // Range nodes that aren't currently tracking a free range.
+  Range* unused_ranges = nullptr;
+
+  u32 capacity = 0;
+  u32 used = 0;
+
+  // max_ranges should be at least the number of live allocations + 1 so a free can always be tracked.
+  bool Initialize(MemoryArena& arena, u32 capacity, size_t max_ranges);
+
+  // Finds the first free range that fits. Returns false if there's no space left.
+  bool Allocate(u32 size, u32* offset);
+  void Free(u32 offset, u32 size);
+
+private:
+  Range* CreateRange(u32 offset, u32 size, Range* next);
+  void ReleaseRange(Range* range);
+};
+
+// One large device-local vertex buffer and index buffer that all of the meshes are sub-allocated from.
+// Vertex ranges are measured in vertices and index ranges are measured in indices so they can be used directly as the
+// vertexOffset and firstIndex of a draw. Each mesh can also have a palette of RGBA8 tints in the tint buffer, which is
+// read as a storage buffer and measured in colors.
+struct MeshHeap {
+  VmaAllocator allocator = VK_NULL_HANDLE;
+
+  VkBuffer vertex_buffer = VK_NULL_HANDLE;
+  VmaAllocation vertex_allocation = VK_NULL_HANDLE;
+
+  VkBuffer index_buffer = VK_NULL_HANDLE;
+  VmaAllocation index_allocation = VK_NULL_HANDLE;
+
+  VkBuffer tint_buffer = VK_NULL_HANDLE;
+  VmaAllocation tint_allocation = VK_NULL_HANDLE;
+
+  size_t vertex_stride = 0;
+
+  RangeAllocator vertex_ranges;
+  RangeAllocator index_ranges;
+  RangeAllocator tint_ranges;
+
+  bool Create(MemoryArena& arena, VmaAllocator allocator, size_t vertex_stride, u32 vertex_capacity,
+              u32 index_capacity, u32 tint_capacity, size_t max_meshes);
+  void Destroy();
+
+  inline bool IsCreated() const {
+    return vertex_buffer != VK_NULL_HANDLE;
+  }
+};
+
+} // namespace render
+} // namespace polymer
+
+#endif
@@ -163,6 +163,10 @@ bool VulkanRenderer::Initialize(PolymerWindow window) {
     return false;
   }
 
+  if (!CreateUploadBatches()) {
+    return false;
+  }
+
   return true;
 }
 
@@ -284,8 +288,9 @@ TextureArray* VulkanRenderer::CreateTextureArray(size_t width, size_t height, si
   return new_texture;
 }
 
-void VulkanRenderer::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout,
-                                           VkImageLayout new_layout, u32 base_layer, u32 layer_count, u32 mips) {
+void VulkanRenderer::TransitionImageLayout(VkCommandBuffer command_buffer, VkImage image, VkFormat format,
+                                           VkImageLayout old_layout, VkImageLayout new_layout, u32 base_layer,
+                                           u32 layer_count, u32 mips) {
 
   VkImageMemoryBarrier barrier = {};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -322,11 +327,7 @@ void VulkanRenderer::TransitionImageLayout(VkImage image, VkFormat format, VkIma
     return;
   }
 
-  BeginOneShotCommandBuffer();
-
-  vkCmdPipelineBarrier(oneshot_command_buffer, source_stage, destination_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-  EndOneShotCommandBuffer();
+  vkCmdPipelineBarrier(command_buffer, source_stage, destination_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 }
 
 TextureArrayPushState VulkanRenderer::BeginTexturePush(TextureArray& texture) {
@@ -345,38 +346,80 @@ TextureArrayPushState VulkanRenderer::BeginTexturePush(TextureArray& texture) {
   // Calculate the size for one giant buffer to hold all of the texture data.
   size_t buffer_size = texture_data_size * texture.depth;
 
-  VkBufferCreateInfo buffer_info = {};
+  result.data = AllocateStaging(buffer_size, &result.buffer_offset);
 
-  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  buffer_info.size = buffer_size;
-  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (result.data) {
+    result.buffer = staging_ring.buffer;
+  } else {
+    VkBufferCreateInfo buffer_info = {};
 
-  VmaAllocationCreateInfo alloc_create_info = {};
-  alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-  alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = buffer_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-  if (vmaCreateBuffer(allocator, &buffer_info, &alloc_create_info, &result.buffer, &result.alloc, &result.alloc_info) !=
-      VK_SUCCESS) {
-    printf("Failed to create staging buffer for texture push.\n");
-    return result;
+    VmaAllocationCreateInfo alloc_create_info = {};
+    alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo alloc_info = {};
+
+    if (vmaCreateBuffer(allocator, &buffer_info, &alloc_create_info, &result.buffer, &result.alloc, &alloc_info) !=
+        VK_SUCCESS) {
+      printf("Failed to create staging buffer for texture push.\n");
+      return result;
+    }
+
+    result.buffer_offset = 0;
+    result.data = (u8*)alloc_info.pMappedData;
   }
 
   // Transition image to copy-destination optimal, then copy, then transition to shader-read optimal.
-  TransitionImageLayout(texture.image, texture.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        0, (u32)texture.depth, texture.mips);
-
-  BeginOneShotCommandBuffer();
+  TransitionImageLayout(BeginUploadBatch()->command_buffer, texture.image, texture.format, VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, (u32)texture.depth, texture.mips);
 
   return result;
 }
 
 void VulkanRenderer::CommitTexturePush(TextureArrayPushState& state) {
-  EndOneShotCommandBuffer();
-  vmaDestroyBuffer(allocator, state.buffer, state.alloc);
+  UploadBatch* batch = BeginUploadBatch();
 
-  TransitionImageLayout(state.texture.image, state.texture.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, (u32)state.texture.depth, state.texture.mips);
+  if (has_transfer_queue) {
+    if (batch->image_barrier_count >= kMaxUploadImageBarriers) {
+      SubmitUploads();
+      batch = BeginUploadBatch();
+    }
+
+    // The shader-read layout transition happens as part of the ownership transfer to the graphics queue.
+    VkImageMemoryBarrier* barrier = batch->image_barriers + batch->image_barrier_count++;
+
+    *barrier = {};
+    barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier->oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier->newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier->srcQueueFamilyIndex = transfer_family;
+    barrier->dstQueueFamilyIndex = graphics_family;
+    barrier->image = state.texture.image;
+    barrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier->subresourceRange.baseMipLevel = 0;
+    barrier->subresourceRange.levelCount = state.texture.mips;
+    barrier->subresourceRange.baseArrayLayer = 0;
+    barrier->subresourceRange.layerCount = (u32)state.texture.depth;
+  } else {
+    TransitionImageLayout(batch->command_buffer, state.texture.image, state.texture.format,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0,
+                          (u32)state.texture.depth, state.texture.mips);
+  }
+
+  if (state.alloc) {
+    // The separate staging buffer isn't tracked by the ring, so wait for the copy to finish before freeing it.
+    SubmitUploads();
+    WaitForUploads();
+
+    vmaDestroyBuffer(allocator, state.buffer, state.alloc);
+  } else if (state.data) {
+    staging_ring.Flush(state.buffer_offset, state.texture_data_size * state.texture.depth);
+  }
 }
 
 void VulkanRenderer::PushArrayTexture(MemoryArena& temp_arena, TextureArrayPushState& state, u8* texture, size_t index,
@@ -397,21 +440,22 @@ void VulkanRenderer::PushArrayTexture(MemoryArena& temp_arena, TextureArrayPushS
   memcpy(buffer_data, texture, dim * dim * channels);
 
   size_t destination = state.texture_data_size * index;
+  VkCommandBuffer command_buffer = BeginUploadBatch()->command_buffer;
 
   for (size_t i = 0; i < state.texture.mips; ++i) {
-    if (state.alloc_info.pMappedData) {
+    if (state.data) {
       size_t size = dim * dim * channels;
 
       if (i > 0) {
         BoxFilterMipmap(previous_data, buffer_data, size, dim, cfg.brighten_mipping);
       }
 
-      memcpy((u8*)state.alloc_info.pMappedData + destination, buffer_data, size);
+      memcpy(state.data + destination, buffer_data, size);
       memcpy(previous_data, buffer_data, size);
 
       VkBufferImageCopy region = {};
 
-      region.bufferOffset = destination;
+      region.bufferOffset = state.buffer_offset + destination;
       region.bufferRowLength = 0;
       region.bufferImageHeight = 0;
 
@@ -423,8 +467,8 @@ void VulkanRenderer::PushArrayTexture(MemoryArena& temp_arena, TextureArrayPushS
       region.imageOffset = {0, 0, 0};
       region.imageExtent = {dim, dim, 1};
 
-      vkCmdCopyBufferToImage(oneshot_command_buffer, state.buffer, state.texture.image,
-                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+      vkCmdCopyBufferToImage(command_buffer, state.buffer, state.texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             1, &region);
 
       destination += size;
     }
@@ -521,6 +565,9 @@ bool VulkanRenderer::BeginFrame() {
 
   vkWaitForFences(device, 1, frame_fences + current_frame, VK_TRUE, UINT64_MAX);
 
+  // Every mesh freed before this slot's last frame was submitted is no longer in use.
+  ReleasePendingMeshes(current_frame);
+
   if (render_paused || invalid_swapchain) {
     RecreateSwapchain();
     return false;
@@ -624,110 +671,420 @@ void VulkanRenderer::WaitForIdle() {
   vkQueueWaitIdle(graphics_queue);
 }
 
-bool VulkanRenderer::PushStagingBuffer(u8* data, size_t data_size, VkBuffer* buffer, VmaAllocation* allocation,
-                                       VkBufferUsageFlagBits usage_type) {
-  VkBufferCreateInfo buffer_info = {};
+bool VulkanRenderer::PushStagingBuffer(u8* data, size_t data_size, VkBuffer buffer, size_t buffer_offset) {
+  size_t staging_offset = 0;
+  u8* staging = AllocateStaging(data_size, &staging_offset);
 
-  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  buffer_info.size = data_size;
-  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (!staging) {
+    fprintf(stderr, "Upload of %zu bytes doesn't fit in the staging ring.\n", data_size);
+    return false;
+  }
 
-  VmaAllocationCreateInfo alloc_create_info = {};
-  alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-  alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  memcpy(staging, data, data_size);
+  staging_ring.Flush(staging_offset, data_size);
+
+  UploadBatch* batch = BeginUploadBatch();
+
+  if (batch->buffer_barrier_count >= kMaxUploadBufferBarriers) {
+    SubmitUploads();
+    batch = BeginUploadBatch();
+  }
+
+  VkBufferCopy copy = {};
+  copy.srcOffset = staging_offset;
+  copy.dstOffset = buffer_offset;
+  copy.size = data_size;
+
+  vkCmdCopyBuffer(batch->command_buffer, staging_ring.buffer, buffer, 1, &copy);
+
+  if (has_transfer_queue) {
+    // The access masks are filled in when the release and acquire barriers are recorded.
+    VkBufferMemoryBarrier* barrier = batch->buffer_barriers + batch->buffer_barrier_count++;
+
+    *barrier = {};
+    barrier->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier->srcQueueFamilyIndex = transfer_family;
+    barrier->dstQueueFamilyIndex = graphics_family;
+    barrier->buffer = buffer;
+    barrier->offset = buffer_offset;
+    barrier->size = data_size;
+  }
 
-  VkBuffer staging_buffer = VK_NULL_HANDLE;
-  VmaAllocation staging_alloc = VK_NULL_HANDLE;
-  VmaAllocationInfo staging_alloc_info = {};
+  return true;
+}
 
-  if (vmaCreateBuffer(allocator, &buffer_info, &alloc_create_info, &staging_buffer, &staging_alloc,
-                      &staging_alloc_info) != VK_SUCCESS) {
-    printf("Failed to create staging buffer.\n");
+bool VulkanRenderer::CreateUploadBatches() {
+  if (!staging_ring.Create(allocator, kStagingRingSize)) {
     return false;
   }
 
-  assert(staging_buffer_count < polymer_array_count(staging_buffers));
+  VkCommandBuffer command_buffers[kUploadBatchCount];
+  VkCommandBuffer acquire_command_buffers[kUploadBatchCount];
 
-  staging_buffers[staging_buffer_count] = staging_buffer;
-  staging_allocs[staging_buffer_count] = staging_alloc;
+  VkCommandBufferAllocateInfo alloc_info = {};
 
-  staging_buffer_count++;
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.commandPool = transfer_command_pool;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandBufferCount = kUploadBatchCount;
 
-  if (staging_alloc_info.pMappedData) {
-    memcpy(staging_alloc_info.pMappedData, data, (size_t)buffer_info.size);
+  if (vkAllocateCommandBuffers(device, &alloc_info, command_buffers) != VK_SUCCESS) {
+    fprintf(stderr, "Failed to allocate upload command buffers.\n");
+    return false;
   }
 
-  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage_type;
-  alloc_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-  alloc_create_info.flags = 0;
+  alloc_info.commandPool = command_pool;
 
-  if (vmaCreateBuffer(allocator, &buffer_info, &alloc_create_info, buffer, allocation, nullptr) != VK_SUCCESS) {
-    printf("Failed to create vertex buffer.\n");
+  if (vkAllocateCommandBuffers(device, &alloc_info, acquire_command_buffers) != VK_SUCCESS) {
+    fprintf(stderr, "Failed to allocate upload acquire command buffers.\n");
     return false;
   }
 
-  VkBufferCopy copy = {};
-  copy.srcOffset = 0;
-  copy.dstOffset = 0;
-  copy.size = buffer_info.size;
+  VkFenceCreateInfo fence_info = {};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  VkSemaphoreCreateInfo semaphore_info = {};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  for (size_t i = 0; i < kUploadBatchCount; ++i) {
+    UploadBatch* batch = upload_batches + i;
+
+    batch->command_buffer = command_buffers[i];
+    batch->acquire_command_buffer = acquire_command_buffers[i];
+    batch->staging_end = 0;
+    batch->buffer_barrier_count = 0;
+    batch->image_barrier_count = 0;
+    batch->recording = false;
+    batch->submitted = false;
+
+    batch->buffer_barriers = memory_arena_push_type_count(perm_arena, VkBufferMemoryBarrier, kMaxUploadBufferBarriers);
+
+    if (!batch->buffer_barriers) {
+      fprintf(stderr, "Failed to allocate upload barriers.\n");
+      return false;
+    }
+
+    if (vkCreateFence(device, &fence_info, nullptr, &batch->fence) != VK_SUCCESS) {
+      fprintf(stderr, "Failed to create upload fence.\n");
+      return false;
+    }
 
-  vkCmdCopyBuffer(oneshot_command_buffer, staging_buffer, *buffer, 1, &copy);
+    if (vkCreateSemaphore(device, &semaphore_info, nullptr, &batch->transfer_semaphore) != VK_SUCCESS) {
+      fprintf(stderr, "Failed to create upload semaphore.\n");
+      return false;
+    }
+  }
+
+  upload_batch_index = 0;
 
   return true;
 }
 
-RenderMesh VulkanRenderer::AllocateMesh(u8* vertex_data, size_t vertex_data_size, size_t vertex_count, u16* index_data,
-                                        size_t index_count) {
-  RenderMesh mesh = {};
+UploadBatch* VulkanRenderer::BeginUploadBatch() {
+  UploadBatch* batch = upload_batches + upload_batch_index;
+
+  if (batch->recording) return batch;
+
+  if (batch->submitted) {
+    vkWaitForFences(device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+    RetireUploads();
+  }
+
+  vkResetFences(device, 1, &batch->fence);
+
+  VkCommandBufferBeginInfo begin_info = {};
+
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(batch->command_buffer, &begin_info) != VK_SUCCESS) {
+    fprintf(stderr, "Failed to begin recording upload command buffer.\n");
+  }
 
-  if (vertex_count > 0) {
-    if (!PushStagingBuffer(vertex_data, vertex_data_size, &mesh.vertex_buffer, &mesh.vertex_allocation,
-                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)) {
-      return mesh;
+  batch->buffer_barrier_count = 0;
+  batch->image_barrier_count = 0;
+  batch->recording = true;
+
+  return batch;
+}
+
+// Mesh heap buffers are read as vertices and indices, and the tint palettes are read by the vertex shader.
+constexpr VkAccessFlags kMeshReadAccess =
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+constexpr VkPipelineStageFlags kMeshReadStages =
+    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+
+void VulkanRenderer::SubmitUploads() {
+  UploadBatch* batch = upload_batches + upload_batch_index;
+
+  if (!batch->recording) return;
+
+  if (has_transfer_queue) {
+    // Release everything that was written to the graphics family. The matching acquire is done on the graphics queue
+    // after waiting for the transfer to finish.
+    for (size_t i = 0; i < batch->buffer_barrier_count; ++i) {
+      batch->buffer_barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      batch->buffer_barriers[i].dstAccessMask = 0;
     }
+
+    for (size_t i = 0; i < batch->image_barrier_count; ++i) {
+      batch->image_barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      batch->image_barriers[i].dstAccessMask = 0;
+    }
+
+    vkCmdPipelineBarrier(batch->command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, (u32)batch->buffer_barrier_count, batch->buffer_barriers,
+                         (u32)batch->image_barrier_count, batch->image_barriers);
+  } else {
+    // Make the copies visible to everything that reads the buffers in later submits.
+    VkMemoryBarrier barrier = {};
+
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = kMeshReadAccess;
+
+    vkCmdPipelineBarrier(batch->command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, kMeshReadStages, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
   }
 
-  mesh.vertex_count = (u32)vertex_count;
+  if (vkEndCommandBuffer(batch->command_buffer) != VK_SUCCESS) {
+    fprintf(stderr, "Failed to record upload command buffer.\n");
+  }
+
+  VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &batch->command_buffer;
+
+  if (has_transfer_queue) {
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &batch->transfer_semaphore;
+
+    if (vkQueueSubmit(transfer_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+      fprintf(stderr, "Failed to submit upload command buffer.\n");
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(batch->acquire_command_buffer, &begin_info);
+
+    for (size_t i = 0; i < batch->buffer_barrier_count; ++i) {
+      batch->buffer_barriers[i].srcAccessMask = 0;
+      batch->buffer_barriers[i].dstAccessMask = kMeshReadAccess;
+    }
 
-  if (index_count > 0) {
-    if (!PushStagingBuffer((u8*)index_data, index_count * sizeof(*index_data), &mesh.index_buffer,
-                           &mesh.index_allocation, VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) {
-      return mesh;
+    for (size_t i = 0; i < batch->image_barrier_count; ++i) {
+      batch->image_barriers[i].srcAccessMask = 0;
+      batch->image_barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+
+    VkPipelineStageFlags acquire_stages = kMeshReadStages | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    vkCmdPipelineBarrier(batch->acquire_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, acquire_stages, 0, 0,
+                         nullptr, (u32)batch->buffer_barrier_count, batch->buffer_barriers,
+                         (u32)batch->image_barrier_count, batch->image_barriers);
+
+    vkEndCommandBuffer(batch->acquire_command_buffer);
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo acquire_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    acquire_info.waitSemaphoreCount = 1;
+    acquire_info.pWaitSemaphores = &batch->transfer_semaphore;
+    acquire_info.pWaitDstStageMask = &wait_stage;
+    acquire_info.commandBufferCount = 1;
+    acquire_info.pCommandBuffers = &batch->acquire_command_buffer;
+
+    // The fence is signaled by the acquire, which can't happen until the transfer is done.
+    if (vkQueueSubmit(graphics_queue, 1, &acquire_info, batch->fence) != VK_SUCCESS) {
+      fprintf(stderr, "Failed to submit upload acquire command buffer.\n");
+    }
+  } else {
+    if (vkQueueSubmit(graphics_queue, 1, &submit_info, batch->fence) != VK_SUCCESS) {
+      fprintf(stderr, "Failed to submit upload command buffer.\n");
     }
   }
 
-  mesh.index_count = (u32)index_count;
+  batch->staging_end = staging_ring.head;
+  batch->recording = false;
+  batch->submitted = true;
 
-  return mesh;
+  upload_batch_index = (upload_batch_index + 1) % kUploadBatchCount;
 }
 
-void VulkanRenderer::BeginMeshAllocation() {
-  BeginOneShotCommandBuffer();
+void VulkanRenderer::RetireUploads() {
+  // The batches are submitted in order, so start at the oldest and stop at the first one that isn't done.
+  for (size_t i = 0; i < kUploadBatchCount; ++i) {
+    UploadBatch* batch = upload_batches + (upload_batch_index + i) % kUploadBatchCount;
+
+    if (!batch->submitted) continue;
+    if (vkGetFenceStatus(device, batch->fence) != VK_SUCCESS) break;
+
+    staging_ring.Retire(batch->staging_end);
+    batch->submitted = false;
+  }
 }
 
-void VulkanRenderer::EndMeshAllocation() {
-  EndOneShotCommandBuffer();
+void VulkanRenderer::WaitForUploads() {
+  for (size_t i = 0; i < kUploadBatchCount; ++i) {
+    UploadBatch* batch = upload_batches + i;
 
-  for (size_t i = 0; i < staging_buffer_count; ++i) {
-    vmaDestroyBuffer(allocator, staging_buffers[i], staging_allocs[i]);
+    if (batch->submitted) {
+      vkWaitForFences(device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+    }
   }
 
-  staging_buffer_count = 0;
+  RetireUploads();
+}
+
+u8* VulkanRenderer::AllocateStaging(size_t size, size_t* offset) {
+  // Aligned enough for buffer to image copies of any of the texture formats.
+  constexpr size_t kStagingAlignment = 16;
+
+  if (staging_ring.Allocate(size, kStagingAlignment, offset)) {
+    return staging_ring.mapped + *offset;
+  }
+
+  RetireUploads();
+
+  if (staging_ring.Allocate(size, kStagingAlignment, offset)) {
+    return staging_ring.mapped + *offset;
+  }
+
+  // The ring is full of uploads that are still in flight, so push out the current batch and wait for all of them.
+  SubmitUploads();
+  WaitForUploads();
+
+  if (staging_ring.Allocate(size, kStagingAlignment, offset)) {
+    return staging_ring.mapped + *offset;
+  }
+
+  return nullptr;
+}
+
+bool VulkanRenderer::CreateMeshHeap(size_t vertex_stride, u32 vertex_capacity, u32 index_capacity, u32 tint_capacity,
+                                    size_t max_meshes) {
+  for (size_t i = 0; i < kMaxFramesInFlight; ++i) {
+    pending_mesh_frees[i] = memory_arena_push_type_count(perm_arena, RenderMesh, max_meshes);
+    pending_mesh_free_counts[i] = 0;
+
+    if (!pending_mesh_frees[i]) {
+      fprintf(stderr, "Failed to allocate pending mesh free list.\n");
+      return false;
+    }
+  }
+
+  pending_mesh_free_capacity = max_meshes;
+
+  return mesh_heap.Create(*perm_arena, allocator, vertex_stride, vertex_capacity, index_capacity, tint_capacity,
+                          max_meshes);
+}
+
+RenderMesh VulkanRenderer::AllocateMesh(u8* vertex_data, size_t vertex_data_size, size_t vertex_count, u16* index_data,
+                                        size_t index_count, u32* tint_data, size_t tint_count) {
+  RenderMesh mesh = {};
+
+  if (vertex_count == 0 || index_count == 0) return mesh;
+
+  assert(mesh_heap.IsCreated());
+  assert(vertex_data_size == vertex_count * mesh_heap.vertex_stride);
+
+  u32 vertex_offset = 0;
+  u32 index_offset = 0;
+  u32 tint_offset = 0;
+
+  if (!mesh_heap.vertex_ranges.Allocate((u32)vertex_count, &vertex_offset)) {
+    fprintf(stderr, "Mesh heap is out of vertex space.\n");
+    return mesh;
+  }
+
+  if (!mesh_heap.index_ranges.Allocate((u32)index_count, &index_offset)) {
+    fprintf(stderr, "Mesh heap is out of index space.\n");
+    mesh_heap.vertex_ranges.Free(vertex_offset, (u32)vertex_count);
+    return mesh;
+  }
+
+  if (tint_count > 0 && !mesh_heap.tint_ranges.Allocate((u32)tint_count, &tint_offset)) {
+    fprintf(stderr, "Mesh heap is out of tint space.\n");
+    mesh_heap.vertex_ranges.Free(vertex_offset, (u32)vertex_count);
+    mesh_heap.index_ranges.Free(index_offset, (u32)index_count);
+    return mesh;
+  }
+
+  size_t vertex_buffer_offset = vertex_offset * mesh_heap.vertex_stride;
+  size_t index_buffer_offset = index_offset * sizeof(*index_data);
+  size_t tint_buffer_offset = tint_offset * sizeof(u32);
+
+  if (!PushStagingBuffer(vertex_data, vertex_data_size, mesh_heap.vertex_buffer, vertex_buffer_offset) ||
+      !PushStagingBuffer((u8*)index_data, index_count * sizeof(*index_data), mesh_heap.index_buffer,
+                         index_buffer_offset) ||
+      (tint_count > 0 &&
+       !PushStagingBuffer((u8*)tint_data, tint_count * sizeof(u32), mesh_heap.tint_buffer, tint_buffer_offset))) {
+    mesh_heap.vertex_ranges.Free(vertex_offset, (u32)vertex_count);
+    mesh_heap.index_ranges.Free(index_offset, (u32)index_count);
+
+    if (tint_count > 0) {
+      mesh_heap.tint_ranges.Free(tint_offset, (u32)tint_count);
+    }
+
+    return mesh;
+  }
+
+  mesh.vertex_offset = vertex_offset;
+  mesh.vertex_count = (u32)vertex_count;
+  mesh.index_offset = index_offset;
+  mesh.index_count = (u32)index_count;
+  mesh.tint_offset = tint_offset;
+  mesh.tint_count = (u32)tint_count;
+
+  return mesh;
 }
 
 void VulkanRenderer::FreeMesh(RenderMesh* mesh) {
-  if (mesh->vertex_count > 0) {
-    vmaDestroyBuffer(allocator, mesh->vertex_buffer, mesh->vertex_allocation);
+  if (mesh->vertex_count == 0 && mesh->index_count == 0) return;
+
+  // The frame being built hasn't drawn this mesh yet, so only the last submitted frame could still be reading it.
+  // That frame's slot is waited on in BeginFrame before it gets reused, which is when these are released.
+  size_t frame = (current_frame + kMaxFramesInFlight - 1) % kMaxFramesInFlight;
+
+  if (pending_mesh_free_counts[frame] >= pending_mesh_free_capacity) {
+    // This can only fill up when frames aren't being submitted, so there's nothing to stall.
+    vkQueueWaitIdle(graphics_queue);
+
+    for (size_t i = 0; i < kMaxFramesInFlight; ++i) {
+      ReleasePendingMeshes(i);
+    }
   }
 
-  if (mesh->index_count > 0) {
-    vmaDestroyBuffer(allocator, mesh->index_buffer, mesh->index_allocation);
+  pending_mesh_frees[frame][pending_mesh_free_counts[frame]++] = *mesh;
+
+  *mesh = {};
+}
+
+void VulkanRenderer::ReleasePendingMeshes(size_t frame) {
+  for (size_t i = 0; i < pending_mesh_free_counts[frame]; ++i) {
+    RenderMesh* mesh = pending_mesh_frees[frame] + i;
+
+    if (mesh->vertex_count > 0) {
+      mesh_heap.vertex_ranges.Free(mesh->vertex_offset, mesh->vertex_count);
+    }
+
+    if (mesh->index_count > 0) {
+      mesh_heap.index_ranges.Free(mesh->index_offset, mesh->index_count);
+    }
+
+    if (mesh->tint_count > 0) {
+      mesh_heap.tint_ranges.Free(mesh->tint_offset, mesh->tint_count);
+    }
   }
+
+  pending_mesh_free_counts[frame] = 0;
 }
 
 void VulkanRenderer::CreateDescriptorPool() {
-  VkDescriptorPoolSize pool_sizes[2] = {};
+  VkDescriptorPoolSize pool_sizes[3] = {};
 
   pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
   pool_sizes[0].descriptorCount = 64;
@@ -735,6 +1092,9 @@ void VulkanRenderer::CreateDescriptorPool() {
   pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
   pool_sizes[1].descriptorCount = 64;
 
+  pool_sizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  pool_sizes[2].descriptorCount = 64;
+
   VkDescriptorPoolCreateInfo pool_info = {};
 
   pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -825,6 +1185,16 @@ void VulkanRenderer::CreateCommandPool() {
   if (vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS) {
     fprintf(stderr, "Failed to create command pool.\n");
   }
+
+  transfer_command_pool = command_pool;
+
+  if (has_transfer_queue) {
+    pool_info.queueFamilyIndex = transfer_family;
+
+    if (vkCreateCommandPool(device, &pool_info, nullptr, &transfer_command_pool) != VK_SUCCESS) {
+      fprintf(stderr, "Failed to create transfer command pool.\n");
+    }
+  }
 }
 
 u32 VulkanRenderer::AddUniqueQueue(VkDeviceQueueCreateInfo* infos, u32 count, u32 queue_index) {
@@ -856,13 +1226,30 @@ void VulkanRenderer::CreateLogicalDevice() {
   create_count = AddUniqueQueue(queue_create_infos, create_count, indices.graphics);
   create_count = AddUniqueQueue(queue_create_infos, create_count, indices.present);
 
+  if (indices.has_transfer) {
+    create_count = AddUniqueQueue(queue_create_infos, create_count, indices.transfer);
+  }
+
   for (u32 i = 0; i < create_count; ++i) {
     queue_create_infos[i].pQueuePriorities = &priority;
   }
 
+  VkPhysicalDeviceFeatures supported_features = {};
+  vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+
   VkPhysicalDeviceFeatures features = {};
 
   features.samplerAnisotropy = VK_TRUE;
+  // These are optional. The chunk renderer falls back to direct draws without them.
+  features.multiDrawIndirect = supported_features.multiDrawIndirect;
+  features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+
+  supports_indirect_draw = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+  max_draw_indirect_count = properties.limits.maxDrawIndirectCount;
 
   VkDeviceCreateInfo create_info{};
   create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -882,6 +1269,19 @@ void VulkanRenderer::CreateLogicalDevice() {
 
   vkGetDeviceQueue(device, indices.graphics, 0, &graphics_queue);
   vkGetDeviceQueue(device, indices.present, 0, &present_queue);
+
+  graphics_family = indices.graphics;
+  has_transfer_queue = indices.has_transfer && indices.transfer != indices.graphics;
+
+  if (has_transfer_queue) {
+    transfer_family = indices.transfer;
+    vkGetDeviceQueue(device, indices.transfer, 0, &transfer_queue);
+  } else {
+    transfer_family = indices.graphics;
+    transfer_queue = graphics_queue;
+  }
+
+  printf("Upload queue: %s\n", has_transfer_queue ? "dedicated transfer" : "graphics");
 }
 
 QueueFamilyIndices VulkanRenderer::FindQueueFamilies(VkPhysicalDevice device) {
@@ -915,6 +1315,16 @@ QueueFamilyIndices VulkanRenderer::FindQueueFamilies(VkPhysicalDevice device) {
     }
   }
 
+  for (u32 i = 0; i < count; ++i) {
+    VkQueueFlags flags = properties[i].queueFlags;
+
+    if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT)) {
+      indices.has_transfer = true;
+      indices.transfer = i;
+      break;
+    }
+  }
+
   return indices;
 }
 
@@ -1113,8 +1523,20 @@ void VulkanRenderer::Shutdown() {
 
   vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
 
+  mesh_heap.Destroy();
+  staging_ring.Destroy();
+
+  for (size_t i = 0; i < kUploadBatchCount; ++i) {
+    vkDestroyFence(device, upload_batches[i].fence, nullptr);
+    vkDestroySemaphore(device, upload_batches[i].transfer_semaphore, nullptr);
+  }
+
   vmaDestroyAllocator(allocator);
 
+  if (transfer_command_pool != command_pool) {
+    vkDestroyCommandPool(device, transfer_command_pool, nullptr);
+  }
+
   vkDestroyCommandPool(device, command_pool, nullptr);
 
   vkDestroySurfaceKHR(instance, surface, nullptr);
@@ -1,7 +1,9 @@
 #ifndef POLYMER_RENDER_RENDER_H_
 #define POLYMER_RENDER_RENDER_H_
 
+#include <polymer/render/mesh_heap.h>
 #include <polymer/render/render_pass.h>
+#include <polymer/render/staging_ring.h>
 #include <polymer/render/swapchain.h>
 #include <polymer/render/texture.h>
 #include <polymer/render/util.h>
@@ -23,21 +25,58 @@ struct QueueFamilyIndices {
   u32 present;
   bool has_present;
 
+  // Family with transfer support but no graphics support. These usually map to dedicated copy engines.
+  u32 transfer;
+  bool has_transfer;
+
   bool IsComplete() {
     return has_graphics && has_present;
   }
 };
 
+// A range of the renderer's mesh heap. The offsets are in vertices and indices so they can be passed straight to the
+// draw call.
 struct RenderMesh {
-  VkBuffer vertex_buffer;
-  VmaAllocation vertex_allocation;
+  u32 vertex_offset;
   u32 vertex_count;
 
-  VkBuffer index_buffer;
-  VmaAllocation index_allocation;
+  u32 index_offset;
   u32 index_count;
+
+  // The mesh's tint palette, which its vertices index into. The offset is in colors.
+  u32 tint_offset;
+  u32 tint_count;
 };
 
+// Upload commands are recorded into a batch that is submitted once per frame. The fence tells when the staging ring
+// space it used can be reused.
+constexpr size_t kMaxUploadBufferBarriers = 4096;
+constexpr size_t kMaxUploadImageBarriers = 16;
+
+struct UploadBatch {
+  // Recorded for the transfer queue, which is the graphics queue if there's no dedicated transfer family.
+  VkCommandBuffer command_buffer;
+  // Graphics queue command buffer that acquires ownership of everything the transfer queue wrote.
+  VkCommandBuffer acquire_command_buffer;
+  VkSemaphore transfer_semaphore;
+  VkFence fence;
+
+  // Head of the staging ring when this batch was submitted.
+  u64 staging_end;
+
+  // Regions that were written by the transfer queue and need to be handed over to the graphics queue.
+  VkBufferMemoryBarrier* buffer_barriers;
+  size_t buffer_barrier_count;
+  VkImageMemoryBarrier image_barriers[kMaxUploadImageBarriers];
+  size_t image_barrier_count;
+
+  bool recording;
+  bool submitted;
+};
+
+constexpr size_t kUploadBatchCount = kMaxFramesInFlight + 1;
+constexpr size_t kStagingRingSize = Megabytes(32);
+
 struct UniformBuffer {
   VmaAllocator allocator;
 
@@ -81,6 +120,11 @@ struct VulkanRenderer {
 
   VkQueue graphics_queue;
   VkQueue present_queue;
+  // This is the graphics queue when the device doesn't have a dedicated transfer family.
+  VkQueue transfer_queue;
+
+  u32 graphics_family;
+  u32 transfer_family;
 
   VmaAllocator allocator;
 
@@ -88,26 +132,41 @@ struct VulkanRenderer {
   VkDescriptorPool descriptor_pool;
   // TODO: This should be pulled out to be managed per-thread
   VkCommandPool command_pool;
+  // Pool for the transfer family. Same as command_pool when there's no dedicated transfer family.
+  VkCommandPool transfer_command_pool;
 
   VkSemaphore render_complete_semaphores[kMaxFramesInFlight];
   VkSemaphore image_available_semaphores[kMaxFramesInFlight];
   VkFence frame_fences[kMaxFramesInFlight];
 
   TextureArrayManager texture_array_manager;
+  MeshHeap mesh_heap;
 
   size_t current_frame = 0;
   u32 current_image = 0;
   bool render_paused;
   bool invalid_swapchain;
+  // Set when the device supports multiDrawIndirect and drawIndirectFirstInstance.
+  bool supports_indirect_draw = false;
+  // Largest drawCount that a single indirect draw can be issued with.
+  u32 max_draw_indirect_count = 1;
+  // Set when uploads run on a separate queue family and need ownership transferred to the graphics family.
+  bool has_transfer_queue = false;
 
   // TODO: Pull this out into a freelist so multiple oneshots can be built up at once.
   // TODO: This should be pulled out to be managed per-thread
   VkCommandBuffer oneshot_command_buffer;
 
-  // A list of staging buffers that need to be freed after pushing the oneshot allocation command buffer.
-  VkBuffer staging_buffers[2048];
-  VmaAllocation staging_allocs[2048];
-  size_t staging_buffer_count = 0;
+  // Meshes that were freed while a frame that might draw them was still in flight. They are released once the frame
+  // fence for that slot is signaled.
+  RenderMesh* pending_mesh_frees[kMaxFramesInFlight] = {};
+  size_t pending_mesh_free_counts[kMaxFramesInFlight] = {};
+  size_t pending_mesh_free_capacity = 0;
+
+  StagingRing staging_ring;
+  UploadBatch upload_batches[kUploadBatchCount];
+  // The batch that is currently being recorded or will be recorded next.
+  size_t upload_batch_index = 0;
 
   bool Initialize(PolymerWindow window);
   void RecreateSwapchain();
@@ -116,9 +175,14 @@ struct VulkanRenderer {
   void Render();
   void Shutdown();
 
-  // Uses staging buffer to push data to the gpu and returns the allocation buffers.
+  // Creates the shared buffers that every mesh is sub-allocated from. Must be called before AllocateMesh.
+  bool CreateMeshHeap(size_t vertex_stride, u32 vertex_capacity, u32 index_capacity, u32 tint_capacity,
+                      size_t max_meshes);
+
+  // Uses staging buffer to push data to the gpu and returns the ranges in the mesh heap.
   RenderMesh AllocateMesh(u8* vertex_data, size_t vertex_data_size, size_t vertex_count, u16* index_data,
-                          size_t index_count);
+                          size_t index_count, u32* tint_data = nullptr, size_t tint_count = 0);
+  // The mesh's heap ranges are only reused after every frame that was submitted before this call is done.
   void FreeMesh(RenderMesh* mesh);
 
   TextureArrayPushState BeginTexturePush(TextureArray& texture);
@@ -130,8 +194,11 @@ struct VulkanRenderer {
                         const TextureConfig& cfg);
   void FreeTextureArray(TextureArray& texture);
 
-  void BeginMeshAllocation();
-  void EndMeshAllocation();
+  // Submits any uploads that were recorded since the last call. This should happen before the frame is submitted so
+  // the frame can use them.
+  void SubmitUploads();
+  // Blocks until every submitted upload is done.
+  void WaitForUploads();
 
   void WaitForIdle();
 
@@ -140,14 +207,23 @@ struct VulkanRenderer {
   }
 
 private:
-  bool PushStagingBuffer(u8* data, size_t data_size, VkBuffer* buffer, VmaAllocation* allocation,
-                         VkBufferUsageFlagBits usage_type);
+  bool PushStagingBuffer(u8* data, size_t data_size, VkBuffer buffer, size_t buffer_offset);
+
+  void ReleasePendingMeshes(size_t frame);
+
+  bool CreateUploadBatches();
+  // Returns the batch that is currently recording, beginning a new one if needed.
+  UploadBatch* BeginUploadBatch();
+  // Reclaims the staging space of every batch that the gpu has finished.
+  void RetireUploads();
+  // Returns mapped staging memory or null if the size is larger than the whole ring.
+  u8* AllocateStaging(size_t size, size_t* offset);
 
   u32 FindMemoryType(u32 type_filter, VkMemoryPropertyFlags properties);
 
   void GenerateArrayMipmaps(TextureArray& texture, u32 index);
-  void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout,
-                             u32 base_layer, u32 layer_count, u32 mips);
+  void TransitionImageLayout(VkCommandBuffer command_buffer, VkImage image, VkFormat format, VkImageLayout old_layout,
+                             VkImageLayout new_layout, u32 base_layer, u32 layer_count, u32 mips);
   void BeginOneShotCommandBuffer();
   void EndOneShotCommandBuffer();
 
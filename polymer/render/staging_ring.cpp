@@ -0,0 +1,73 @@
+#include <polymer/render/staging_ring.h>
+
+#include <stdio.h>
+
+namespace polymer {
+namespace render {
+
+bool StagingRing::Create(VmaAllocator allocator, size_t size) {
+  this->allocator = allocator;
+  this->size = size;
+
+  head = tail = 0;
+
+  VkBufferCreateInfo buffer_info = {};
+
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = size;
+  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VmaAllocationCreateInfo alloc_create_info = {};
+  alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+  alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+  VmaAllocationInfo alloc_info = {};
+
+  if (vmaCreateBuffer(allocator, &buffer_info, &alloc_create_info, &buffer, &allocation, &alloc_info) != VK_SUCCESS) {
+    fprintf(stderr, "Failed to create staging ring buffer.\n");
+    buffer = VK_NULL_HANDLE;
+    return false;
+  }
+
+  mapped = (u8*)alloc_info.pMappedData;
+
+  return mapped != nullptr;
+}
+
+void StagingRing::Destroy() {
+  if (buffer != VK_NULL_HANDLE) {
+    vmaDestroyBuffer(allocator, buffer, allocation);
+    buffer = VK_NULL_HANDLE;
+    mapped = nullptr;
+  }
+}
+
+bool StagingRing::Allocate(size_t data_size, size_t alignment, size_t* offset) {
+  if (data_size > size) return false;
+
+  u64 start = (head + alignment - 1) & ~((u64)alignment - 1);
+  size_t physical = (size_t)(start % size);
+
+  // Allocations can't wrap around the end of the buffer, so skip to the start if it doesn't fit.
+  if (physical + data_size > size) {
+    start += size - physical;
+    physical = 0;
+  }
+
+  if (start + data_size - tail > size) {
+    return false;
+  }
+
+  head = start + data_size;
+  *offset = physical;
+
+  return true;
+}
+
+void StagingRing::Flush(size_t offset, size_t data_size) {
+  vmaFlushAllocation(allocator, allocation, offset, data_size);
+}
+
+} // namespace render
+} // namespace polymer
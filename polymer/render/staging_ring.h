@@ -0,0 +1,44 @@
+#ifndef POLYMER_RENDER_STAGING_RING_H_
+#define POLYMER_RENDER_STAGING_RING_H_
+
+#include <polymer/render/vulkan.h>
+#include <polymer/types.h>
+
+namespace polymer {
+namespace render {
+
+// Persistently mapped upload buffer that is used as a ring. Space is handed out at the head and given back at the
+// tail once the gpu is done reading it, which is tracked by the fences of the submits that used it.
+// Positions are stored as ever-increasing offsets so a full ring can be told apart from an empty one.
+struct StagingRing {
+  VmaAllocator allocator = VK_NULL_HANDLE;
+
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  u8* mapped = nullptr;
+
+  size_t size = 0;
+  u64 head = 0;
+  u64 tail = 0;
+
+  bool Create(VmaAllocator allocator, size_t size);
+  void Destroy();
+
+  // Returns false if there isn't enough free space until older uploads are retired.
+  bool Allocate(size_t data_size, size_t alignment, size_t* offset);
+
+  // Everything allocated before the given head position is no longer in use by the gpu.
+  inline void Retire(u64 position) {
+    if (position > tail) {
+      tail = position;
+    }
+  }
+
+  // Makes the writes visible to the gpu if the memory isn't coherent.
+  void Flush(size_t offset, size_t data_size);
+};
+
+} // namespace render
+} // namespace polymer
+
+#endif
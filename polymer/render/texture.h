@@ -41,16 +41,20 @@ struct TextureArrayPushState {
 
   TextureArray& texture;
 
+  // The staging space is normally part of the renderer's staging ring. A separate buffer is only allocated when the
+  // texture data is too big to fit in the ring.
   VkBuffer buffer;
   VmaAllocation alloc;
-  VmaAllocationInfo alloc_info;
+  size_t buffer_offset;
+  u8* data;
   Status status;
 
   // Size of one texture with its mips.
   size_t texture_data_size;
 
   TextureArrayPushState(TextureArray& texture)
-      : texture(texture), buffer(), alloc(), alloc_info(), status(Status::Initial), texture_data_size(0) {}
+      : texture(texture), buffer(), alloc(), buffer_offset(0), data(nullptr), status(Status::Initial),
+        texture_data_size(0) {}
 };
 
 struct TextureArrayManager {
@@ -0,0 +1,218 @@
+#include <polymer/session.h>
+
+#include <curl/curl.h>
+#include <tomcrypt.h>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace polymer {
+
+constexpr const char* kSessionJoinUrl = "https://sessionserver.mojang.com/session/minecraft/join";
+constexpr size_t kSha1Size = 20;
+// In seconds. The server gives up on the login after 30 seconds, so there's no point in waiting longer than that.
+constexpr long kSessionConnectTimeout = 10;
+constexpr long kSessionTimeout = 20;
+
+static int RegisterCrypto() {
+  static int prng_index = -1;
+
+  if (prng_index < 0) {
+    ltc_mp = ltm_desc;
+
+    register_prng(&sprng_desc);
+    prng_index = find_prng("sprng");
+  }
+
+  return prng_index;
+}
+
+bool GenerateSharedSecret(u8* secret, size_t size) {
+  return rng_get_bytes(secret, (unsigned long)size, nullptr) == size;
+}
+
+bool EncryptWithPublicKey(const u8* public_key, size_t public_key_size, const u8* data, size_t size, u8* out,
+                          size_t* out_size) {
+  int prng_index = RegisterCrypto();
+
+  if (prng_index < 0) {
+    fprintf(stderr, "Failed to find random number generator.\n");
+    return false;
+  }
+
+  rsa_key key;
+
+  if (rsa_import(public_key, (unsigned long)public_key_size, &key) != CRYPT_OK) {
+    fprintf(stderr, "Failed to import server public key.\n");
+    return false;
+  }
+
+  unsigned long encrypted_size = (unsigned long)*out_size;
+  int result = rsa_encrypt_key_ex(data, (unsigned long)size, out, &encrypted_size, nullptr, 0, nullptr, prng_index, 0,
+                                  LTC_PKCS_1_V1_5, &key);
+
+  rsa_free(&key);
+
+  if (result != CRYPT_OK) {
+    fprintf(stderr, "Failed to encrypt with server public key: %s\n", error_to_string(result));
+    return false;
+  }
+
+  *out_size = encrypted_size;
+
+  return true;
+}
+
+void ComputeServerHash(const String& server_id, const u8* secret, size_t secret_size, const u8* public_key,
+                       size_t public_key_size, char* out) {
+  hash_state state;
+  u8 digest[kSha1Size];
+
+  sha1_init(&state);
+  sha1_process(&state, (const unsigned char*)server_id.data, (unsigned long)server_id.size);
+  sha1_process(&state, secret, (unsigned long)secret_size);
+  sha1_process(&state, public_key, (unsigned long)public_key_size);
+  sha1_done(&state, digest);
+
+  // The digest is printed as a signed big-endian number, so negative values are negated and get a minus sign.
+  bool negative = (digest[0] & 0x80) != 0;
+
+  if (negative) {
+    bool carry = true;
+
+    for (size_t i = kSha1Size; i-- > 0;) {
+      digest[i] = ~digest[i];
+
+      if (carry) {
+        carry = ++digest[i] == 0;
+      }
+    }
+
+    *out++ = '-';
+  }
+
+  constexpr const char* kHexDigits = "0123456789abcdef";
+  bool leading = true;
+
+  for (size_t i = 0; i < kSha1Size * 2; ++i) {
+    u8 nibble = (digest[i / 2] >> ((i & 1) ? 0 : 4)) & 0x0F;
+
+    if (leading && nibble == 0) continue;
+
+    leading = false;
+    *out++ = kHexDigits[nibble];
+  }
+
+  if (leading) {
+    *out++ = '0';
+  }
+
+  *out = 0;
+}
+
+static size_t DiscardResponse(char* ptr, size_t size, size_t nmemb, void* userp) {
+  return size * nmemb;
+}
+
+bool JoinServerSession(const String& access_token, const String& profile_uuid, const char* server_hash) {
+  // The session server takes the profile id without dashes.
+  char uuid[33];
+  size_t uuid_size = 0;
+
+  for (size_t i = 0; i < profile_uuid.size && uuid_size < sizeof(uuid) - 1; ++i) {
+    if (profile_uuid.data[i] != '-') {
+      uuid[uuid_size++] = profile_uuid.data[i];
+    }
+  }
+
+  uuid[uuid_size] = 0;
+
+  constexpr const char* kJoinFormat = "{\"accessToken\":\"%.*s\",\"selectedProfile\":\"%s\",\"serverId\":\"%s\"}";
+
+  char body[4096];
+  int body_size =
+      snprintf(body, sizeof(body), kJoinFormat, (int)access_token.size, access_token.data, uuid, server_hash);
+
+  if (body_size < 0 || body_size >= (int)sizeof(body)) {
+    fprintf(stderr, "Session join request is too large.\n");
+    return false;
+  }
+
+  CURL* curl = curl_easy_init();
+
+  if (!curl) {
+    fprintf(stderr, "Failed to create session request.\n");
+    return false;
+  }
+
+  curl_slist* headers = curl_slist_append(nullptr, "Content-Type: application/json");
+
+  curl_easy_setopt(curl, CURLOPT_URL, kSessionJoinUrl);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)body_size);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, DiscardResponse);
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, kSessionConnectTimeout);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT, kSessionTimeout);
+
+  CURLcode res = curl_easy_perform(curl);
+  long http_code = 0;
+
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+  curl_slist_free_all(headers);
+  curl_easy_cleanup(curl);
+
+  if (res != CURLE_OK) {
+    fprintf(stderr, "Session join request failed: %s\n", curl_easy_strerror(res));
+    return false;
+  }
+
+  // The session server responds with no content when the join is accepted.
+  if (http_code != 204) {
+    fprintf(stderr, "Session server rejected join with code %ld.\n", http_code);
+    return false;
+  }
+
+  return true;
+}
+
+SessionJoin::~SessionJoin() {
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void SessionJoin::Start(const String& access_token, const String& profile_uuid, const char* server_hash) {
+  // Only one login can be in progress, but a previous one may have finished without being polled.
+  if (thread.joinable()) {
+    thread.join();
+  }
+
+  this->access_token = access_token;
+  this->profile_uuid = profile_uuid;
+
+  strncpy(this->server_hash, server_hash, sizeof(this->server_hash) - 1);
+  this->server_hash[sizeof(this->server_hash) - 1] = 0;
+
+  status.store(Status::Pending, std::memory_order_release);
+
+  thread = std::thread([this]() {
+    bool joined = JoinServerSession(this->access_token, this->profile_uuid, this->server_hash);
+
+    status.store(joined ? Status::Success : Status::Failure, std::memory_order_release);
+  });
+}
+
+SessionJoin::Status SessionJoin::Poll() {
+  Status result = status.load(std::memory_order_acquire);
+
+  if (result == Status::Success || result == Status::Failure) {
+    thread.join();
+    status.store(Status::Idle, std::memory_order_relaxed);
+  }
+
+  return result;
+}
+
+} // namespace polymer
@@ -0,0 +1,59 @@
+#ifndef POLYMER_SESSION_H_
+#define POLYMER_SESSION_H_
+
+#include <polymer/types.h>
+
+#include <atomic>
+#include <thread>
+
+namespace polymer {
+
+// Longest hex digest with its sign and null terminator.
+constexpr size_t kServerHashSize = 42;
+// The encrypted secret and verify token are one RSA block each, which is 128 bytes for the server's 1024 bit key.
+constexpr size_t kMaxEncryptedSize = 512;
+// Limits on the encryption request fields. The server id is at most 20 characters and the public key is a DER encoded
+// RSA key, which is 162 bytes for the 1024 bit keys that servers use.
+constexpr size_t kMaxServerIdSize = 20;
+constexpr size_t kMaxPublicKeySize = 1024;
+
+// Fills the shared secret with random bytes from the system.
+bool GenerateSharedSecret(u8* secret, size_t size);
+
+// Encrypts data with PKCS #1 v1.5 padding using the server's public key, which is sent as an X.509 public key.
+// The out_size is the capacity of the output on input and the encrypted size on output.
+bool EncryptWithPublicKey(const u8* public_key, size_t public_key_size, const u8* data, size_t size, u8* out,
+                          size_t* out_size);
+
+// The server id that is sent to the session server, which is the SHA-1 of the server id string, the shared secret and
+// the public key printed as a signed hex number.
+void ComputeServerHash(const String& server_id, const u8* secret, size_t secret_size, const u8* public_key,
+                       size_t public_key_size, char* out);
+
+// Tells the session server that this account is joining the server so the server can verify it. Blocks until the
+// request completes.
+bool JoinServerSession(const String& access_token, const String& profile_uuid, const char* server_hash);
+
+// Runs JoinServerSession on its own thread so the game keeps rendering during the round trip to the session server.
+struct SessionJoin {
+  enum class Status { Idle, Pending, Success, Failure };
+
+  std::thread thread;
+  std::atomic<Status> status{Status::Idle};
+
+  // The strings must stay valid until the join completes. The hash is copied.
+  String access_token;
+  String profile_uuid;
+  char server_hash[kServerHashSize];
+
+  ~SessionJoin();
+
+  void Start(const String& access_token, const String& profile_uuid, const char* server_hash);
+
+  // Returns Pending until the request completes. The result is only returned once, then it goes back to Idle.
+  Status Poll();
+};
+
+} // namespace polymer
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef POLYMER_SPSC_QUEUE_H_
+#define POLYMER_SPSC_QUEUE_H_
+
+#include <polymer/types.h>
+
+#include <atomic>
+
+namespace polymer {
+
+// Lock free byte queue between a single producer thread and a single consumer thread. The data is expected to be
+// mirrored in virtual memory, so everything between the offsets can be accessed as one contiguous block even when it
+// wraps around the end. One byte is always left free so a full queue isn't mistaken for an empty one.
+struct SpscQueue {
+  u8* data = nullptr;
+  size_t size = 0;
+
+  // Only written by the consumer.
+  std::atomic<size_t> read_offset{0};
+  // Only written by the producer.
+  std::atomic<size_t> write_offset{0};
+
+  // Producer: Returns how many bytes can be written.
+  inline size_t GetFreeSize() const {
+    size_t read = read_offset.load(std::memory_order_acquire);
+    size_t write = write_offset.load(std::memory_order_relaxed);
+
+    return size - 1 - (write + size - read) % size;
+  }
+
+  // Producer
+  inline u8* GetWritePointer() const {
+    return data + write_offset.load(std::memory_order_relaxed);
+  }
+
+  // Producer: Makes the next count bytes visible to the consumer.
+  inline void CommitWrite(size_t count) {
+    size_t write = write_offset.load(std::memory_order_relaxed);
+
+    write_offset.store((write + count) % size, std::memory_order_release);
+  }
+
+  // Consumer: Returns how many bytes can be read.
+  inline size_t GetReadAmount() const {
+    size_t write = write_offset.load(std::memory_order_acquire);
+    size_t read = read_offset.load(std::memory_order_relaxed);
+
+    return (write + size - read) % size;
+  }
+
+  // Consumer
+  inline const u8* GetReadPointer() const {
+    return data + read_offset.load(std::memory_order_relaxed);
+  }
+
+  // Consumer: Gives the next count bytes back to the producer.
+  inline void CommitRead(size_t count) {
+    size_t read = read_offset.load(std::memory_order_relaxed);
+
+    read_offset.store((read + count) % size, std::memory_order_release);
+  }
+};
+
+} // namespace polymer
+
+#endif
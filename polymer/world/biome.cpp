@@ -0,0 +1,161 @@
+#include <polymer/world/biome.h>
+
+#include <polymer/memory.h>
+#include <polymer/nbt.h>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace polymer {
+namespace world {
+
+const Biome BiomeCodec::kDefaultBiome = {{}, 0.8f, 0.4f, kDefaultGrassColor, kDefaultFoliageColor, kDefaultWaterColor};
+
+static inline float Saturate(float value) {
+  if (value < 0.0f) return 0.0f;
+  if (value > 1.0f) return 1.0f;
+
+  return value;
+}
+
+// Matches the vanilla colormap lookup, where hotter biomes are to the left and wetter biomes are towards the top.
+static u32 SampleColormap(const u32* colormap, float temperature, float downfall, u32 fallback) {
+  if (!colormap) return fallback;
+
+  float adjusted_temperature = Saturate(temperature);
+  float adjusted_downfall = Saturate(downfall) * adjusted_temperature;
+
+  size_t x = (size_t)((1.0f - adjusted_temperature) * (kColormapSize - 1));
+  size_t y = (size_t)((1.0f - adjusted_downfall) * (kColormapSize - 1));
+
+  return colormap[y * kColormapSize + x];
+}
+
+static bool GetInt(nbt::TagCompound& compound, const String& name, u32* out) {
+  nbt::Tag* tag = compound.GetNamedTag(name);
+
+  if (!tag || tag->type != nbt::TagType::Int) return false;
+
+  *out = ((nbt::TagInt*)tag->tag)->data;
+  return true;
+}
+
+static void GetFloat(nbt::TagCompound& compound, const String& name, float* out) {
+  nbt::Tag* tag = compound.GetNamedTag(name);
+
+  if (tag && tag->type == nbt::TagType::Float) {
+    *out = ((nbt::TagFloat*)tag->tag)->data;
+  }
+}
+
+static void ParseBiome(nbt::TagCompound& element, const u32* grass_colormap, const u32* foliage_colormap,
+                       Biome* biome) {
+  GetFloat(element, POLY_STR("temperature"), &biome->temperature);
+  GetFloat(element, POLY_STR("downfall"), &biome->downfall);
+
+  biome->grass_color = SampleColormap(grass_colormap, biome->temperature, biome->downfall, kDefaultGrassColor);
+  biome->foliage_color = SampleColormap(foliage_colormap, biome->temperature, biome->downfall, kDefaultFoliageColor);
+
+  nbt::Tag* effects_tag = element.GetNamedTag(POLY_STR("effects"));
+
+  if (!effects_tag || effects_tag->type != nbt::TagType::Compound) return;
+
+  nbt::TagCompound* effects = (nbt::TagCompound*)effects_tag->tag;
+
+  GetInt(*effects, POLY_STR("grass_color"), &biome->grass_color);
+  GetInt(*effects, POLY_STR("foliage_color"), &biome->foliage_color);
+  GetInt(*effects, POLY_STR("water_color"), &biome->water_color);
+
+  nbt::Tag* modifier_tag = effects->GetNamedTag(POLY_STR("grass_color_modifier"));
+
+  if (modifier_tag && modifier_tag->type == nbt::TagType::String) {
+    nbt::TagString* modifier_str = (nbt::TagString*)modifier_tag->tag;
+    String modifier(modifier_str->data, modifier_str->length);
+
+    if (poly_strcmp(modifier, POLY_STR("dark_forest")) == 0) {
+      biome->grass_color = ((biome->grass_color & 0xFEFEFE) + 0x28340A) >> 1;
+    } else if (poly_strcmp(modifier, POLY_STR("swamp")) == 0) {
+      // Vanilla switches between two colors with noise, so this uses the more common one.
+      biome->grass_color = 0x6A7039;
+    }
+  }
+
+  biome->grass_color &= 0xFFFFFF;
+  biome->foliage_color &= 0xFFFFFF;
+  biome->water_color &= 0xFFFFFF;
+}
+
+void BiomeCodec::Parse(MemoryArena& arena, nbt::TagCompound& nbt, const u32* grass_colormap,
+                       const u32* foliage_colormap) {
+  biomes = nullptr;
+  biome_count = 0;
+
+  nbt::Tag* named_tag = nbt.GetNamedTag(POLY_STR("minecraft:worldgen/biome"));
+
+  if (!named_tag || named_tag->type != nbt::TagType::Compound) return;
+
+  nbt::TagCompound* biome_nbt = (nbt::TagCompound*)named_tag->tag;
+  nbt::Tag* value_tag = biome_nbt->GetNamedTag(POLY_STR("value"));
+
+  if (!value_tag || value_tag->type != nbt::TagType::List) return;
+
+  nbt::TagList* entry_list = (nbt::TagList*)value_tag->tag;
+
+  if (entry_list->type != nbt::TagType::Compound) return;
+
+  // The ids are the indices used in the chunk data, so the table is sized to the largest one.
+  size_t count = 0;
+
+  for (size_t i = 0; i < entry_list->length; ++i) {
+    u32 id = 0;
+
+    if (GetInt(*(nbt::TagCompound*)entry_list->tags[i].tag, POLY_STR("id"), &id) && id >= count) {
+      count = id + 1;
+    }
+  }
+
+  Biome* new_biomes = memory_arena_push_type_count(&arena, Biome, count);
+
+  if (!new_biomes) {
+    fprintf(stderr, "Failed to allocate %zu biomes.\n", count);
+    return;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    new_biomes[i] = kDefaultBiome;
+  }
+
+  for (size_t i = 0; i < entry_list->length; ++i) {
+    nbt::TagCompound* entry_compound = (nbt::TagCompound*)entry_list->tags[i].tag;
+    u32 id = 0;
+
+    if (!GetInt(*entry_compound, POLY_STR("id"), &id)) continue;
+
+    Biome* biome = new_biomes + id;
+
+    nbt::Tag* name_tag = entry_compound->GetNamedTag(POLY_STR("name"));
+
+    if (name_tag && name_tag->type == nbt::TagType::String) {
+      nbt::TagString* name_str = (nbt::TagString*)name_tag->tag;
+
+      biome->name.data = (char*)arena.Allocate(name_str->length);
+
+      if (biome->name.data) {
+        biome->name.size = name_str->length;
+        memcpy(biome->name.data, name_str->data, name_str->length);
+      }
+    }
+
+    nbt::Tag* element_tag = entry_compound->GetNamedTag(POLY_STR("element"));
+
+    if (element_tag && element_tag->type == nbt::TagType::Compound) {
+      ParseBiome(*(nbt::TagCompound*)element_tag->tag, grass_colormap, foliage_colormap, biome);
+    }
+  }
+
+  biomes = new_biomes;
+  biome_count = count;
+}
+
+} // namespace world
+} // namespace polymer
@@ -0,0 +1,59 @@
+#ifndef POLYMER_WORLD_BIOME_H_
+#define POLYMER_WORLD_BIOME_H_
+
+#include <polymer/types.h>
+
+namespace polymer {
+
+struct MemoryArena;
+
+namespace nbt {
+
+struct TagCompound;
+
+} // namespace nbt
+
+namespace world {
+
+// Colors are stored as 0xRRGGBB.
+constexpr u32 kDefaultGrassColor = 0x91BD59;
+constexpr u32 kDefaultFoliageColor = 0x77AB2F;
+constexpr u32 kDefaultWaterColor = 0x3F76E4;
+
+// The grass and foliage colormaps are 256x256 colors indexed by temperature and downfall.
+constexpr size_t kColormapSize = 256;
+
+struct Biome {
+  String name;
+
+  float temperature;
+  float downfall;
+
+  u32 grass_color;
+  u32 foliage_color;
+  u32 water_color;
+};
+
+struct BiomeCodec {
+  // Indexed by the biome's network id. Ids that weren't in the codec are filled with the default colors.
+  Biome* biomes = nullptr;
+  size_t biome_count = 0;
+
+  // Reads the biome registry out of the login codec. Biomes without explicit grass or foliage colors are sampled from
+  // the colormaps, which can be null if they couldn't be loaded.
+  void Parse(MemoryArena& arena, nbt::TagCompound& nbt, const u32* grass_colormap, const u32* foliage_colormap);
+
+  inline const Biome* GetBiome(u32 id) const {
+    if (id < biome_count) return biomes + id;
+
+    return &kDefaultBiome;
+  }
+
+private:
+  static const Biome kDefaultBiome;
+};
+
+} // namespace world
+} // namespace polymer
+
+#endif
@@ -0,0 +1,743 @@
+#include <polymer/world/chunk.h>
+
+#include <polymer/memory.h>
+#include <polymer/platform/platform.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// The vector paths are chosen from the target flags at compile time. SSE2 is always available on x64, and the others
+// can be turned on with POLYMER_AVX2.
+#if defined(__AVX2__)
+#define POLYMER_CHUNK_AVX2
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+#define POLYMER_CHUNK_SSSE3
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define POLYMER_CHUNK_SSE2
+#endif
+
+// MSVC doesn't define a macro for BMI2, but every CPU with AVX2 has it.
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define POLYMER_CHUNK_BMI2
+#endif
+
+#if defined(POLYMER_CHUNK_AVX2) || defined(POLYMER_CHUNK_SSSE3) || defined(POLYMER_CHUNK_BMI2)
+#include <immintrin.h>
+#elif defined(POLYMER_CHUNK_SSE2)
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#define bswap_64(x) _byteswap_uint64(x)
+#else
+#define bswap_64(x) __builtin_bswap64(x)
+#endif
+
+namespace polymer {
+namespace world {
+
+// Size of each slab taken from the platform when a free list runs dry. It's carved into as many blocks of the class as
+// fit after the slab header.
+constexpr size_t kStorageSlabSize = Kilobytes(256);
+constexpr size_t kStorageSlabHeaderSize = 16;
+
+static inline size_t GetPaletteCapacity(u8 bits) {
+  return bits == Chunk::kDirectBits ? 0 : ((size_t)1 << bits);
+}
+
+static inline size_t GetDataWordCount(u8 bits) {
+  return Chunk::kBlockCount * bits / 64;
+}
+
+static inline ChunkStorageClass GetStorageClass(u8 bits) {
+  if (bits == 4) return ChunkStorageClass::Palette4;
+  if (bits == 8) return ChunkStorageClass::Palette8;
+
+  return ChunkStorageClass::Direct;
+}
+
+static inline void WriteEntry(u64* data, u8 bits, size_t index, u64 value) {
+  size_t bit_index = index * bits;
+  size_t shift = bit_index & 63;
+  u64 mask = ((1ULL << bits) - 1) << shift;
+
+  data[bit_index >> 6] = (data[bit_index >> 6] & ~mask) | ((value << shift) & mask);
+}
+
+// The network data is big-endian and isn't aligned since it's read straight out of the connection buffer.
+static inline u64 LoadNetworkWord(const u8* network_data, size_t index) {
+  u64 word;
+
+  memcpy(&word, network_data + index * sizeof(u64), sizeof(u64));
+
+  return bswap_64(word);
+}
+
+// Storage that is the same width as the network data only needs the byte order swapped.
+static void UnpackSameWidth(const u8* network_data, u64* out, size_t word_count) {
+  size_t i = 0;
+
+#ifdef POLYMER_CHUNK_SSSE3
+  const __m128i kSwapMask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+  for (; i + 2 <= word_count; i += 2) {
+    __m128i words = _mm_loadu_si128((const __m128i*)(network_data + i * sizeof(u64)));
+
+    _mm_storeu_si128((__m128i*)(out + i), _mm_shuffle_epi8(words, kSwapMask));
+  }
+#endif
+
+  for (; i < word_count; ++i) {
+    out[i] = LoadNetworkWord(network_data, i);
+  }
+}
+
+// Widens each kNetworkBits entry into a kBits entry of 8 or 16 bits. The storage must already be zeroed.
+// Network words don't always hold a whole number of entries, in which case the unused top bits are skipped.
+template <u8 kNetworkBits, u8 kBits>
+static void UnpackWidened(const u8* network_data, size_t data_length, u64* out) {
+  constexpr size_t kNetworkEntriesPerWord = 64 / kNetworkBits;
+  constexpr size_t kEntriesPerWord = 64 / kBits;
+  constexpr u64 kNetworkMask = (1ULL << kNetworkBits) - 1;
+
+  static_assert(kNetworkBits < kBits && (kBits == 8 || kBits == 16), "Entries can only be widened to 8 or 16 bits.");
+
+  size_t word_count = (Chunk::kBlockCount + kNetworkEntriesPerWord - 1) / kNetworkEntriesPerWord;
+
+  if (data_length < word_count) {
+    word_count = data_length;
+  }
+
+  size_t index = 0;
+  size_t i = 0;
+
+#ifdef POLYMER_CHUNK_BMI2
+  // PDEP spreads a full output word of entries out into their wider lanes in a single instruction.
+  constexpr u64 kDepositMask = kNetworkMask * (kBits == 8 ? 0x0101010101010101ULL : 0x0001000100010001ULL);
+
+  // Each deposit writes a whole word, so stop early enough that the last one can't run past the end of the storage.
+  for (; i < word_count && index + kNetworkEntriesPerWord + kEntriesPerWord <= Chunk::kBlockCount; ++i) {
+    u64 word = LoadNetworkWord(network_data, i);
+
+    for (size_t remaining = kNetworkEntriesPerWord; remaining > 0;) {
+      size_t count = remaining < kEntriesPerWord ? remaining : kEntriesPerWord;
+      u64 deposit = _pdep_u64(word, kDepositMask);
+
+      // This is only reachable on x64, so the storage words are little-endian and can be written at any entry.
+      memcpy((u8*)out + index * (kBits / 8), &deposit, sizeof(deposit));
+
+      index += count;
+      remaining -= count;
+
+      if (remaining > 0) {
+        word >>= count * kNetworkBits;
+      }
+    }
+  }
+#endif
+
+  for (; i < word_count; ++i) {
+    u64 word = LoadNetworkWord(network_data, i);
+
+    for (size_t j = 0; j < kNetworkEntriesPerWord && index < Chunk::kBlockCount; ++j, ++index) {
+      out[index / kEntriesPerWord] |= (word & kNetworkMask) << ((index % kEntriesPerWord) * kBits);
+      word >>= kNetworkBits;
+    }
+  }
+}
+
+size_t ChunkStoragePool::GetBlockSize(ChunkStorageClass storage_class) {
+  switch (storage_class) {
+  case ChunkStorageClass::Palette4:
+    return GetPaletteCapacity(4) * sizeof(u32) + GetDataWordCount(4) * sizeof(u64);
+  case ChunkStorageClass::Palette8:
+    return GetPaletteCapacity(8) * sizeof(u32) + GetDataWordCount(8) * sizeof(u64);
+  case ChunkStorageClass::Direct:
+    return GetDataWordCount(Chunk::kDirectBits) * sizeof(u64);
+  case ChunkStorageClass::Light:
+    return Chunk::kBlockCount;
+  case ChunkStorageClass::Biomes:
+    return BiomeStorage::kCellCount * 4 / 8 + BiomeStorage::kPaletteCapacity * sizeof(u16);
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+void* ChunkStoragePool::Allocate(ChunkStorageClass storage_class) {
+  size_t index = (size_t)storage_class;
+  size_t block_size = GetBlockSize(storage_class);
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (!free_lists[index]) {
+    u8* slab = g_Platform.Allocate(kStorageSlabSize);
+
+    if (!slab) {
+      fprintf(stderr, "Failed to allocate chunk storage slab.\n");
+      return nullptr;
+    }
+
+    *(u8**)slab = slabs;
+    slabs = slab;
+
+    size_t block_count = (kStorageSlabSize - kStorageSlabHeaderSize) / block_size;
+    u8* blocks = slab + kStorageSlabHeaderSize;
+
+    for (size_t i = 0; i < block_count; ++i) {
+      void* block = blocks + i * block_size;
+
+      *(void**)block = free_lists[index];
+      free_lists[index] = block;
+    }
+
+    reserved_bytes[index] += block_size * block_count;
+  }
+
+  void* result = free_lists[index];
+  free_lists[index] = *(void**)result;
+
+  used_bytes[index] += block_size;
+
+  return result;
+}
+
+void ChunkStoragePool::Free(ChunkStorageClass storage_class, void* block) {
+  size_t index = (size_t)storage_class;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  *(void**)block = free_lists[index];
+  free_lists[index] = block;
+
+  used_bytes[index] -= GetBlockSize(storage_class);
+}
+
+size_t ChunkStoragePool::GetUsedBytes() const {
+  size_t result = 0;
+
+  for (size_t i = 0; i < (size_t)ChunkStorageClass::Count; ++i) {
+    result += used_bytes[i];
+  }
+
+  return result;
+}
+
+size_t ChunkStoragePool::GetReservedBytes() const {
+  size_t result = 0;
+
+  for (size_t i = 0; i < (size_t)ChunkStorageClass::Count; ++i) {
+    result += reserved_bytes[i];
+  }
+
+  return result;
+}
+
+void ChunkStoragePool::Shutdown() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  while (slabs) {
+    u8* next = *(u8**)slabs;
+
+    g_Platform.Free(slabs);
+    slabs = next;
+  }
+
+  for (size_t i = 0; i < (size_t)ChunkStorageClass::Count; ++i) {
+    free_lists[i] = nullptr;
+    reserved_bytes[i] = used_bytes[i] = 0;
+  }
+}
+
+bool Chunk::SetBlock(ChunkStoragePool& pool, size_t index, u32 block_id) {
+  if (bits_per_entry == 0) {
+    if (block_id == single_value) return true;
+    if (!Resize(pool, 4)) return false;
+  }
+
+  if (bits_per_entry == kDirectBits) {
+    assert(block_id <= 0xFFFF);
+    WriteEntry(data, bits_per_entry, index, block_id);
+    return true;
+  }
+
+  size_t palette_index = palette_count;
+
+  for (size_t i = 0; i < palette_count; ++i) {
+    if (palette[i] == block_id) {
+      palette_index = i;
+      break;
+    }
+  }
+
+  if (palette_index == palette_count) {
+    // Old palette entries are never removed, so a section that is edited a lot will eventually end up direct.
+    if (palette_count >= GetPaletteCapacity(bits_per_entry)) {
+      if (!Resize(pool, bits_per_entry == 4 ? 8 : kDirectBits)) return false;
+
+      if (bits_per_entry == kDirectBits) {
+        assert(block_id <= 0xFFFF);
+        WriteEntry(data, bits_per_entry, index, block_id);
+        return true;
+      }
+    }
+
+    palette[palette_count++] = block_id;
+  }
+
+  WriteEntry(data, bits_per_entry, index, palette_index);
+
+  return true;
+}
+
+void Chunk::Fill(ChunkStoragePool& pool, u32 block_id) {
+  FreeBlocks(pool);
+
+  single_value = block_id;
+}
+
+bool Chunk::Load(ChunkStoragePool& pool, u8 network_bits, const u64* network_palette, size_t palette_length,
+                 const u8* network_data, size_t data_length) {
+  FreeBlocks(pool);
+
+  if (network_palette && (network_bits == 0 || palette_length == 1)) {
+    single_value = (u32)network_palette[0];
+    return true;
+  }
+
+  if (network_bits == 0 || network_bits > 32 || (network_palette && palette_length > GetPaletteCapacity(8))) {
+    fprintf(stderr, "Invalid chunk section format.\n");
+    return false;
+  }
+
+  u8 new_bits = kDirectBits;
+
+  if (network_palette) {
+    new_bits = palette_length <= GetPaletteCapacity(4) ? 4 : 8;
+  }
+
+  if (!Resize(pool, new_bits)) return false;
+
+  if (network_palette) {
+    for (size_t i = 0; i < palette_length; ++i) {
+      palette[i] = (u32)network_palette[i];
+    }
+
+    palette_count = (u16)palette_length;
+  }
+
+  // The network layout is the same as the storage layout when the widths match.
+  if (network_bits == new_bits && data_length == GetDataWordCount(new_bits)) {
+    UnpackSameWidth(network_data, data, data_length);
+    return true;
+  }
+
+  // Specialize the widths that servers actually send so the unpacking loops are fully unrolled.
+  if (new_bits == 8 && network_bits == 5) {
+    UnpackWidened<5, 8>(network_data, data_length, data);
+  } else if (new_bits == 8 && network_bits == 6) {
+    UnpackWidened<6, 8>(network_data, data_length, data);
+  } else if (new_bits == 8 && network_bits == 7) {
+    UnpackWidened<7, 8>(network_data, data_length, data);
+  } else if (new_bits == kDirectBits && network_bits == 15) {
+    UnpackWidened<15, kDirectBits>(network_data, data_length, data);
+  } else {
+    size_t entries_per_word = 64 / network_bits;
+    u64 mask = (1ULL << network_bits) - 1;
+    size_t index = 0;
+
+    for (size_t i = 0; i < data_length && index < kBlockCount; ++i) {
+      u64 word = LoadNetworkWord(network_data, i);
+
+      for (size_t j = 0; j < entries_per_word && index < kBlockCount; ++j) {
+        WriteEntry(data, new_bits, index++, word & mask);
+        word >>= network_bits;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool Chunk::Compact(ChunkStoragePool& pool) {
+  if (bits_per_entry == 0) return true;
+
+  // Every word holds a whole number of entries, so a uniform section is the first entry repeated through every word.
+  u64 first = data[0] & ((1ULL << bits_per_entry) - 1);
+  u64 pattern = 0;
+
+  for (size_t shift = 0; shift < 64; shift += bits_per_entry) {
+    pattern |= first << shift;
+  }
+
+  size_t word_count = GetDataWordCount(bits_per_entry);
+
+  for (size_t i = 0; i < word_count; ++i) {
+    if (data[i] != pattern) return false;
+  }
+
+  Fill(pool, palette ? palette[first] : (u32)first);
+
+  return true;
+}
+
+// Decodes the 16 entries along x of a single row.
+template <u8 kBits>
+static inline void DecodeRow(const u64* words, const u32* palette, u32* row) {
+  constexpr size_t kEntriesPerWord = 64 / kBits;
+  constexpr size_t kWordsPerRow = 16 / kEntriesPerWord;
+  constexpr u64 kMask = (1ULL << kBits) - 1;
+
+  for (size_t w = 0; w < kWordsPerRow; ++w) {
+    u64 word = words[w];
+
+    for (size_t e = 0; e < kEntriesPerWord; ++e) {
+      u32 value = (u32)(word & kMask);
+
+      row[w * kEntriesPerWord + e] = kBits == Chunk::kDirectBits ? value : palette[value];
+      word >>= kBits;
+    }
+  }
+}
+
+#ifdef POLYMER_CHUNK_AVX2
+// Looks up 16 byte palette indices at once.
+static inline void GatherRow(const u32* palette, __m128i indices, u32* row) {
+  __m256i low = _mm256_cvtepu8_epi32(indices);
+  __m256i high = _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8));
+
+  _mm256_storeu_si256((__m256i*)row, _mm256_i32gather_epi32((const int*)palette, low, 4));
+  _mm256_storeu_si256((__m256i*)(row + 8), _mm256_i32gather_epi32((const int*)palette, high, 4));
+}
+
+template <>
+inline void DecodeRow<4>(const u64* words, const u32* palette, u32* row) {
+  const __m128i kNibbleMask = _mm_set1_epi8(0x0F);
+
+  __m128i packed = _mm_loadl_epi64((const __m128i*)words);
+  __m128i low = _mm_and_si128(packed, kNibbleMask);
+  __m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), kNibbleMask);
+
+  // The low nibble of each byte is the first entry, so interleaving puts them back in x order.
+  GatherRow(palette, _mm_unpacklo_epi8(low, high), row);
+}
+
+template <>
+inline void DecodeRow<8>(const u64* words, const u32* palette, u32* row) {
+  GatherRow(palette, _mm_loadu_si128((const __m128i*)words), row);
+}
+#endif
+
+#ifdef POLYMER_CHUNK_SSE2
+template <>
+inline void DecodeRow<Chunk::kDirectBits>(const u64* words, const u32* palette, u32* row) {
+  const __m128i kZero = _mm_setzero_si128();
+
+  __m128i first = _mm_loadu_si128((const __m128i*)words);
+  __m128i second = _mm_loadu_si128((const __m128i*)(words + 2));
+
+  _mm_storeu_si128((__m128i*)row, _mm_unpacklo_epi16(first, kZero));
+  _mm_storeu_si128((__m128i*)(row + 4), _mm_unpackhi_epi16(first, kZero));
+  _mm_storeu_si128((__m128i*)(row + 8), _mm_unpacklo_epi16(second, kZero));
+  _mm_storeu_si128((__m128i*)(row + 12), _mm_unpackhi_epi16(second, kZero));
+}
+#endif
+
+template <u8 kBits>
+static void DecodePacked(const u64* data, const u32* palette, u32* out, size_t row_stride, size_t layer_stride) {
+  constexpr size_t kWordsPerRow = kBits * 16 / 64;
+
+  for (size_t y = 0; y < 16; ++y) {
+    for (size_t z = 0; z < 16; ++z) {
+      u32* row = out + y * layer_stride + z * row_stride;
+      const u64* words = data + (y * 16 + z) * kWordsPerRow;
+
+      DecodeRow<kBits>(words, palette, row);
+    }
+  }
+}
+
+void Chunk::DecodeBlocks(u32* out, size_t row_stride, size_t layer_stride) const {
+  switch (bits_per_entry) {
+  case 0: {
+    for (size_t y = 0; y < 16; ++y) {
+      for (size_t z = 0; z < 16; ++z) {
+        u32* row = out + y * layer_stride + z * row_stride;
+
+        for (size_t x = 0; x < 16; ++x) {
+          row[x] = single_value;
+        }
+      }
+    }
+  } break;
+  case 4: {
+    DecodePacked<4>(data, palette, out, row_stride, layer_stride);
+  } break;
+  case 8: {
+    DecodePacked<8>(data, palette, out, row_stride, layer_stride);
+  } break;
+  case kDirectBits: {
+    DecodePacked<kDirectBits>(data, palette, out, row_stride, layer_stride);
+  } break;
+  default: {
+    assert(false);
+  } break;
+  }
+}
+
+void Chunk::DecodeLight(u8* out, size_t row_stride, size_t layer_stride) const {
+  for (size_t y = 0; y < 16; ++y) {
+    for (size_t z = 0; z < 16; ++z) {
+      u8* row = out + y * layer_stride + z * row_stride;
+
+      if (lightmap) {
+        memcpy(row, lightmap + GetIndex(0, y, z), 16);
+      } else {
+        memset(row, uniform_light, 16);
+      }
+    }
+  }
+}
+
+u8* Chunk::AcquireLightmap(ChunkStoragePool& pool) {
+  if (!lightmap) {
+    lightmap = (u8*)pool.Allocate(ChunkStorageClass::Light);
+
+    if (lightmap) {
+      memset(lightmap, uniform_light, kBlockCount);
+    }
+  }
+
+  return lightmap;
+}
+
+void Chunk::SetUniformLight(ChunkStoragePool& pool, u8 light) {
+  if (lightmap) {
+    pool.Free(ChunkStorageClass::Light, lightmap);
+    lightmap = nullptr;
+  }
+
+  uniform_light = light;
+}
+
+u32 Chunk::SetLightLayer(ChunkStoragePool& pool, LightLayer layer, const u8* nibbles) {
+  u8 shift = layer == LightLayer::Sky ? 0 : 4;
+  u8 keep_mask = layer == LightLayer::Sky ? 0xF0 : 0x0F;
+
+  // Clearing a layer of uniform light doesn't need a lightmap.
+  if (!nibbles && !lightmap) {
+    u8 new_light = uniform_light & keep_mask;
+
+    if (new_light == uniform_light) return 0;
+
+    uniform_light = new_light;
+    return LightChangeFlag_All;
+  }
+
+  u8* map = AcquireLightmap(pool);
+  if (!map) return 0;
+
+  u32 changes = 0;
+
+  for (size_t y = 0; y < 16; ++y) {
+    for (size_t z = 0; z < 16; ++z) {
+      size_t row_index = GetIndex(0, y, z);
+      u32 row_changes = 0;
+
+      for (size_t x = 0; x < 16; ++x) {
+        size_t index = row_index + x;
+        u8 value = nibbles ? (nibbles[index >> 1] >> ((index & 1) * 4)) & 0x0F : 0;
+        u8 new_light = (map[index] & keep_mask) | (value << shift);
+
+        row_changes |= (u32)(new_light != map[index]) << x;
+        map[index] = new_light;
+      }
+
+      if (row_changes == 0) continue;
+
+      changes |= LightChangeFlag_Any;
+
+      if (row_changes & 0x0001) changes |= LightChangeFlag_West;
+      if (row_changes & 0x8000) changes |= LightChangeFlag_East;
+      if (y == 0) changes |= LightChangeFlag_Down;
+      if (y == 15) changes |= LightChangeFlag_Up;
+      if (z == 0) changes |= LightChangeFlag_North;
+      if (z == 15) changes |= LightChangeFlag_South;
+    }
+  }
+
+  return changes;
+}
+
+void Chunk::CompactLight(ChunkStoragePool& pool) {
+  if (!lightmap) return;
+
+  u64 pattern = 0x0101010101010101ULL * lightmap[0];
+  const u64* words = (const u64*)lightmap;
+
+  for (size_t i = 0; i < kBlockCount / sizeof(u64); ++i) {
+    if (words[i] != pattern) return;
+  }
+
+  SetUniformLight(pool, lightmap[0]);
+}
+
+void Chunk::Free(ChunkStoragePool& pool) {
+  Fill(pool, 0);
+  SetUniformLight(pool, 0);
+  biomes.Fill(pool, 0);
+}
+
+void Chunk::FreeBlocks(ChunkStoragePool& pool) {
+  if (bits_per_entry != 0) {
+    pool.Free(GetStorageClass(bits_per_entry), palette ? (void*)palette : (void*)data);
+  }
+
+  data = nullptr;
+  palette = nullptr;
+  palette_count = 0;
+  bits_per_entry = 0;
+}
+
+bool Chunk::Resize(ChunkStoragePool& pool, u8 new_bits) {
+  u8* block = (u8*)pool.Allocate(GetStorageClass(new_bits));
+
+  if (!block) return false;
+
+  size_t palette_capacity = GetPaletteCapacity(new_bits);
+  u32* new_palette = nullptr;
+  u64* new_data = (u64*)(block + palette_capacity * sizeof(u32));
+
+  if (palette_capacity > 0) {
+    new_palette = (u32*)block;
+    memset(new_palette, 0, palette_capacity * sizeof(u32));
+  }
+
+  memset(new_data, 0, GetDataWordCount(new_bits) * sizeof(u64));
+
+  u16 new_palette_count = 0;
+
+  if (bits_per_entry == 0) {
+    // Every index is already 0, so only the palette needs the old value.
+    if (new_palette) {
+      new_palette[new_palette_count++] = single_value;
+    } else {
+      for (size_t i = 0; i < kBlockCount; ++i) {
+        WriteEntry(new_data, new_bits, i, single_value);
+      }
+    }
+  } else if (new_palette) {
+    // Growing between palette sizes keeps the same indices.
+    memcpy(new_palette, palette, palette_count * sizeof(u32));
+    new_palette_count = palette_count;
+
+    for (size_t i = 0; i < kBlockCount; ++i) {
+      size_t bit_index = i * bits_per_entry;
+      u64 value = (data[bit_index >> 6] >> (bit_index & 63)) & ((1ULL << bits_per_entry) - 1);
+
+      WriteEntry(new_data, new_bits, i, value);
+    }
+  } else {
+    for (size_t i = 0; i < kBlockCount; ++i) {
+      // Block states are stored in 16 bits, which covers every state in the registry.
+      WriteEntry(new_data, new_bits, i, GetBlock(i));
+    }
+  }
+
+  FreeBlocks(pool);
+
+  data = new_data;
+  palette = new_palette;
+  palette_count = new_palette_count;
+  bits_per_entry = new_bits;
+
+  return true;
+}
+
+bool BiomeStorage::Load(ChunkStoragePool& pool, u8 network_bits, const u64* network_palette, size_t palette_length,
+                        const u8* network_data, size_t data_length) {
+  if (network_palette && (network_bits == 0 || palette_length == 1)) {
+    Fill(pool, (u16)network_palette[0]);
+    return true;
+  }
+
+  if (network_bits == 0 || network_bits > 32) {
+    fprintf(stderr, "Invalid biome section format.\n");
+    return false;
+  }
+
+  if (!data) {
+    u8* block = (u8*)pool.Allocate(ChunkStorageClass::Biomes);
+
+    if (!block) return false;
+
+    data = (u64*)block;
+    palette = (u16*)(block + kCellCount * 4 / 8);
+  }
+
+  memset(data, 0, kCellCount * 4 / 8);
+  palette_count = 0;
+
+  size_t entries_per_word = 64 / network_bits;
+  u64 mask = (1ULL << network_bits) - 1;
+  size_t index = 0;
+
+  for (size_t i = 0; i < data_length && index < kCellCount; ++i) {
+    u64 word = LoadNetworkWord(network_data, i);
+
+    for (size_t j = 0; j < entries_per_word && index < kCellCount; ++j, ++index) {
+      u64 value = word & mask;
+      u16 biome_id = (u16)value;
+
+      word >>= network_bits;
+
+      if (network_palette) {
+        biome_id = value < palette_length ? (u16)network_palette[value] : 0;
+      }
+
+      size_t palette_index = 0;
+
+      while (palette_index < palette_count && palette[palette_index] != biome_id) {
+        ++palette_index;
+      }
+
+      // Vanilla generation never puts more than a handful of biomes in one section, so anything past the capacity is
+      // folded into the first biome instead of growing the storage.
+      if (palette_index == palette_count) {
+        if (palette_count < kPaletteCapacity) {
+          palette[palette_count++] = biome_id;
+        } else {
+          palette_index = 0;
+        }
+      }
+
+      data[index >> 4] |= (u64)palette_index << ((index & 15) * 4);
+    }
+  }
+
+  if (palette_count <= 1) {
+    Fill(pool, palette_count == 1 ? palette[0] : 0);
+  }
+
+  return true;
+}
+
+void BiomeStorage::Fill(ChunkStoragePool& pool, u16 biome_id) {
+  if (data) {
+    pool.Free(ChunkStorageClass::Biomes, data);
+  }
+
+  data = nullptr;
+  palette = nullptr;
+  palette_count = 0;
+  single_value = biome_id;
+}
+
+} // namespace world
+} // namespace polymer
@@ -0,0 +1,215 @@
+#ifndef POLYMER_WORLD_CHUNK_H_
+#define POLYMER_WORLD_CHUNK_H_
+
+#include <polymer/types.h>
+
+#include <mutex>
+
+namespace polymer {
+
+struct MemoryArena;
+
+namespace world {
+
+enum class ChunkStorageClass {
+  Palette4,
+  Palette8,
+  Direct,
+  Light,
+  Biomes,
+
+  Count
+};
+
+// Fixed size blocks for chunk storage. They are carved out of slabs from the platform allocator and recycled through a
+// free list per size so sections can grow, shrink, and unload. Slabs are only taken as the loaded world grows, so
+// nothing is reserved up front, and they are all given back in Shutdown.
+// Chunks are decoded on worker threads, so allocating and freeing is locked.
+struct ChunkStoragePool {
+  std::mutex mutex;
+
+  void* free_lists[(size_t)ChunkStorageClass::Count] = {};
+
+  // Every slab taken from the platform, linked through their first bytes.
+  u8* slabs = nullptr;
+
+  // Bytes carved out of the slabs for each class, including anything sitting in the free lists.
+  size_t reserved_bytes[(size_t)ChunkStorageClass::Count] = {};
+  size_t used_bytes[(size_t)ChunkStorageClass::Count] = {};
+
+  // Returns null if a new slab couldn't be allocated.
+  void* Allocate(ChunkStorageClass storage_class);
+  void Free(ChunkStorageClass storage_class, void* block);
+
+  size_t GetUsedBytes() const;
+  size_t GetReservedBytes() const;
+
+  // Frees every slab. Nothing can be using the pool anymore.
+  void Shutdown();
+
+  static size_t GetBlockSize(ChunkStorageClass storage_class);
+};
+
+enum class LightLayer { Sky, Block };
+
+// Where the light of a section changed, so only the neighbors that sample its borders need to be remeshed.
+enum LightChangeFlags {
+  LightChangeFlag_Any = (1 << 0),
+  LightChangeFlag_West = (1 << 1),  // x == 0
+  LightChangeFlag_East = (1 << 2),  // x == 15
+  LightChangeFlag_Down = (1 << 3),  // y == 0
+  LightChangeFlag_Up = (1 << 4),    // y == 15
+  LightChangeFlag_North = (1 << 5), // z == 0
+  LightChangeFlag_South = (1 << 6), // z == 15
+
+  LightChangeFlag_All = 0x7F,
+};
+
+// The biome of each 4x4x4 cell of a section, stored as 4 bit indices into a small palette.
+// Sections that are a single biome carry no storage.
+struct BiomeStorage {
+  constexpr static size_t kCellCount = 4 * 4 * 4;
+  constexpr static size_t kPaletteCapacity = 16;
+
+  // Packed palette indices, followed by the palette in the same storage block.
+  u64* data;
+  u16* palette;
+
+  u16 single_value;
+  u8 palette_count;
+
+  BiomeStorage() : data(nullptr), palette(nullptr), single_value(0), palette_count(0) {}
+
+  // Index is ordered y, z, x to match the network format.
+  static inline size_t GetIndex(size_t cell_x, size_t cell_y, size_t cell_z) {
+    return (cell_y << 4) | (cell_z << 2) | cell_x;
+  }
+
+  inline u16 GetBiome(size_t index) const {
+    if (!data) return single_value;
+
+    return palette[(data[index >> 4] >> ((index & 15) * 4)) & 0x0F];
+  }
+
+  inline u16 GetBiome(size_t cell_x, size_t cell_y, size_t cell_z) const {
+    return GetBiome(GetIndex(cell_x, cell_y, cell_z));
+  }
+
+  // Loads the biomes from the network format. A null palette means the data holds the biome ids directly.
+  // The data is data_length big-endian longs exactly as they were received.
+  bool Load(ChunkStoragePool& pool, u8 network_bits, const u64* network_palette, size_t palette_length,
+            const u8* network_data, size_t data_length);
+
+  // Frees any storage and sets every cell to biome_id.
+  void Fill(ChunkStoragePool& pool, u16 biome_id);
+};
+
+// A 16x16x16 section of blocks stored as indices into a palette.
+// Sections that are a single block state carry no storage at all. Otherwise the indices are packed into 4 or 8 bits
+// when the palette is small enough, and the block states are stored directly in 16 bits when it isn't.
+// Entries never cross a u64 boundary, matching the layout of the network format.
+struct Chunk {
+  constexpr static size_t kBlockCount = 16 * 16 * 16;
+  constexpr static u8 kDirectBits = 16;
+
+  // Packed palette indices, or the block states themselves when bits_per_entry is kDirectBits.
+  u64* data;
+  // Null when the section is a single value or direct.
+  u32* palette;
+  // The bottom 4 bits contain the skylight data and the upper 4 bits contain the block light.
+  // Null when every block has the same light, which is stored in uniform_light.
+  u8* lightmap;
+
+  u32 single_value;
+  u16 palette_count;
+  // 0 means every block is single_value.
+  u8 bits_per_entry;
+  u8 uniform_light;
+
+  BiomeStorage biomes;
+
+  Chunk()
+      : data(nullptr), palette(nullptr), lightmap(nullptr), single_value(0), palette_count(0), bits_per_entry(0),
+        uniform_light(0) {}
+
+  // Index is ordered y, z, x to match the network format.
+  static inline size_t GetIndex(size_t x, size_t y, size_t z) {
+    return (y << 8) | (z << 4) | x;
+  }
+
+  inline u32 GetBlock(size_t index) const {
+    if (bits_per_entry == 0) return single_value;
+
+    size_t bit_index = index * bits_per_entry;
+    u32 value = (u32)(data[bit_index >> 6] >> (bit_index & 63)) & ((1u << bits_per_entry) - 1);
+
+    return palette ? palette[value] : value;
+  }
+
+  inline u32 GetBlock(size_t x, size_t y, size_t z) const {
+    return GetBlock(GetIndex(x, y, z));
+  }
+
+  // Uniform sections are a single block state and carry no block storage.
+  inline bool IsUniform() const {
+    return bits_per_entry == 0;
+  }
+
+  inline bool IsEmpty() const {
+    return bits_per_entry == 0 && single_value == 0;
+  }
+
+  inline u8 GetLight(size_t index) const {
+    return lightmap ? lightmap[index] : uniform_light;
+  }
+
+  inline u8 GetLight(size_t x, size_t y, size_t z) const {
+    return GetLight(GetIndex(x, y, z));
+  }
+
+  // Grows the storage if the palette can't hold the new block. Returns false if the storage couldn't be allocated.
+  bool SetBlock(ChunkStoragePool& pool, size_t index, u32 block_id);
+
+  inline bool SetBlock(ChunkStoragePool& pool, size_t x, size_t y, size_t z, u32 block_id) {
+    return SetBlock(pool, GetIndex(x, y, z), block_id);
+  }
+
+  // Frees any storage and sets every block to block_id.
+  void Fill(ChunkStoragePool& pool, u32 block_id);
+
+  // Loads the blocks from the network format. A null palette means the data holds the block states directly.
+  // The storage is picked from the palette length, so small palettes are repacked down to 4 bits.
+  // The data is data_length big-endian longs exactly as they were received, so it can be read in place.
+  bool Load(ChunkStoragePool& pool, u8 network_bits, const u64* network_palette, size_t palette_length,
+            const u8* network_data, size_t data_length);
+
+  // Collapses the storage down to a single value if every block is the same, such as after a section is mined out.
+  // Returns true if the section is uniform.
+  bool Compact(ChunkStoragePool& pool);
+
+  // Writes every block to out[y * layer_stride + z * row_stride + x].
+  void DecodeBlocks(u32* out, size_t row_stride, size_t layer_stride) const;
+  void DecodeLight(u8* out, size_t row_stride, size_t layer_stride) const;
+
+  // Returns the lightmap for writing, allocating it from the uniform light if it doesn't exist.
+  u8* AcquireLightmap(ChunkStoragePool& pool);
+  void SetUniformLight(ChunkStoragePool& pool, u8 light);
+  // Replaces one layer of the light with a 2048 byte nibble array in the network format, or with zero if nibbles is
+  // null. The other layer is kept. Returns the LightChangeFlags of the blocks whose light changed.
+  // The lightmap isn't compacted so several layers can be written before calling CompactLight.
+  u32 SetLightLayer(ChunkStoragePool& pool, LightLayer layer, const u8* nibbles);
+  // Frees the lightmap if every value in it is the same.
+  void CompactLight(ChunkStoragePool& pool);
+
+  // Frees all storage, leaving an air section with no light in biome 0.
+  void Free(ChunkStoragePool& pool);
+
+private:
+  void FreeBlocks(ChunkStoragePool& pool);
+  bool Resize(ChunkStoragePool& pool, u8 new_bits);
+};
+
+} // namespace world
+} // namespace polymer
+
+#endif
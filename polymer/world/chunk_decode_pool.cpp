@@ -0,0 +1,588 @@
+#include <polymer/world/chunk_decode_pool.h>
+
+#include <polymer/bitset.h>
+#include <polymer/nbt.h>
+#include <polymer/platform/platform.h>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace polymer {
+namespace world {
+
+constexpr size_t kDecodeScratchSize = Megabytes(4);
+// Packet buffers start at this size so most jobs never have to grow theirs.
+constexpr size_t kMinPacketCapacity = Kilobytes(64);
+// Most columns only get a few block changes and a light update while they decode.
+constexpr size_t kMinDeferredCapacity = Kilobytes(8);
+
+// Returns the first column section sent for the dimension and the number of sections sent.
+static inline void GetSentSections(s32 min_y, s32 height, size_t* start_y, size_t* count) {
+  *start_y = 0;
+  *count = kChunkColumnCount;
+
+  if (height > 0) {
+    s32 start = (min_y / 16) + (64 / 16);
+
+    *start_y = start > 0 ? (size_t)start : 0;
+    *count = (size_t)height / 16;
+  }
+}
+
+bool DecodeChunkSections(MemoryArena& scratch, ChunkStoragePool& pool, SpanReader& reader, s32 min_y, s32 height,
+                         Chunk* chunks, u32* bitmask) {
+  size_t start_y = 0;
+  size_t section_count = 0;
+
+  GetSentSections(min_y, height, &start_y, &section_count);
+
+  *bitmask = 0;
+
+  if (reader.size == 0) return true;
+
+  for (size_t chunk_y = start_y; chunk_y < start_y + section_count && chunk_y < kChunkColumnCount; ++chunk_y) {
+    Chunk* chunk = chunks + chunk_y;
+
+    u16 block_count = reader.ReadU16();
+    u8 bpb = reader.ReadU8();
+
+    if (block_count > 0) {
+      *bitmask |= (1 << chunk_y);
+    }
+
+    ArenaSnapshot snapshot = scratch.GetSnapshot();
+
+    u64* palette = nullptr;
+    u64 single_palette = 0;
+    u64 palette_length = 0;
+
+    if (bpb == 0) {
+      reader.ReadVarInt(&single_palette);
+      palette = &single_palette;
+      palette_length = 1;
+    } else if (bpb < 9) {
+      if (bpb < 4) bpb = 4;
+
+      reader.ReadVarInt(&palette_length);
+
+      // Every entry takes at least a byte, so anything longer than the rest of the data is corrupt.
+      if (palette_length > reader.GetRemaining()) return false;
+
+      palette = memory_arena_push_type_count(&scratch, u64, (size_t)palette_length);
+
+      for (u64 i = 0; i < palette_length; ++i) {
+        reader.ReadVarInt(palette + i);
+      }
+    }
+
+    u64 data_array_length;
+    reader.ReadVarInt(&data_array_length);
+
+    // The longs are unpacked straight out of the packet instead of being read one at a time.
+    const u8* data = reader.ReadBytes((size_t)data_array_length * sizeof(u64));
+
+    if (!data || !chunk->Load(pool, bpb, palette, (size_t)palette_length, data, (size_t)data_array_length)) {
+      fprintf(stderr, "Failed to load chunk section %zu.\n", chunk_y);
+    }
+
+    u8 biome_bpe = reader.ReadU8();
+
+    u64* biome_palette = nullptr;
+    u64 single_biome_palette = 0;
+    u64 biome_palette_length = 0;
+
+    // Biome containers switch to holding the ids directly above 3 bits instead of 8 like the blocks.
+    if (biome_bpe == 0) {
+      reader.ReadVarInt(&single_biome_palette);
+      biome_palette = &single_biome_palette;
+      biome_palette_length = 1;
+    } else if (biome_bpe < 4) {
+      reader.ReadVarInt(&biome_palette_length);
+
+      if (biome_palette_length > reader.GetRemaining()) return false;
+
+      biome_palette = memory_arena_push_type_count(&scratch, u64, (size_t)biome_palette_length);
+
+      for (u64 i = 0; i < biome_palette_length; ++i) {
+        reader.ReadVarInt(biome_palette + i);
+      }
+    }
+
+    u64 biome_data_array_length;
+    reader.ReadVarInt(&biome_data_array_length);
+
+    const u8* biome_data = reader.ReadBytes((size_t)biome_data_array_length * sizeof(u64));
+
+    if (!biome_data || !chunk->biomes.Load(pool, biome_bpe, biome_palette, (size_t)biome_palette_length, biome_data,
+                                           (size_t)biome_data_array_length)) {
+      fprintf(stderr, "Failed to load chunk biomes %zu.\n", chunk_y);
+    }
+
+    scratch.Revert(snapshot);
+
+    if (reader.overflow) return false;
+  }
+
+  return true;
+}
+
+bool DecodeChunkLight(MemoryArena& scratch, ChunkStoragePool& pool, SpanReader& reader, s32 min_y, s32 height,
+                      Chunk* chunks, u32* changes) {
+  for (size_t i = 0; i < kChunkColumnCount; ++i) {
+    changes[i] = 0;
+  }
+
+  BitSet light_masks[2];
+  BitSet empty_masks[2];
+
+  if (!light_masks[0].Read(scratch, reader)) return false;
+  if (!light_masks[1].Read(scratch, reader)) return false;
+  if (!empty_masks[0].Read(scratch, reader)) return false;
+  if (!empty_masks[1].Read(scratch, reader)) return false;
+
+  // The light arrays start one section below the dimension, so they need to be offset into the column.
+  s64 start_y = 0;
+  size_t light_section_count = kChunkColumnCount + 2;
+
+  if (height > 0) {
+    start_y = (min_y / 16) + (64 / 16);
+    light_section_count = (height / 16) + 2;
+  }
+
+  constexpr LightLayer kLayers[] = {LightLayer::Sky, LightLayer::Block};
+
+  for (size_t layer = 0; layer < 2; ++layer) {
+    u64 array_count = 0;
+    if (!reader.ReadVarInt(&array_count)) return false;
+
+    for (size_t i = 0; i < light_section_count; ++i) {
+      bool has_array = light_masks[layer].IsSet(i);
+
+      if (!has_array && !empty_masks[layer].IsSet(i)) continue;
+
+      const u8* nibbles = nullptr;
+
+      if (has_array) {
+        u64 length = 0;
+        reader.ReadVarInt(&length);
+
+        // The nibbles are decoded straight out of the packet.
+        nibbles = reader.ReadBytes((size_t)length);
+
+        if (!nibbles || length != Chunk::kBlockCount / 2) return false;
+      }
+
+      s64 chunk_y = start_y + (s64)i - 1;
+
+      if (chunk_y < 0 || chunk_y >= (s64)kChunkColumnCount) continue;
+
+      changes[chunk_y] |= chunks[chunk_y].SetLightLayer(pool, kLayers[layer], nibbles);
+    }
+  }
+
+  // Most sections are fully lit or fully dark, so only keep the lightmaps that have detail.
+  for (size_t i = 0; i < kChunkColumnCount; ++i) {
+    if (changes[i] != 0) {
+      chunks[i].CompactLight(pool);
+    }
+  }
+
+  return true;
+}
+
+bool ChunkDecodePool::Initialize(MemoryArena& perm_arena, ChunkStoragePool& storage_pool) {
+  this->storage_pool = &storage_pool;
+
+  jobs = memory_arena_push_type_count(&perm_arena, ChunkDecodeJob, kJobCount);
+  if (!jobs) {
+    fprintf(stderr, "Failed to allocate chunk decode jobs.\n");
+    return false;
+  }
+
+  free_jobs = nullptr;
+  in_flight_count = 0;
+
+  for (size_t i = 0; i < kJobCount; ++i) {
+    ChunkDecodeJob* job = new (jobs + i) ChunkDecodeJob();
+
+    job->packet = nullptr;
+    job->packet_size = job->packet_capacity = 0;
+    job->deferred = nullptr;
+    job->deferred_size = job->deferred_capacity = 0;
+    job->next = free_jobs;
+    free_jobs = job;
+  }
+
+  pending_head = pending_tail = completed = nullptr;
+
+  // Decoding is much cheaper than meshing, so only a couple of threads are needed to keep up with the network.
+  size_t hardware_count = (size_t)std::thread::hardware_concurrency();
+  worker_count = hardware_count > 2 ? kMaxWorkers : 1;
+
+  running = true;
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers[i] = perm_arena.Construct<ChunkDecodeWorker>();
+    workers[i]->scratch = CreateArena(kDecodeScratchSize);
+    active[i] = nullptr;
+  }
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers[i]->thread = std::thread(&ChunkDecodePool::WorkerMain, this, i);
+  }
+
+  printf("Chunk decode workers: %zu\n", worker_count);
+
+  return true;
+}
+
+void ChunkDecodePool::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+
+  work_signal.notify_all();
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    if (workers[i]->thread.joinable()) {
+      workers[i]->thread.join();
+    }
+
+    workers[i]->scratch.Destroy();
+    workers[i]->~ChunkDecodeWorker();
+  }
+
+  worker_count = 0;
+
+  for (size_t i = 0; i < kJobCount; ++i) {
+    for (size_t chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
+      jobs[i].chunks[chunk_y].Free(*storage_pool);
+    }
+
+    if (jobs[i].packet) {
+      g_Platform.Free(jobs[i].packet);
+      jobs[i].packet = nullptr;
+    }
+
+    if (jobs[i].deferred) {
+      g_Platform.Free(jobs[i].deferred);
+      jobs[i].deferred = nullptr;
+    }
+  }
+}
+
+ChunkDecodeJob* ChunkDecodePool::Acquire(s32 chunk_x, s32 chunk_z, size_t packet_size) {
+  ChunkDecodeJob* job = free_jobs;
+
+  if (!job) return nullptr;
+
+  // The packet is parsed as a ring buffer that is larger than it, so it never wraps.
+  if (job->packet_capacity <= packet_size) {
+    size_t capacity = packet_size < kMinPacketCapacity ? kMinPacketCapacity : packet_size + 1;
+    u8* packet = g_Platform.Allocate(capacity);
+
+    if (!packet) {
+      fprintf(stderr, "Failed to allocate chunk packet buffer of size %zu.\n", capacity);
+      return nullptr;
+    }
+
+    if (job->packet) {
+      g_Platform.Free(job->packet);
+    }
+
+    job->packet = packet;
+    job->packet_capacity = capacity;
+  }
+
+  free_jobs = job->next;
+
+  job->chunk_x = chunk_x;
+  job->chunk_z = chunk_z;
+  job->cancelled = false;
+  job->packet_size = packet_size;
+  job->bitmask = 0;
+  job->deferred_size = 0;
+  job->next = nullptr;
+
+  return job;
+}
+
+void ChunkDecodePool::Submit(ChunkDecodeJob* job) {
+  // A resent column replaces the one that was still decoding.
+  Cancel(job->chunk_x, job->chunk_z);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (pending_tail) {
+      pending_tail->next = job;
+    } else {
+      pending_head = job;
+    }
+
+    pending_tail = job;
+  }
+
+  ++in_flight_count;
+
+  work_signal.notify_one();
+}
+
+ChunkDecodeJob* ChunkDecodePool::PopCompleted(bool wait) {
+  while (in_flight_count > 0) {
+    ChunkDecodeJob* job = nullptr;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      if (wait) {
+        complete_signal.wait(lock, [this] { return completed != nullptr; });
+      }
+
+      job = completed;
+      if (!job) return nullptr;
+
+      completed = job->next;
+      job->next = nullptr;
+    }
+
+    --in_flight_count;
+
+    if (!job->cancelled) {
+      return job;
+    }
+
+    Release(job);
+  }
+
+  return nullptr;
+}
+
+void ChunkDecodePool::Release(ChunkDecodeJob* job) {
+  // These are either the chunks that were swapped out of the world or a decode that was thrown away.
+  for (size_t chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
+    job->chunks[chunk_y].Free(*storage_pool);
+  }
+
+  job->next = free_jobs;
+  free_jobs = job;
+}
+
+ChunkDecodeJob* ChunkDecodePool::GetDecoding(s32 chunk_x, s32 chunk_z) {
+  if (in_flight_count == 0) return nullptr;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // Submitting a column cancels its older jobs, so there's only ever one that isn't cancelled.
+  for (ChunkDecodeJob* job = pending_head; job; job = job->next) {
+    if (!job->cancelled && job->chunk_x == chunk_x && job->chunk_z == chunk_z) return job;
+  }
+
+  for (ChunkDecodeJob* job = completed; job; job = job->next) {
+    if (!job->cancelled && job->chunk_x == chunk_x && job->chunk_z == chunk_z) return job;
+  }
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    ChunkDecodeJob* job = active[i];
+
+    if (job && !job->cancelled && job->chunk_x == chunk_x && job->chunk_z == chunk_z) return job;
+  }
+
+  return nullptr;
+}
+
+DeferredChange* ChunkDecodePool::PushDeferred(ChunkDecodeJob* job, DeferredChangeType type, size_t size) {
+  constexpr size_t kAlignment = alignof(DeferredChange);
+
+  size_t padded_size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  size_t required = job->deferred_size + sizeof(DeferredChange) + padded_size;
+
+  if (required > job->deferred_capacity) {
+    size_t capacity = job->deferred_capacity < kMinDeferredCapacity ? kMinDeferredCapacity : job->deferred_capacity;
+
+    while (capacity < required) {
+      capacity *= 2;
+    }
+
+    u8* deferred = g_Platform.Allocate(capacity);
+
+    if (!deferred) {
+      fprintf(stderr, "Failed to allocate deferred chunk changes of size %zu.\n", capacity);
+      return nullptr;
+    }
+
+    if (job->deferred) {
+      memcpy(deferred, job->deferred, job->deferred_size);
+      g_Platform.Free(job->deferred);
+    }
+
+    job->deferred = deferred;
+    job->deferred_capacity = capacity;
+  }
+
+  DeferredChange* change = (DeferredChange*)(job->deferred + job->deferred_size);
+
+  change->type = type;
+  change->size = (u32)size;
+
+  job->deferred_size = required;
+
+  return change;
+}
+
+void ChunkDecodePool::Cancel(s32 chunk_x, s32 chunk_z) {
+  if (in_flight_count == 0) return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (ChunkDecodeJob* job = pending_head; job; job = job->next) {
+    if (job->chunk_x == chunk_x && job->chunk_z == chunk_z) job->cancelled = true;
+  }
+
+  for (ChunkDecodeJob* job = completed; job; job = job->next) {
+    if (job->chunk_x == chunk_x && job->chunk_z == chunk_z) job->cancelled = true;
+  }
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    ChunkDecodeJob* job = active[i];
+
+    if (job && job->chunk_x == chunk_x && job->chunk_z == chunk_z) job->cancelled = true;
+  }
+}
+
+void ChunkDecodePool::CancelAll() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (ChunkDecodeJob* job = pending_head; job; job = job->next) {
+    job->cancelled = true;
+  }
+
+  for (ChunkDecodeJob* job = completed; job; job = job->next) {
+    job->cancelled = true;
+  }
+
+  for (size_t i = 0; i < worker_count; ++i) {
+    if (active[i]) active[i]->cancelled = true;
+  }
+}
+
+void ChunkDecodePool::WorkerMain(size_t worker_index) {
+  ChunkDecodeWorker& worker = *workers[worker_index];
+
+  while (true) {
+    ChunkDecodeJob* job = nullptr;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      work_signal.wait(lock, [this] { return !running || pending_head != nullptr; });
+
+      if (!running) break;
+
+      job = pending_head;
+      pending_head = job->next;
+
+      if (!pending_head) {
+        pending_tail = nullptr;
+      }
+
+      job->next = nullptr;
+
+      if (!job->cancelled) {
+        active[worker_index] = job;
+      }
+    }
+
+    // Cancelled jobs skip the decode and go straight back to the main thread to be released.
+    if (!job->cancelled) {
+      Decode(worker, job);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      active[worker_index] = nullptr;
+
+      job->next = completed;
+      completed = job;
+    }
+
+    complete_signal.notify_one();
+  }
+}
+
+void ChunkDecodePool::Decode(ChunkDecodeWorker& worker, ChunkDecodeJob* job) {
+  MemoryArena& scratch = worker.scratch;
+
+  scratch.Reset();
+
+  // Wrap the packet so the nbt parser can read it. The buffer is larger than the packet so reads never wrap.
+  RingBuffer rb(scratch, 0);
+
+  rb.data = job->packet;
+  rb.size = job->packet_capacity;
+  rb.read_offset = 0;
+  rb.write_offset = job->packet_size;
+
+  nbt::TagCompound* heightmaps = memory_arena_push_type(&scratch, nbt::TagCompound);
+
+  if (!nbt::Parse(rb, scratch, heightmaps)) {
+    fprintf(stderr, "Failed to parse chunk nbt (%d, %d).\n", job->chunk_x, job->chunk_z);
+  }
+
+  u64 data_size = 0;
+  rb.ReadVarInt(&data_size);
+
+  if (data_size > rb.GetReadAmount()) {
+    fprintf(stderr, "Chunk data for (%d, %d) is truncated.\n", job->chunk_x, job->chunk_z);
+    return;
+  }
+
+  // The data_size can be larger than the actual chunk data sent according to documentation, so the sections are read
+  // out of their own span and the packet continues after it.
+  SpanReader section_reader = rb.ReadSpan(scratch, (size_t)data_size);
+
+  if (!DecodeChunkSections(scratch, *storage_pool, section_reader, job->min_y, job->height, job->chunks,
+                           &job->bitmask)) {
+    fprintf(stderr, "Chunk data for (%d, %d) is truncated.\n", job->chunk_x, job->chunk_z);
+  }
+
+  u64 block_entity_count = 0;
+  rb.ReadVarInt(&block_entity_count);
+
+  // Every block entity takes at least a few bytes, so a count larger than the rest of the packet is corrupt.
+  if (block_entity_count > rb.GetReadAmount()) {
+    fprintf(stderr, "Chunk data for (%d, %d) has a bad block entity count.\n", job->chunk_x, job->chunk_z);
+    return;
+  }
+
+  for (size_t i = 0; i < block_entity_count; ++i) {
+    u8 packed_xz = rb.ReadU8();
+    s16 y = rb.ReadU16();
+
+    u64 type;
+    rb.ReadVarInt(&type);
+
+    ArenaSnapshot snapshot = scratch.GetSnapshot();
+    nbt::TagCompound* block_entity_nbt = memory_arena_push_type(&scratch, nbt::TagCompound);
+
+    if (!nbt::Parse(rb, scratch, block_entity_nbt)) {
+      fprintf(stderr, "Failed to parse block entity nbt.\n");
+    }
+
+    scratch.Revert(snapshot);
+  }
+
+  // The light arrays make up the rest of the packet. The whole column is built once it's published, so the changes
+  // don't need to be marked.
+  SpanReader light_reader = rb.ReadSpan(scratch, rb.GetReadAmount());
+  u32 light_changes[kChunkColumnCount];
+
+  if (!DecodeChunkLight(scratch, *storage_pool, light_reader, job->min_y, job->height, job->chunks, light_changes)) {
+    fprintf(stderr, "Failed to read light data for chunk (%d, %d).\n", job->chunk_x, job->chunk_z);
+  }
+}
+
+} // namespace world
+} // namespace polymer
@@ -0,0 +1,141 @@
+#ifndef POLYMER_WORLD_CHUNK_DECODE_POOL_H_
+#define POLYMER_WORLD_CHUNK_DECODE_POOL_H_
+
+#include <polymer/buffer.h>
+#include <polymer/memory.h>
+#include <polymer/types.h>
+#include <polymer/world/chunk.h>
+#include <polymer/world/world.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace polymer {
+namespace world {
+
+// Decodes the block and biome data of a ChunkData packet. The reader covers the section data that follows its size.
+// Only the sections within the dimension's height are sent, and the rest of the chunks are left alone.
+bool DecodeChunkSections(MemoryArena& scratch, ChunkStoragePool& pool, SpanReader& reader, s32 min_y, s32 height,
+                         Chunk* chunks, u32* bitmask);
+
+// Decodes the light masks and nibble arrays that end the ChunkData and UpdateLight packets into the chunks.
+// Sections that aren't in any mask are left alone. The LightChangeFlags of each section are written to changes.
+bool DecodeChunkLight(MemoryArena& scratch, ChunkStoragePool& pool, SpanReader& reader, s32 min_y, s32 height,
+                      Chunk* chunks, u32* changes);
+
+enum class DeferredChangeType : u32 { Block, Light };
+
+// A packet that modified a column while its ChunkData was still decoding. Light updates are followed by the rest of
+// their packet, padded so the next change stays aligned.
+struct DeferredChange {
+  DeferredChangeType type;
+  s32 x;
+  s32 y;
+  s32 z;
+  u32 bid;
+  u32 size;
+};
+
+struct ChunkDecodeJob {
+  s32 chunk_x;
+  s32 chunk_z;
+
+  // The dimension at the time the packet was received.
+  s32 min_y;
+  s32 height;
+
+  // Set when the column was unloaded or resent while decoding, so the result should be thrown away.
+  bool cancelled;
+
+  // Copy of the packet after the chunk coordinates, since the connection buffer is reused by the next packets.
+  // The buffer is kept between jobs and only grows.
+  u8* packet;
+  size_t packet_size;
+  size_t packet_capacity;
+
+  // Decoded into storage from the pool, then swapped into the world's column when it's published.
+  Chunk chunks[kChunkColumnCount];
+  u32 bitmask;
+
+  // Changes that are applied on top of the column in order once it's published. Only touched by the main thread.
+  // The buffer is kept between jobs and only grows.
+  u8* deferred;
+  size_t deferred_size;
+  size_t deferred_capacity;
+
+  ChunkDecodeJob* next;
+};
+
+struct ChunkDecodeWorker {
+  std::thread thread;
+  // Palettes and nbt are decoded here and thrown away after every job.
+  MemoryArena scratch;
+};
+
+// Decodes ChunkData packets on worker threads so the main thread only copies the packet and later swaps the finished
+// sections into the world. The world is never touched by the workers, so meshing and rendering always see whole
+// columns. Jobs are submitted and published from the main thread.
+struct ChunkDecodePool {
+  constexpr static size_t kMaxWorkers = 2;
+  constexpr static size_t kJobCount = 64;
+
+  ChunkStoragePool* storage_pool = nullptr;
+
+  ChunkDecodeWorker* workers[kMaxWorkers];
+  size_t worker_count = 0;
+
+  ChunkDecodeJob* jobs = nullptr;
+
+  // Only accessed by the main thread.
+  ChunkDecodeJob* free_jobs = nullptr;
+  // Jobs that have been submitted but not popped yet.
+  size_t in_flight_count = 0;
+
+  // Everything below is protected by the mutex.
+  std::mutex mutex;
+  std::condition_variable work_signal;
+  std::condition_variable complete_signal;
+
+  ChunkDecodeJob* pending_head = nullptr;
+  ChunkDecodeJob* pending_tail = nullptr;
+  ChunkDecodeJob* completed = nullptr;
+  ChunkDecodeJob* active[kMaxWorkers];
+
+  bool running = false;
+
+  bool Initialize(MemoryArena& perm_arena, ChunkStoragePool& storage_pool);
+  void Shutdown();
+
+  // Returns a job with room for the packet, or null if every job is in flight.
+  ChunkDecodeJob* Acquire(s32 chunk_x, s32 chunk_z, size_t packet_size);
+  // Queues the job for decoding. Anything still decoding for the same column is cancelled.
+  void Submit(ChunkDecodeJob* job);
+
+  // Returns a finished job, or null if there are none. Waits for one if wait is set and anything is in flight.
+  // The job must be given back with Release once its chunks are published.
+  ChunkDecodeJob* PopCompleted(bool wait);
+  // Frees any storage left in the job's chunks and puts it back in the free list.
+  void Release(ChunkDecodeJob* job);
+
+  // Returns the column's decode that hasn't been published yet, or null if there isn't one.
+  ChunkDecodeJob* GetDecoding(s32 chunk_x, s32 chunk_z);
+  // Appends a change with size bytes of data to the job and returns it, or null if the buffer couldn't grow.
+  DeferredChange* PushDeferred(ChunkDecodeJob* job, DeferredChangeType type, size_t size);
+
+  void Cancel(s32 chunk_x, s32 chunk_z);
+  void CancelAll();
+
+  inline size_t GetInFlightCount() const {
+    return in_flight_count;
+  }
+
+private:
+  void WorkerMain(size_t worker_index);
+  void Decode(ChunkDecodeWorker& worker, ChunkDecodeJob* job);
+};
+
+} // namespace world
+} // namespace polymer
+
+#endif
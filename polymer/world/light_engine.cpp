@@ -0,0 +1,475 @@
+#include <polymer/world/light_engine.h>
+
+#include <polymer/memory.h>
+#include <polymer/world/block.h>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace polymer {
+namespace world {
+
+constexpr s32 kWorldMinY = -64;
+constexpr s32 kWorldMaxY = kWorldMinY + (s32)kChunkColumnCount * 16;
+
+constexpr u8 kMaxLight = 15;
+
+// Ordered the same as BlockFace.
+constexpr s32 kFaceOffsets[6][3] = {
+    {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}, {-1, 0, 0}, {1, 0, 0},
+};
+
+constexpr size_t kDownFace = (size_t)BlockFace::Down;
+
+struct LightEmitter {
+  String name;
+  u8 luminance;
+  // The emitter is only lit in states with this property, such as furnaces that are burning.
+  String property;
+};
+
+// States that only emit at some levels of a property, such as candles and sea pickles, are left dark.
+static const LightEmitter kLightEmitters[] = {
+    {POLY_STR("minecraft:beacon"), 15},
+    {POLY_STR("minecraft:campfire"), 15, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:conduit"), 15},
+    {POLY_STR("minecraft:end_gateway"), 15},
+    {POLY_STR("minecraft:end_portal"), 15},
+    {POLY_STR("minecraft:fire"), 15},
+    {POLY_STR("minecraft:glowstone"), 15},
+    {POLY_STR("minecraft:jack_o_lantern"), 15},
+    {POLY_STR("minecraft:lantern"), 15},
+    {POLY_STR("minecraft:lava"), 15},
+    {POLY_STR("minecraft:ochre_froglight"), 15},
+    {POLY_STR("minecraft:pearlescent_froglight"), 15},
+    {POLY_STR("minecraft:redstone_lamp"), 15, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:sea_lantern"), 15},
+    {POLY_STR("minecraft:shroomlight"), 15},
+    {POLY_STR("minecraft:verdant_froglight"), 15},
+    {POLY_STR("minecraft:cave_vines"), 14, POLY_STR("berries=true")},
+    {POLY_STR("minecraft:cave_vines_plant"), 14, POLY_STR("berries=true")},
+    {POLY_STR("minecraft:end_rod"), 14},
+    {POLY_STR("minecraft:torch"), 14},
+    {POLY_STR("minecraft:wall_torch"), 14},
+    {POLY_STR("minecraft:blast_furnace"), 13, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:furnace"), 13, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:smoker"), 13, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:nether_portal"), 11},
+    {POLY_STR("minecraft:crying_obsidian"), 10},
+    {POLY_STR("minecraft:soul_campfire"), 10, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:soul_fire"), 10},
+    {POLY_STR("minecraft:soul_lantern"), 10},
+    {POLY_STR("minecraft:soul_torch"), 10},
+    {POLY_STR("minecraft:soul_wall_torch"), 10},
+    {POLY_STR("minecraft:deepslate_redstone_ore"), 9, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:redstone_ore"), 9, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:enchanting_table"), 7},
+    {POLY_STR("minecraft:ender_chest"), 7},
+    {POLY_STR("minecraft:glow_lichen"), 7},
+    {POLY_STR("minecraft:redstone_torch"), 7, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:redstone_wall_torch"), 7, POLY_STR("lit=true")},
+    {POLY_STR("minecraft:amethyst_cluster"), 5},
+    {POLY_STR("minecraft:large_amethyst_bud"), 4},
+    {POLY_STR("minecraft:magma_block"), 3},
+    {POLY_STR("minecraft:medium_amethyst_bud"), 2},
+    {POLY_STR("minecraft:brewing_stand"), 1},
+    {POLY_STR("minecraft:brown_mushroom"), 1},
+    {POLY_STR("minecraft:dragon_egg"), 1},
+    {POLY_STR("minecraft:end_portal_frame"), 1},
+    {POLY_STR("minecraft:sculk_sensor"), 1},
+    {POLY_STR("minecraft:small_amethyst_bud"), 1},
+};
+
+// These let light through, but take an extra level off of it like they do for skylight.
+static const String kDampeningBlocks[] = {
+    POLY_STR("minecraft:water"),
+    POLY_STR("minecraft:ice"),
+    POLY_STR("minecraft:frosted_ice"),
+};
+
+static inline u8 GetLuminance(u8 info) {
+  return info >> 4;
+}
+
+static inline u8 GetOpacity(u8 info) {
+  return info & 0x0F;
+}
+
+static u8 GetBlockOpacity(BlockModel& model) {
+  if (model.has_leaves) return 1;
+  if (model.has_transparency) return 0;
+
+  for (size_t i = 0; i < model.element_count; ++i) {
+    if (model.elements[i].occluding) return kMaxLight;
+  }
+
+  return 0;
+}
+
+static inline u32 GetBorderFlags(size_t index) {
+  size_t x = index & 15;
+  size_t z = (index >> 4) & 15;
+  size_t y = index >> 8;
+
+  u32 flags = LightChangeFlag_Any;
+
+  if (x == 0) flags |= LightChangeFlag_West;
+  if (x == 15) flags |= LightChangeFlag_East;
+  if (y == 0) flags |= LightChangeFlag_Down;
+  if (y == 15) flags |= LightChangeFlag_Up;
+  if (z == 0) flags |= LightChangeFlag_North;
+  if (z == 15) flags |= LightChangeFlag_South;
+
+  return flags;
+}
+
+// Light loses a level for every block it travels and more through blocks that dampen it. Full skylight is the
+// exception and travels straight down through clear blocks without losing anything.
+static inline u8 GetPropagatedLight(LightLayer layer, size_t face, u8 level, u8 opacity) {
+  if (layer == LightLayer::Sky && face == kDownFace && level == kMaxLight && opacity == 0) {
+    return kMaxLight;
+  }
+
+  u8 loss = opacity > 1 ? opacity : 1;
+
+  return level > loss ? level - loss : 0;
+}
+
+void LightEngine::Initialize(MemoryArena& arena) {
+  add_queue.nodes = memory_arena_push_type_count(&arena, Node, kQueueCapacity);
+  remove_queue.nodes = memory_arena_push_type_count(&arena, Node, kQueueCapacity);
+  pending = memory_arena_push_type_count(&arena, Node, kMaxPendingBlocks);
+  section_changes = memory_arena_push_type_count(&arena, LightSectionChange, kMaxSectionChanges);
+
+  memset(column_cache, 0, sizeof(column_cache));
+}
+
+void LightEngine::LoadBlocks(MemoryArena& arena, BlockRegistry& registry) {
+  block_state_count = registry.state_count;
+  block_light_info = memory_arena_push_type_count(&arena, u8, block_state_count);
+
+  for (size_t bid = 0; bid < block_state_count; ++bid) {
+    block_light_info[bid] = GetBlockOpacity(registry.states[bid].model);
+  }
+
+  for (size_t i = 0; i < polymer_array_count(kDampeningBlocks); ++i) {
+    BlockIdRange* range = registry.name_map.Find(kDampeningBlocks[i]);
+    if (!range) continue;
+
+    for (u32 bid = range->base; bid < range->base + range->count; ++bid) {
+      block_light_info[bid] = (block_light_info[bid] & 0xF0) | 1;
+    }
+  }
+
+  for (size_t i = 0; i < polymer_array_count(kLightEmitters); ++i) {
+    const LightEmitter& emitter = kLightEmitters[i];
+    BlockIdRange* range = registry.name_map.Find(emitter.name);
+
+    if (!range) continue;
+
+    for (u32 bid = range->base; bid < range->base + range->count; ++bid) {
+      if (emitter.property.size > 0 && !poly_contains(registry.properties[bid], emitter.property)) continue;
+
+      block_light_info[bid] = (emitter.luminance << 4) | GetOpacity(block_light_info[bid]);
+    }
+  }
+}
+
+bool LightEngine::Enqueue(s32 x, s32 y, s32 z, u32 old_bid, u32 new_bid) {
+  u8 old_info = old_bid < block_state_count ? block_light_info[old_bid] : 0;
+  u8 new_info = new_bid < block_state_count ? block_light_info[new_bid] : 0;
+
+  // Skylight only depends on how much light a block lets through.
+  u8 layers = 0;
+
+  if (old_info != new_info) {
+    layers |= (1 << (size_t)LightLayer::Block);
+  }
+
+  if (GetOpacity(old_info) != GetOpacity(new_info)) {
+    layers |= (1 << (size_t)LightLayer::Sky);
+  }
+
+  if (layers == 0) return true;
+  if (pending_count >= kMaxPendingBlocks) return false;
+
+  Node* node = pending + pending_count++;
+
+  node->x = x;
+  node->y = (s16)y;
+  node->z = z;
+  node->level = layers;
+
+  return true;
+}
+
+void LightEngine::Update(World& world, bool has_skylight) {
+  if (pending_count == 0) return;
+
+  this->world = &world;
+  overflowed = false;
+
+  Propagate(LightLayer::Block);
+
+  if (has_skylight) {
+    Propagate(LightLayer::Sky);
+  }
+
+  FlushColumnCache();
+
+  if (overflowed) {
+    fprintf(stderr, "Light queue overflowed. Lighting will be incomplete until the server updates it.\n");
+  }
+
+  pending_count = 0;
+  this->world = nullptr;
+}
+
+void LightEngine::Clear() {
+  pending_count = 0;
+  section_change_count = 0;
+
+  memset(column_cache, 0, sizeof(column_cache));
+}
+
+void LightEngine::Propagate(LightLayer layer) {
+  u8 layer_bit = 1 << (size_t)layer;
+
+  add_queue.head = add_queue.count = 0;
+  remove_queue.head = remove_queue.count = 0;
+
+  // Take the light out of every changed block first. Anything that was lit through them is removed with it.
+  for (size_t i = 0; i < pending_count; ++i) {
+    Node& node = pending[i];
+    BlockRef ref;
+
+    if (!(node.level & layer_bit) || !Resolve(node.x, node.y, node.z, &ref)) continue;
+
+    u8 level = GetLight(ref, layer);
+
+    if (level > 0) {
+      SetLight(ref, layer, 0);
+      PushRemove(node.x, node.y, node.z, level);
+    }
+  }
+
+  RunRemoval(layer);
+
+  // Then spread back into them from their own light and from their neighbors.
+  for (size_t i = 0; i < pending_count; ++i) {
+    Node& node = pending[i];
+    BlockRef ref;
+
+    if (!(node.level & layer_bit) || !Resolve(node.x, node.y, node.z, &ref)) continue;
+
+    u8 info = GetBlockInfo(ref);
+
+    if (layer == LightLayer::Block && GetLuminance(info) > GetLight(ref, layer)) {
+      SetLight(ref, layer, GetLuminance(info));
+      PushAdd(node.x, node.y, node.z, GetLuminance(info));
+    }
+
+    // The sky above the top of the world is fully lit, so it's treated as a neighbor.
+    if (layer == LightLayer::Sky && node.y + 1 >= kWorldMaxY) {
+      u8 level = GetPropagatedLight(layer, kDownFace, kMaxLight, GetOpacity(info));
+
+      if (level > GetLight(ref, layer)) {
+        SetLight(ref, layer, level);
+        PushAdd(node.x, node.y, node.z, level);
+      }
+    }
+
+    for (size_t face = 0; face < 6; ++face) {
+      s32 nx = node.x + kFaceOffsets[face][0];
+      s32 ny = node.y + kFaceOffsets[face][1];
+      s32 nz = node.z + kFaceOffsets[face][2];
+      BlockRef neighbor;
+
+      if (!Resolve(nx, ny, nz, &neighbor)) continue;
+
+      u8 level = GetLight(neighbor, layer);
+
+      if (level > 0) {
+        PushAdd(nx, ny, nz, level);
+      }
+    }
+  }
+
+  RunAdd(layer);
+}
+
+void LightEngine::RunRemoval(LightLayer layer) {
+  while (remove_queue.count > 0) {
+    Node node = remove_queue.Pop();
+
+    for (size_t face = 0; face < 6; ++face) {
+      s32 nx = node.x + kFaceOffsets[face][0];
+      s32 ny = node.y + kFaceOffsets[face][1];
+      s32 nz = node.z + kFaceOffsets[face][2];
+      BlockRef neighbor;
+
+      if (!Resolve(nx, ny, nz, &neighbor)) continue;
+
+      u8 level = GetLight(neighbor, layer);
+
+      if (level == 0) continue;
+
+      // Full skylight below full skylight came straight down from it, so it goes too.
+      bool dependent = level < node.level ||
+                       (layer == LightLayer::Sky && face == kDownFace && level == kMaxLight && node.level == kMaxLight);
+
+      if (dependent) {
+        SetLight(neighbor, layer, 0);
+        PushRemove(nx, ny, nz, level);
+
+        // Emitters lose the light from around them, but keep their own.
+        u8 luminance = layer == LightLayer::Block ? GetLuminance(GetBlockInfo(neighbor)) : 0;
+
+        if (luminance > 0) {
+          SetLight(neighbor, layer, luminance);
+          PushAdd(nx, ny, nz, luminance);
+        }
+      } else {
+        // This is lit from somewhere else, so it will spread back into what was removed.
+        PushAdd(nx, ny, nz, level);
+      }
+    }
+  }
+}
+
+void LightEngine::RunAdd(LightLayer layer) {
+  while (add_queue.count > 0) {
+    Node node = add_queue.Pop();
+    BlockRef ref;
+
+    if (!Resolve(node.x, node.y, node.z, &ref)) continue;
+
+    // The block could have been lowered by the removal after it was queued.
+    u8 level = GetLight(ref, layer);
+
+    if (level <= 1) continue;
+
+    for (size_t face = 0; face < 6; ++face) {
+      s32 nx = node.x + kFaceOffsets[face][0];
+      s32 ny = node.y + kFaceOffsets[face][1];
+      s32 nz = node.z + kFaceOffsets[face][2];
+      BlockRef neighbor;
+
+      if (!Resolve(nx, ny, nz, &neighbor)) continue;
+
+      u8 opacity = GetOpacity(GetBlockInfo(neighbor));
+
+      if (opacity >= kMaxLight) continue;
+
+      u8 propagated = GetPropagatedLight(layer, face, level, opacity);
+
+      if (propagated > GetLight(neighbor, layer)) {
+        SetLight(neighbor, layer, propagated);
+        PushAdd(nx, ny, nz, propagated);
+      }
+    }
+  }
+}
+
+bool LightEngine::Resolve(s32 x, s32 y, s32 z, BlockRef* ref) {
+  if (y < kWorldMinY || y >= kWorldMaxY) return false;
+
+  s32 chunk_x = x >> 4;
+  s32 chunk_z = z >> 4;
+
+  CachedColumn* cached = column_cache + ((chunk_x & 3) | ((chunk_z & 3) << 2));
+
+  if (!cached->valid || cached->chunk_x != chunk_x || cached->chunk_z != chunk_z) {
+    FlushColumn(cached);
+
+    cached->column = world->GetLoadedColumn(chunk_x, chunk_z);
+    cached->chunk_x = chunk_x;
+    cached->chunk_z = chunk_z;
+    cached->valid = true;
+  }
+
+  if (!cached->column) return false;
+
+  ref->chunk_y = (size_t)((y - kWorldMinY) >> 4);
+  ref->chunk = cached->column->section.chunks + ref->chunk_y;
+  ref->cached = cached;
+  ref->index = Chunk::GetIndex(x & 15, y & 15, z & 15);
+
+  return true;
+}
+
+u8 LightEngine::GetLight(const BlockRef& ref, LightLayer layer) const {
+  u8 light = ref.chunk->GetLight(ref.index);
+
+  return layer == LightLayer::Sky ? (light & 0x0F) : (light >> 4);
+}
+
+void LightEngine::SetLight(const BlockRef& ref, LightLayer layer, u8 level) {
+  u8* lightmap = ref.chunk->AcquireLightmap(world->storage_pool);
+
+  if (!lightmap) {
+    overflowed = true;
+    return;
+  }
+
+  if (layer == LightLayer::Sky) {
+    lightmap[ref.index] = (lightmap[ref.index] & 0xF0) | level;
+  } else {
+    lightmap[ref.index] = (lightmap[ref.index] & 0x0F) | (level << 4);
+  }
+
+  ref.cached->changes[ref.chunk_y] |= GetBorderFlags(ref.index);
+}
+
+void LightEngine::PushAdd(s32 x, s32 y, s32 z, u8 level) {
+  if (!add_queue.Push(x, y, z, level)) {
+    overflowed = true;
+  }
+}
+
+void LightEngine::PushRemove(s32 x, s32 y, s32 z, u8 level) {
+  if (!remove_queue.Push(x, y, z, level)) {
+    overflowed = true;
+  }
+}
+
+void LightEngine::FlushColumn(CachedColumn* cached) {
+  if (!cached->valid) return;
+
+  cached->valid = false;
+
+  if (!cached->column) return;
+
+  for (size_t chunk_y = 0; chunk_y < kChunkColumnCount; ++chunk_y) {
+    u8 changes = cached->changes[chunk_y];
+
+    if (changes == 0) continue;
+
+    cached->changes[chunk_y] = 0;
+
+    // Fills often light or darken a whole section, so the lightmap can usually be freed again.
+    cached->column->section.chunks[chunk_y].CompactLight(world->storage_pool);
+
+    if (section_change_count >= kMaxSectionChanges) {
+      fprintf(stderr, "Too many light changes to remesh (%d, %d, %d).\n", cached->chunk_x, (s32)chunk_y,
+              cached->chunk_z);
+      continue;
+    }
+
+    LightSectionChange* change = section_changes + section_change_count++;
+
+    change->chunk_x = cached->chunk_x;
+    change->chunk_y = (s32)chunk_y;
+    change->chunk_z = cached->chunk_z;
+    change->changes = changes;
+  }
+}
+
+void LightEngine::FlushColumnCache() {
+  for (size_t i = 0; i < kColumnCacheSize; ++i) {
+    FlushColumn(column_cache + i);
+  }
+}
+
+} // namespace world
+} // namespace polymer
@@ -0,0 +1,153 @@
+#ifndef POLYMER_WORLD_LIGHT_ENGINE_H_
+#define POLYMER_WORLD_LIGHT_ENGINE_H_
+
+#include <polymer/types.h>
+#include <polymer/world/chunk.h>
+#include <polymer/world/world.h>
+
+namespace polymer {
+
+struct MemoryArena;
+
+namespace world {
+
+struct BlockRegistry;
+
+// A section that had its light changed by the engine, with the LightChangeFlags of where it changed.
+struct LightSectionChange {
+  s32 chunk_x;
+  s32 chunk_y;
+  s32 chunk_z;
+  u32 changes;
+};
+
+// Propagates block light and skylight through the loaded sections when blocks change, so lighting is correct before
+// the server sends its own update. Changed blocks are batched and flood filled together, first removing the light
+// that came through them and then spreading back in from everything that is still lit around them.
+struct LightEngine {
+  constexpr static size_t kQueueCapacity = 1 << 17;
+  constexpr static size_t kMaxPendingBlocks = 1 << 14;
+  constexpr static size_t kMaxSectionChanges = 4096;
+  // Direct mapped by the bottom two bits of the chunk coordinate, which covers the area that a flood fill can reach.
+  constexpr static size_t kColumnCacheSize = 16;
+
+  struct Node {
+    s32 x;
+    s32 z;
+    s16 y;
+    u8 level;
+  };
+
+  // Fixed size ring of nodes. The flood fill is breadth first, so only its frontier is ever in the queue.
+  struct NodeQueue {
+    Node* nodes = nullptr;
+    size_t head = 0;
+    size_t count = 0;
+
+    inline bool Push(s32 x, s32 y, s32 z, u8 level) {
+      if (count >= kQueueCapacity) return false;
+
+      Node* node = nodes + ((head + count++) & (kQueueCapacity - 1));
+
+      node->x = x;
+      node->y = (s16)y;
+      node->z = z;
+      node->level = level;
+
+      return true;
+    }
+
+    inline Node Pop() {
+      Node node = nodes[head];
+
+      head = (head + 1) & (kQueueCapacity - 1);
+      --count;
+
+      return node;
+    }
+  };
+
+  struct CachedColumn {
+    ChunkColumn* column;
+    s32 chunk_x;
+    s32 chunk_z;
+    bool valid;
+    // LightChangeFlags for each section that was written since the column was cached.
+    u8 changes[kChunkColumnCount];
+  };
+
+  // Light emitted in the upper 4 bits and light blocked in the lower 4 bits for every block state. This keeps the
+  // flood fill from touching the much larger BlockState.
+  u8* block_light_info = nullptr;
+  size_t block_state_count = 0;
+
+  NodeQueue add_queue;
+  NodeQueue remove_queue;
+
+  // Blocks that changed since the last update, with a bit set for each LightLayer that needs to be propagated.
+  Node* pending = nullptr;
+  size_t pending_count = 0;
+
+  // Sections that were written by the last update. These need to be remeshed.
+  LightSectionChange* section_changes = nullptr;
+  size_t section_change_count = 0;
+
+  void Initialize(MemoryArena& arena);
+  // Must be called once the block registry is loaded.
+  void LoadBlocks(MemoryArena& arena, BlockRegistry& registry);
+
+  // Queues a block that changed for the next update. It must already be set in the world.
+  // Returns false if the pending list is full and needs to be updated first.
+  bool Enqueue(s32 x, s32 y, s32 z, u32 old_bid, u32 new_bid);
+
+  // Propagates the light of every pending block and fills out the section changes.
+  void Update(World& world, bool has_skylight);
+
+  inline void ClearSectionChanges() {
+    section_change_count = 0;
+  }
+
+  // Drops anything pending, such as when the world is cleared.
+  void Clear();
+
+private:
+  struct BlockRef {
+    Chunk* chunk;
+    CachedColumn* cached;
+    size_t chunk_y;
+    size_t index;
+  };
+
+  // Only set while updating.
+  World* world = nullptr;
+
+  CachedColumn column_cache[kColumnCacheSize];
+  bool overflowed = false;
+
+  void Propagate(LightLayer layer);
+  void RunRemoval(LightLayer layer);
+  void RunAdd(LightLayer layer);
+
+  // Returns false if the block isn't in a loaded section.
+  bool Resolve(s32 x, s32 y, s32 z, BlockRef* ref);
+
+  u8 GetLight(const BlockRef& ref, LightLayer layer) const;
+  void SetLight(const BlockRef& ref, LightLayer layer, u8 level);
+
+  inline u8 GetBlockInfo(const BlockRef& ref) const {
+    u32 bid = ref.chunk->GetBlock(ref.index);
+
+    return bid < block_state_count ? block_light_info[bid] : 0;
+  }
+
+  void PushAdd(s32 x, s32 y, s32 z, u8 level);
+  void PushRemove(s32 x, s32 y, s32 z, u8 level);
+
+  void FlushColumn(CachedColumn* cached);
+  void FlushColumnCache();
+};
+
+} // namespace world
+} // namespace polymer
+
+#endif
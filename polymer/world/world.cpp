@@ -0,0 +1,173 @@
+#include <polymer/world/world.h>
+
+#include <polymer/memory.h>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace polymer {
+namespace world {
+
+// How many columns are carved out of the arena at once when the free list runs dry.
+constexpr size_t kColumnsPerRefill = 64;
+
+void World::Initialize(MemoryArena& arena, u32 view_distance) {
+  this->arena = &arena;
+
+  SetViewDistance(view_distance);
+}
+
+void World::SetViewDistance(u32 view_distance) {
+  this->view_distance = view_distance;
+
+  Reserve(GetChunkColumnCapacity(view_distance));
+}
+
+ChunkColumn* World::CreateColumn(s32 chunk_x, s32 chunk_z) {
+  ChunkColumn* existing = GetColumn(chunk_x, chunk_z);
+
+  if (existing) return existing;
+
+  // Keep the load factor at or below one half so probe lengths stay short.
+  if ((column_count + 1) * 2 > slot_count && !Reserve(column_count + 1)) {
+    return nullptr;
+  }
+
+  if (!free_columns) {
+    ChunkColumn* batch = memory_arena_push_type_count(arena, ChunkColumn, kColumnsPerRefill);
+
+    if (!batch) {
+      fprintf(stderr, "Failed to allocate chunk columns.\n");
+      return nullptr;
+    }
+
+    for (size_t i = 0; i < kColumnsPerRefill; ++i) {
+      new (batch + i) ChunkColumn();
+
+      batch[i].next_free = free_columns;
+      free_columns = batch + i;
+    }
+  }
+
+  ChunkColumn* column = free_columns;
+  free_columns = column->next_free;
+
+  column->info.loaded = false;
+  column->info.bitmask = 0;
+  column->info.x = chunk_x;
+  column->info.z = chunk_z;
+  column->section.info = &column->info;
+  column->version = 0;
+  memset(column->section_versions, 0, sizeof(column->section_versions));
+
+  memset(column->meshes, 0, sizeof(column->meshes));
+
+  column->build_state = 0;
+  column->build_heap_index = 0;
+  column->build_priority = 0.0f;
+  column->dirty_mask = 0;
+  column->next_free = nullptr;
+
+  size_t mask = slot_count - 1;
+  size_t slot = HashCoord(chunk_x, chunk_z) & mask;
+
+  while (slots[slot]) {
+    slot = (slot + 1) & mask;
+  }
+
+  slots[slot] = column;
+
+  column->resident_index = (u32)column_count;
+  columns[column_count++] = column;
+
+  return column;
+}
+
+void World::FreeColumn(ChunkColumn* column) {
+  size_t mask = slot_count - 1;
+  size_t slot = HashCoord(column->info.x, column->info.z) & mask;
+
+  while (slots[slot] != column) {
+    slot = (slot + 1) & mask;
+  }
+
+  slots[slot] = nullptr;
+
+  // Shift back any following entries that would no longer be reachable through the new hole.
+  size_t hole = slot;
+
+  for (size_t next = (hole + 1) & mask; slots[next]; next = (next + 1) & mask) {
+    size_t home = HashCoord(slots[next]->info.x, slots[next]->info.z) & mask;
+
+    // The entry can fill the hole if its home slot isn't cyclically within (hole, next].
+    bool reachable = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+
+    if (!reachable) {
+      slots[hole] = slots[next];
+      slots[next] = nullptr;
+      hole = next;
+    }
+  }
+
+  ChunkColumn* last = columns[--column_count];
+
+  columns[column->resident_index] = last;
+  last->resident_index = column->resident_index;
+
+  for (size_t i = 0; i < kChunkColumnCount; ++i) {
+    column->section.chunks[i].Free(storage_pool);
+  }
+
+  column->info.loaded = false;
+  column->next_free = free_columns;
+  free_columns = column;
+}
+
+void World::Clear() {
+  while (column_count > 0) {
+    FreeColumn(columns[column_count - 1]);
+  }
+}
+
+bool World::Reserve(size_t column_capacity) {
+  size_t new_slot_count = 16;
+
+  while (new_slot_count < column_capacity * 2) {
+    new_slot_count *= 2;
+  }
+
+  if (new_slot_count <= slot_count) return true;
+
+  ChunkColumn** new_slots = memory_arena_push_type_count(arena, ChunkColumn*, new_slot_count);
+  ChunkColumn** new_columns = memory_arena_push_type_count(arena, ChunkColumn*, new_slot_count / 2);
+
+  if (!new_slots || !new_columns) {
+    fprintf(stderr, "Failed to grow chunk table to %zu columns.\n", new_slot_count / 2);
+    return false;
+  }
+
+  memset(new_slots, 0, sizeof(ChunkColumn*) * new_slot_count);
+
+  size_t mask = new_slot_count - 1;
+
+  for (size_t i = 0; i < column_count; ++i) {
+    ChunkColumn* column = columns[i];
+    size_t slot = HashCoord(column->info.x, column->info.z) & mask;
+
+    while (new_slots[slot]) {
+      slot = (slot + 1) & mask;
+    }
+
+    new_slots[slot] = column;
+    new_columns[i] = column;
+  }
+
+  slots = new_slots;
+  columns = new_columns;
+  slot_count = new_slot_count;
+
+  return true;
+}
+
+} // namespace world
+} // namespace polymer
@@ -1,8 +1,11 @@
 #ifndef POLYMER_WORLD_H_
 #define POLYMER_WORLD_H_
 
+#include <polymer/memory.h>
 #include <polymer/render/chunk_renderer.h>
 #include <polymer/types.h>
+#include <polymer/world/biome.h>
+#include <polymer/world/chunk.h>
 
 namespace polymer {
 namespace world {
@@ -14,13 +17,6 @@ struct ChunkCoord {
   s32 z;
 };
 
-struct Chunk {
-  u32 blocks[16][16][16];
-
-  // The bottom 4 bits contain the skylight data and the upper 4 bits contain the block
-  u8 lightmap[16][16][16];
-};
-
 struct ChunkSectionInfo {
   bool loaded;
   u32 bitmask;
@@ -28,6 +24,7 @@ struct ChunkSectionInfo {
   s32 z;
 };
 
+// A full column of sections.
 struct ChunkSection {
   ChunkSectionInfo* info;
   Chunk chunks[kChunkColumnCount];
@@ -37,16 +34,107 @@ struct ChunkMesh {
   render::RenderMesh meshes[render::kRenderLayerCount];
 };
 
-constexpr size_t kChunkCacheSize = 32;
+// Everything the client keeps for one loaded chunk column. Columns are only allocated while they are loaded.
+struct ChunkColumn {
+  ChunkSectionInfo info;
+  ChunkSection section;
+  ChunkMesh meshes[kChunkColumnCount];
+
+  // Bumped every time decoded sections are published into the column, so work started on older data can be discarded.
+  u32 version;
+  // Bumped whenever the blocks or light of a section change.
+  u32 section_versions[kChunkColumnCount];
+
+  // Mesh build state owned by render::ChunkBuildScheduler.
+  u8 build_state;
+  u32 build_heap_index;
+  float build_priority;
+
+  // Sections waiting to be remeshed, owned by render::DirtySectionSet.
+  u32 dirty_mask;
+
+  // Position in the world's list of resident columns.
+  u32 resident_index;
+  ChunkColumn* next_free;
+};
+
+// The server sends every column within its view distance of the player. Columns just outside of it can linger until
+// their unload arrives, so a margin is kept around the square.
+constexpr size_t GetChunkColumnCapacity(u32 view_distance) {
+  return (size_t)(view_distance * 2 + 5) * (size_t)(view_distance * 2 + 5);
+}
+
+constexpr u32 kDefaultViewDistance = 12;
+// Fixed size render resources are sized for this. Larger view distances still load, but can run out of mesh space.
+constexpr u32 kMaxViewDistance = 32;
+constexpr size_t kMaxChunkColumns = GetChunkColumnCapacity(kMaxViewDistance);
+
+// Sparse store of the loaded chunk columns keyed by their chunk coordinate.
+// Lookups go through an open addressed hash table that grows with the view distance, so any view distance works
+// without columns aliasing each other. Columns are pooled and given back when they are unloaded.
 struct World {
-  // Store the chunk data separately to make render iteration faster
-  ChunkSection chunks[kChunkCacheSize][kChunkCacheSize];
-  ChunkSectionInfo chunk_infos[kChunkCacheSize][kChunkCacheSize];
-  ChunkMesh meshes[kChunkCacheSize][kChunkCacheSize][kChunkColumnCount];
+  MemoryArena* arena = nullptr;
+
+  // Backing memory for the paletted block storage and lightmaps of every section.
+  // The pool is also used by the chunk decode workers, so it's refilled from the platform instead of the world's arena.
+  ChunkStoragePool storage_pool;
+
+  // Linear probed with backward shift deletion, so there are no tombstones. The slot count is a power of two.
+  ChunkColumn** slots = nullptr;
+  size_t slot_count = 0;
+
+  // Dense list of every column in the table to make iteration fast.
+  ChunkColumn** columns = nullptr;
+  size_t column_count = 0;
+
+  ChunkColumn* free_columns = nullptr;
 
-  inline u32 GetChunkCacheIndex(s32 v) {
-    return ((v % (s32)kChunkCacheSize) + (s32)kChunkCacheSize) % (s32)kChunkCacheSize;
+  // Maps the biome ids in the section storage to their colors. This is reloaded from the codec on login.
+  BiomeCodec biome_codec;
+
+  u32 view_distance = 0;
+
+  void Initialize(MemoryArena& arena, u32 view_distance);
+
+  // Grows the table to fit the view distance. The table never shrinks since the arena can't give memory back.
+  void SetViewDistance(u32 view_distance);
+
+  inline ChunkColumn* GetColumn(s32 chunk_x, s32 chunk_z) {
+    size_t mask = slot_count - 1;
+
+    for (size_t i = HashCoord(chunk_x, chunk_z) & mask;; i = (i + 1) & mask) {
+      ChunkColumn* column = slots[i];
+
+      if (!column) return nullptr;
+      if (column->info.x == chunk_x && column->info.z == chunk_z) return column;
+    }
   }
+
+  // Returns the loaded column or null if it's not loaded.
+  inline ChunkColumn* GetLoadedColumn(s32 chunk_x, s32 chunk_z) {
+    ChunkColumn* column = GetColumn(chunk_x, chunk_z);
+
+    return column && column->info.loaded ? column : nullptr;
+  }
+
+  // Returns the existing column at the coordinate or inserts an empty one. Returns null if out of memory.
+  ChunkColumn* CreateColumn(s32 chunk_x, s32 chunk_z);
+  // Releases the column and all of its block storage. Meshes must already be freed by the renderer.
+  void FreeColumn(ChunkColumn* column);
+  void Clear();
+
+  static inline size_t HashCoord(s32 chunk_x, s32 chunk_z) {
+    u64 hash = ((u64)(u32)chunk_x << 32) | (u32)chunk_z;
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+
+    return (size_t)hash;
+  }
+
+private:
+  bool Reserve(size_t column_capacity);
 };
 
 } // namespace world
@@ -9,44 +9,40 @@ layout(binding = 0) uniform UniformBufferObject {
   uint alpha_discard;
 } ubo;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in uint inTexId;
-layout(location = 2) in uint inPackedLight;
-layout(location = 3) in uint inTexCoord;
+// The tint palettes of every mesh in the mesh heap as RGBA8 colors.
+layout(binding = 2) readonly buffer TintPalettes {
+  uint tints[];
+};
+
+// Set per pipeline to select this layer's palette from the draw data.
+layout(constant_id = 0) const uint kRenderLayer = 0;
+
+layout(location = 0) in uint inPackedPosition;
+layout(location = 1) in uint inPackedLight;
+layout(location = 2) in uint inPackedTexture;
+// Per-draw instance data selected by the draw's firstInstance.
+layout(location = 3) in vec4 inSectionOrigin;
+layout(location = 4) in uvec4 inTintOffsets;
 
 layout(location = 0) out vec2 fragTexCoord;
 layout(location = 1) flat out uint fragTexId;
 layout(location = 2) out vec4 fragColorMod;
 
-#define GRASS_TINTINDEX 0
-#define LEAF_TINTINDEX 1
-#define SPRUCE_LEAF_TINTINDEX 2
-#define BIRCH_LEAF_TINTINDEX 3
-#define WATER_TINTINDEX 50
-
-#define WATER_TINT vec4(0.247, 0.463, 0.894, 1.0)
-
-#define JUNGLE_GRASS_TINT vec4(0.349, 0.788, 0.235, 1.0)
-#define JUNGLE_LEAF_TINT vec4(0.188, 0.733, 0.043, 1.0)
-
-#define TAIGA_GRASS_TINT vec4(0.525, 0.718, 0.514, 1.0)
-#define TAIGA_LEAF_TINT vec4(0.408, 0.643, 0.392, 1.0)
-
-#define PLAINS_GRASS_TINT vec4(0.569, 0.741, 0.349, 1.0)
-#define PLAINS_LEAF_TINT vec4(0.467, 0.671, 0.184, 1.0)
-
-// Spruce and birch seem to be not affected by biome coloring
-#define SPRUCE_LEAF_TINT vec4(0.380, 0.600, 0.380, 1.0)
-#define BIRCH_LEAF_TINT vec4(0.502, 0.655, 0.333, 1.0)
-
 void main() {
   uint packed_anim = inPackedLight >> 24;
   uint animCount = packed_anim & 0x7F;
   uint animRepeat = (packed_anim >> 7) & 1;
 
-  gl_Position = ubo.mvp * vec4(inPosition - ubo.camera.xyz, 1.0);
-  fragTexCoord.x = (inTexCoord >> 5) / 16.0;
-  fragTexCoord.y = (inTexCoord & 0x1F) / 16.0;
+  // Positions are stored in 1/32nds of a block offset by 8 blocks.
+  vec3 position = vec3(inPackedPosition & 0x3FF, (inPackedPosition >> 10) & 0x3FF, (inPackedPosition >> 20) & 0x3FF);
+  position = position / 32.0 - 8.0;
+
+  // The section origin is already relative to the camera.
+  vec3 view_position = inSectionOrigin.xyz + position;
+
+  gl_Position = ubo.mvp * vec4(view_position, 1.0);
+  fragTexCoord.x = ((inPackedTexture >> 14) & 0x1FF) / 16.0;
+  fragTexCoord.y = ((inPackedTexture >> 23) & 0x1FF) / 16.0;
 
   // Have animation repeat itself backwards
   uint frame = 0;
@@ -60,33 +56,16 @@ void main() {
     frame = ubo.frame % animCount;
   }
 
-  fragTexId = inTexId + frame;
-  fragColorMod = vec4(1, 1, 1, 1);
+  fragTexId = (inPackedTexture & 0x3FFF) + frame;
+
+  uint tint_index = (inPackedLight >> 16) & 0xFF;
+  fragColorMod = vec4(unpackUnorm4x8(tints[inTintOffsets[kRenderLayer] + tint_index]).rgb, 1.0);
 
-  // TODO: Remove this and sample biome from foliage/grass png
-  uint tintindex = (inPackedLight >> 16) & 0xFF;
   uint ao = inPackedLight & 3;
-  
+
   uint skylight_value = (inPackedLight >> 2) & 0x3F;
   uint blocklight_value = (inPackedLight >> 8) & 0x3F;
 
-  if (tintindex == GRASS_TINTINDEX) {
-    fragColorMod = PLAINS_GRASS_TINT;
-  } else if (tintindex == LEAF_TINTINDEX) {
-    fragColorMod = PLAINS_LEAF_TINT;
-  } else if (tintindex == SPRUCE_LEAF_TINTINDEX) {
-    fragColorMod = SPRUCE_LEAF_TINT;
-  } else if (tintindex == BIRCH_LEAF_TINTINDEX) {
-    fragColorMod = BIRCH_LEAF_TINT;
-  } else if (tintindex == WATER_TINTINDEX) {
-    fragColorMod = WATER_TINT;
-  }
-
-  // Convert back down into correct brightness
-  if (tintindex <= WATER_TINTINDEX) {
-    fragColorMod.rgb *= (1.0 / 0.9);
-  }
-
   float skylight_percent = (float(skylight_value) / 60.0) * ubo.sunlight * 0.85;
   float blocklight_percent = blocklight_value / 60.0;
   float light_intensity = max(blocklight_percent, skylight_percent) * 0.85 + 0.15;
@@ -96,7 +75,7 @@ void main() {
 
   // Vary shading of vertical faces by difference between camera and the vertex.
   if (vertical_face > 0) {
-      float height_difference = (ubo.camera.y - inPosition.y);
+      float height_difference = -view_position.y;
       float shading_modifier = max((abs(height_difference) / 15.0), 1.0);
       light_intensity *= max(1.0 - shading_modifier, 0.8);
   }